@@ -28,6 +28,8 @@ SOFTWARE.
 
 #include "lang/bcode.h"
 #include "lang/interp.h"
+#include "lang/buffer.h"
+#include "lang/map.h"
 #include "lang/compile.h"
 #include "lang/err.h"
 
@@ -38,6 +40,9 @@ int file_release(void *map, int sz);
 int file_store(const char *name, void *data, int len);
 int file_base_name(const char *name, void *buf, int sz);
 
+int deadline_arm(int ms, void (*expire)(void));
+int deadline_disarm(void);
+
 int native_init(env_t *env);
 
 #endif /* __EXAMPLE_INC__ */
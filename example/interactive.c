@@ -138,6 +138,19 @@ static void print_value(val_t *v)
 }
 
 static env_t env;
+
+static int execute(val_t **res)
+{
+    int err = interp_execute_interactive(&env, input_buf, input_more, res);
+
+    // paused if budget is set, go on to the end
+    while (err == INTERP_YIELD) {
+        err = interp_resume(&env, res);
+    }
+
+    return err;
+}
+
 static void line_proc(void)
 {
     int    err;
@@ -149,7 +162,7 @@ static void line_proc(void)
         return;
     }
 
-    err = interp_execute_interactive(&env, input_buf, input_more, &res);
+    err = execute(&res);
     if (err < 0) {
         if (input_mode == 0 || err != -ERR_InvalidToken) {
             input_mode = 0;
@@ -185,7 +198,7 @@ static void mult_proc(void)
         input_mode = 0;
     }
 
-    err = interp_execute_interactive(&env, input_buf, input_more, &res);
+    err = execute(&res);
     if (err < 0) {
         print_error(-err);
     } else
@@ -31,11 +31,49 @@ SOFTWARE.
 #define MEM_SIZE      (STACK_SIZE * sizeof(val_t) + HEAP_SIZE + EXE_MEM_SPACE + SYM_MEM_SPACE)
 
 static uint8_t memory[MEM_SIZE];
+static env_t *deadline_env;
 
-static int panda_binary(const char *input, void *mem_ptr, int mem_size, int heap_size, int stack_size)
+static void panda_deadline(void)
+{
+    env_interrupt(deadline_env);
+}
+
+// execution is interrupted after timeout ms, if timeout > 0
+static int panda_execute(env_t *env, const char *input, int timeout)
 {
-    env_t env;
     val_t *res;
+    int err;
+
+    if (timeout > 0) {
+        deadline_env = env;
+        deadline_arm(timeout, panda_deadline);
+    }
+
+    if (input) {
+        err = interp_execute_string(env, input, &res);
+    } else {
+        err = interp_execute_image(env, &res);
+    }
+
+    if (timeout > 0) {
+        // deadline may expire after the run finished
+        deadline_disarm();
+        env_interrupt_clear(env);
+    }
+
+    if (err == -ERR_Interrupted) {
+        printf("timeout: %d ms\n", timeout);
+    } else
+    if (err < 0) {
+        printf("error: %d\n", err);
+    }
+
+    return err;
+}
+
+static int panda_binary(const char *input, void *mem_ptr, int mem_size, int heap_size, int stack_size, int timeout)
+{
+    env_t env;
     int err, size;
     uint8_t *binary;
     image_info_t ef;
@@ -56,20 +94,16 @@ static int panda_binary(const char *input, void *mem_ptr, int mem_size, int heap
     }
     native_init(&env);
 
-    err = interp_execute_image(&env, &res);
-    if (err < 0) {
-        printf("error: %d\n", err);
-    }
+    err = panda_execute(&env, NULL, timeout);
 
     file_release((void *)input, size);
 
     return err;
 }
 
-static int panda_string(const char *input, void *mem_ptr, int mem_size, int heap_size, int stack_size)
+static int panda_string(const char *input, void *mem_ptr, int mem_size, int heap_size, int stack_size, int timeout)
 {
     env_t env;
-    val_t *res;
     int err, size;
 
     input = file_load(input, &size);
@@ -83,10 +117,7 @@ static int panda_string(const char *input, void *mem_ptr, int mem_size, int heap
     }
     native_init(&env);
 
-    err = interp_execute_string(&env, input, &res);
-    if (err < 0) {
-        printf("error: %d\n", err);
-    }
+    err = panda_execute(&env, input, timeout);
 
     file_release((void *)input, size);
 
@@ -95,12 +126,13 @@ static int panda_string(const char *input, void *mem_ptr, int mem_size, int heap
 
 static inline int interpreter(const char *input, int ac, char **av) {
     char *suffix;
+    int timeout = ac > 1 ? atoi(av[1]) : 0;
 
     suffix = rindex(input, '.');
     if (suffix && !strcmp(suffix, ".pdc")) {
-        return panda_binary(input, memory, MEM_SIZE, HEAP_SIZE, STACK_SIZE);
+        return panda_binary(input, memory, MEM_SIZE, HEAP_SIZE, STACK_SIZE, timeout);
     } else {
-        return panda_string(input, memory, MEM_SIZE, HEAP_SIZE, STACK_SIZE);
+        return panda_string(input, memory, MEM_SIZE, HEAP_SIZE, STACK_SIZE, timeout);
     }
 }
 
@@ -110,7 +142,7 @@ int main(int ac, char **av)
     int   error;
 
     if (ac == 1) {
-        printf("Usage: %s <input>\n", av[0]);
+        printf("Usage: %s <input> [timeout ms]\n", av[0]);
         return 0;
     }
     input = av[1];
@@ -75,11 +75,14 @@ static val_t print(env_t *env, int ac, val_t *av)
 }
 
 static native_t native_entry[] = {
-    {"print", print}
+    {"print", print},
+    {"Buffer", buffer_create},
+    {"Map", map_create},
+    {"Set", set_create}
 };
 
 int native_init(env_t *env)
 {
-    return env_native_set(env, native_entry, 1);
+    return env_native_set(env, native_entry, 4);
 }
 
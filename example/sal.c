@@ -26,6 +26,8 @@ SOFTWARE.
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <signal.h>
+#include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -112,3 +114,38 @@ int file_base_name(const char *name, void *buf, int sz)
     return -1;
 }
 
+static void (*deadline_expire)(void);
+
+static void deadline_handler(int sig)
+{
+    (void) sig;
+
+    if (deadline_expire) {
+        deadline_expire();
+    }
+}
+
+/*
+ * Call expire in signal handler after ms, only one deadline is armed.
+ */
+int deadline_arm(int ms, void (*expire)(void))
+{
+    struct itimerval tv;
+
+    deadline_expire = expire;
+    signal(SIGALRM, deadline_handler);
+
+    memset(&tv, 0, sizeof(tv));
+    tv.it_value.tv_sec = ms / 1000;
+    tv.it_value.tv_usec = (ms % 1000) * 1000;
+
+    return setitimer(ITIMER_REAL, &tv, NULL);
+}
+
+int deadline_disarm(void)
+{
+    struct itimerval tv;
+
+    memset(&tv, 0, sizeof(tv));
+    return setitimer(ITIMER_REAL, &tv, NULL);
+}
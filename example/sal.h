@@ -35,5 +35,8 @@ int file_release(void *map, int sz);
 int file_store(const char *name, void *data, int len);
 int file_base_name(const char *name, void *buf, int sz);
 
+int deadline_arm(int ms, void (*expire)(void));
+int deadline_disarm(void);
+
 #endif /* __SAL_INC__ */
 
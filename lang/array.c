@@ -27,43 +27,392 @@ SOFTWARE.
 #include "array.h"
 #include "interp.h"
 
-intptr_t array_create(env_t *env, int ac, val_t *av)
+array_t *array_alloc(env_t *env, int size)
 {
     array_t *array;
-    int size = ac < DEF_ELEM_SIZE ? DEF_ELEM_SIZE : ac;
 
-    if (ac > UINT16_MAX) {
+    if (size > ARRAY_SIZE_MAX) {
         env_set_error(env, ERR_ResourceOutLimit);
-        return 0;
+        return NULL;
     }
 
     array = env_heap_alloc(env, sizeof(array_t) + sizeof(val_t) * size);
     if (array) {
-        val_t *vals = (val_t *)(array + 1);
-
         array->magic = MAGIC_ARRAY;
         array->age = 0;
+        array->kind = ARRAY_KIND_NUMBER;
+        array->layout = ARRAY_LAYOUT_DENSE;
         array->elem_size = size;
         array->elem_bgn  = 0;
-        array->elem_end  = ac;
-        array->elems = vals;
+        array->elem_end  = 0;
+        array->length    = 0;
+        array->elems = (val_t *)(array + 1);
+    } else {
+        env_set_error(env, ERR_NotEnoughMemory);
+    }
+
+    return array;
+}
+
+intptr_t array_create(env_t *env, int ac, val_t *av)
+{
+    array_t *array = array_alloc(env, ac < DEF_ELEM_SIZE ? DEF_ELEM_SIZE : ac);
 
-        memcpy(vals, av, sizeof(val_t) * ac);
+    if (array) {
+        memcpy(array->elems, av, sizeof(val_t) * ac);
+        array->elem_end = ac;
+        array_kind_update_n(array, ac, av);
     }
 
     return (intptr_t) array;
 }
 
-static inline val_t *_array_elem_get(env_t *env, val_t *a, val_t *i) {
-    array_t *array = (array_t *) val_2_intptr(a);
-    int id = val_2_integer(i);
+static array_t *array_space_extend_tail(env_t *env, val_t *self, int n);
 
-    (void) env;
-    if (id >= 0 && id < array_length(array)) {
-        return array->elems + (array->elem_bgn + id);
-    } else {
+static inline int array_space_size(int n) {
+    n = SIZE_ALIGN_16(n + n / 2);
+    return n < ARRAY_SIZE_MAX ? n : ARRAY_SIZE_MAX;
+}
+
+/*
+ * Sparse array hold pairs of (index, value) in elems, sorted by index.
+ * Element is found by binary search, holes are read as undefined.
+ */
+static int array_sparse_find(array_t *a, int id)
+{
+    val_t *pairs = array_values(a);
+    int lo = 0, hi = array_value_num(a) / 2;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+
+        if (val_2_integer(pairs + mid * 2) < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+val_t *array_sparse_ref(array_t *a, int id)
+{
+    int pos = array_sparse_find(a, id);
+
+    if (pos < array_value_num(a) / 2 && val_2_integer(array_values(a) + pos * 2) == id) {
+        return array_values(a) + pos * 2 + 1;
+    }
+    return NULL;
+}
+
+// Note: return NULL without error, if it has not enough memory
+static array_t *array_sparse_to_dense(env_t *env, val_t *self)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+    int i, len = array_length(a), size;
+    val_t *elems, *pairs;
+
+    if (len > ARRAY_SIZE_MAX - 16) {
+        return NULL;
+    }
+    size = SIZE_ALIGN_16(len);
+
+    elems = env_heap_alloc(env, sizeof(val_t) * size);
+    if (!elems) {
         return NULL;
     }
+
+    // Note: array may be moved by gc, in alloc
+    a = (array_t *)val_2_intptr(self);
+    pairs = array_values(a);
+    for (i = 0; i < len; i++) {
+        val_set_undefined(elems + i);
+    }
+    for (i = 0; i < array_value_num(a); i += 2) {
+        elems[val_2_integer(pairs + i)] = pairs[i + 1];
+    }
+    if (array_value_num(a) / 2 < len) {
+        a->kind = ARRAY_KIND_GENERIC;
+    }
+
+    a->layout = ARRAY_LAYOUT_DENSE;
+    a->elems = elems;
+    a->elem_size = size;
+    a->elem_bgn = 0;
+    a->elem_end = len;
+    a->length = 0;
+
+    return a;
+}
+
+static array_t *array_dense_to_sparse(env_t *env, val_t *self)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+    int i, n = 0, size, len = array_length(a);
+    val_t *elems, *vals;
+
+    for (i = 0, vals = array_values(a); i < len; i++) {
+        n += !val_is_undefined(vals + i);
+    }
+
+    size = array_space_size(n * 2 + 2);
+    elems = env_heap_alloc(env, sizeof(val_t) * size);
+    if (!elems) {
+        env_set_error(env, ERR_NotEnoughMemory);
+        return NULL;
+    }
+
+    // Note: array may be moved by gc, in alloc
+    a = (array_t *)val_2_intptr(self);
+    for (i = 0, n = 0, vals = array_values(a); i < len; i++) {
+        if (!val_is_undefined(vals + i)) {
+            val_set_number(elems + n++, i);
+            elems[n++] = vals[i];
+        }
+    }
+
+    a->layout = ARRAY_LAYOUT_SPARSE;
+    a->elems = elems;
+    a->elem_size = size;
+    a->elem_bgn = 0;
+    a->elem_end = n;
+    a->length = len;
+
+    return a;
+}
+
+/*
+ * Sparse array of length, with space of num pairs, the pairs are filled
+ * by caller.
+ */
+static array_t *array_alloc_sparse(env_t *env, int num, int length)
+{
+    array_t *a = array_alloc(env, num <= ARRAY_SIZE_MAX / 2 ? num * 2 : ARRAY_SIZE_MAX + 1);
+
+    if (a) {
+        a->layout = ARRAY_LAYOUT_SPARSE;
+        a->length = length;
+    }
+    return a;
+}
+
+// Space for n values more in sparse array, the pairs are kept from head
+static array_t *array_sparse_reserve(env_t *env, val_t *self, int n)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+    val_t *elems;
+    int size;
+
+    if ((int)(a->elem_size - a->elem_end) >= n) {
+        return a;
+    }
+
+    size = array_space_size(array_value_num(a) + n);
+    if (size - array_value_num(a) < n) {
+        env_set_error(env, ERR_ResourceOutLimit);
+        return NULL;
+    }
+    elems = env_heap_alloc(env, sizeof(val_t) * size);
+    if (!elems) {
+        env_set_error(env, ERR_NotEnoughMemory);
+        return NULL;
+    }
+
+    // Note: array may be moved by gc, in alloc
+    a = (array_t *)val_2_intptr(self);
+    memcpy(elems, array_values(a), sizeof(val_t) * array_value_num(a));
+    a->elem_end -= a->elem_bgn;
+    a->elem_bgn = 0;
+    a->elems = elems;
+    a->elem_size = size;
+
+    return a;
+}
+
+// Sparse array built by natives turn to dense, if it is filled enough
+static void array_sparse_settle(env_t *env, val_t *self)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+
+    if (array_is_sparse(a) && array_dense_enough(array_elem_num(a), array_length(a))) {
+        // keep it sparse, if not enough memory
+        array_sparse_to_dense(env, self);
+    }
+}
+
+/*
+ * Index of the first element at or after i, holes of sparse array are
+ * skipped, holes of dense array are read as undefined.
+ * return: -1 if none
+ */
+int array_next(array_t *a, int i)
+{
+    if (i < 0) {
+        i = 0;
+    }
+
+    if (array_is_sparse(a)) {
+        int pos = array_sparse_find(a, i);
+
+        return pos < array_elem_num(a) ? val_2_integer(array_values(a) + pos * 2) : -1;
+    }
+    return i < array_length(a) ? i : -1;
+}
+
+// Array for the result mapped from self, a sparse one keep the holes of self
+array_t *array_alloc_mapped(env_t *env, val_t *self)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+
+    if (array_is_sparse(a)) {
+        return array_alloc_sparse(env, array_elem_num(a), array_length(a));
+    }
+    return array_alloc(env, array_length(a));
+}
+
+static void array_sparse_set(env_t *env, val_t *self, int id, val_t *v)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+    int pos = array_sparse_find(a, id) * 2;
+    val_t value = *v, *pairs;
+
+    // Note: value is copied, v may be moved by gc in reserve
+    a = array_sparse_reserve(env, self, 2);
+    if (!a) {
+        return;
+    }
+
+    pairs = array_values(a);
+    memmove(pairs + pos + 2, pairs + pos, sizeof(val_t) * (array_value_num(a) - pos));
+    val_set_number(pairs + pos, id);
+    pairs[pos + 1] = value;
+    a->elem_end += 2;
+    if (a->length <= (uint32_t) id) {
+        a->length = id + 1;
+    }
+    array_kind_update(a, &value);
+
+    // turn back to dense, when it is filled enough
+    if ((uint32_t) array_value_num(a) >= a->length) {
+        array_sparse_to_dense(env, self);
+    }
+}
+
+// Elements filled in dense array, holes are counted only if space is extended
+static int array_dense_count(array_t *a, int length)
+{
+    val_t *vals = array_values(a);
+    int i, n = 0, len = array_length(a);
+
+    if (a->elem_bgn + length <= a->elem_size) {
+        return length;
+    }
+    for (i = 0; i < len; i++) {
+        n += !val_is_undefined(vals + i);
+    }
+    return n;
+}
+
+// Set element out of range or in a hole, array is extended as need
+static void array_elem_extend_set(env_t *env, val_t *self, int id, val_t *v)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+    int len = array_length(a);
+
+    if (id < 0) {
+        env_set_error(env, ERR_HasNoneElement);
+        return;
+    } else
+    if (id >= ARRAY_LENGTH_MAX) {
+        env_set_error(env, ERR_ResourceOutLimit);
+        return;
+    }
+
+    if (!array_is_sparse(a) && !array_dense_enough(array_dense_count(a, id + 1), id + 1)) {
+        a = array_dense_to_sparse(env, self);
+        if (!a) {
+            return;
+        }
+    }
+
+    if (array_is_sparse(a)) {
+        array_sparse_set(env, self, id, v);
+    } else {
+        a = array_space_extend_tail(env, self, id + 1 - len);
+        if (a) {
+            val_t *elems = array_values(a);
+
+            if (len < id) {
+                a->kind = ARRAY_KIND_GENERIC;
+            }
+            for (; len < id; len++) {
+                val_set_undefined(elems + len);
+            }
+            elems[id] = *v;
+            a->elem_end = a->elem_bgn + id + 1;
+            array_kind_update(a, v);
+        }
+    }
+}
+
+/*
+ * Value is in array, equal as operator "==".
+ * Elements of number array are compared as double, four in a step.
+ */
+int array_has(array_t *a, val_t *v)
+{
+    val_t *vals = array_values(a);
+    int i = 0, n = array_value_num(a), step = 1;
+
+    // values of sparse array are the second of pairs
+    if (array_is_sparse(a)) {
+        i = 1;
+        step = 2;
+    }
+
+    if (array_is_number(a)) {
+        const double *p = (const double *) vals;
+        double d;
+
+        if (!val_is_number(v)) {
+            return 0;
+        }
+        d = val_2_double(v);
+
+        if (step == 1) {
+            for (; i + 4 <= n; i += 4) {
+                if ((p[i] == d) | (p[i + 1] == d) | (p[i + 2] == d) | (p[i + 3] == d)) {
+                    return 1;
+                }
+            }
+        }
+        for (; i < n; i += step) {
+            if (p[i] == d) {
+                return 1;
+            }
+        }
+    } else
+    if (val_is_string(v)) {
+        for (; i < n; i += step) {
+            if (val_is_string(vals + i) && !string_compare(vals + i, v)) {
+                return 1;
+            }
+        }
+    } else
+    if (!val_is_nan(v) && !val_is_undefined(v)) {
+        for (; i < n; i += step) {
+            if (vals[i] == *v) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static inline val_t *_array_elem_get(env_t *env, val_t *a, val_t *i) {
+    (void) env;
+    return array_elem_ref((array_t *) val_2_intptr(a), val_2_integer(i));
 }
 
 void array_elem_get(env_t *env, val_t *a, val_t *i, val_t *res)
@@ -81,8 +430,9 @@ void array_elem_set(env_t *env, val_t *a, val_t *i, val_t *v)
     val_t *elem = _array_elem_get(env, a, i);
     if (elem) {
         *elem = *v;
+        array_kind_update((array_t *)val_2_intptr(a), v);
     } else {
-        env_set_error(env, ERR_HasNoneElement);
+        array_elem_extend_set(env, a, val_2_integer(i), v);
     }
 }
 
@@ -95,10 +445,19 @@ void array_elem_add_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
             number_add(env, elem, v, elem);
         } else
         if (val_is_string(elem)) {
-            string_add(env, elem, v, elem);
+            val_t s;
+
+            string_add(env, elem, v, &s);
+            // Note: array may be moved by gc, in string add
+            elem = _array_elem_get(env, a, i);
+            if (!elem) {
+                return;
+            }
+            *elem = s;
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -115,6 +474,7 @@ void array_elem_sub_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -131,6 +491,7 @@ void array_elem_mul_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -147,6 +508,7 @@ void array_elem_div_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -163,6 +525,7 @@ void array_elem_mod_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -179,6 +542,7 @@ void array_elem_and_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -195,6 +559,7 @@ void array_elem_or_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -211,6 +576,7 @@ void array_elem_xor_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -227,6 +593,7 @@ void array_elem_lshift_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -243,6 +610,7 @@ void array_elem_rshift_set(env_t *env, val_t *a, val_t *i, val_t *v, val_t *r)
         } else {
             val_set_nan(elem);
         }
+        array_kind_update((array_t *)val_2_intptr(a), elem);
         *r = *elem;
     } else {
         env_set_error(env, ERR_HasNoneElement);
@@ -255,19 +623,19 @@ static array_t *array_space_extend_tail(env_t *env, val_t *self, int n)
     val_t *elems;
     int len;
 
-    if (a->elem_size - a->elem_end > n) {
+    if ((int)(a->elem_size - a->elem_end) > n) {
         return a;
     }
     len = array_length(a);
 
-    if (a->elem_size -len > n) {
-        memmove(a->elems, a->elems + a->elem_bgn, len);
+    if ((int)a->elem_size - len > n) {
+        memmove(a->elems, a->elems + a->elem_bgn, sizeof(val_t) * len);
         a->elem_bgn = 0;
         a->elem_end = len;
         return a;
     } else {
-        int size = SIZE_ALIGN_16(len + n);
-        if (size > UINT16_MAX) {
+        int size = array_space_size(len + n);
+        if (size - len < n) {
             env_set_error(env, ERR_ResourceOutLimit);
             return NULL;
         }
@@ -275,11 +643,13 @@ static array_t *array_space_extend_tail(env_t *env, val_t *self, int n)
         if (elems) {
             a = (array_t *)val_2_intptr(self);
             memcpy(elems, a->elems + a->elem_bgn, sizeof(val_t) * len);
+            a->elems = elems;
             a->elem_size = size;
             a->elem_bgn = 0;
             a->elem_end = len;
             return a;
         } else {
+            env_set_error(env, ERR_NotEnoughMemory);
             return NULL;
         }
     }
@@ -291,20 +661,20 @@ static array_t *array_space_extend_head(env_t *env, val_t *self, int n)
     val_t *elems;
     int len;
 
-    if (a->elem_bgn > n) {
+    if ((int)a->elem_bgn > n) {
         return a;
     }
     len = array_length(a);
 
-    if (a->elem_size - len > n) {
+    if ((int)a->elem_size - len > n) {
         n = a->elem_size - a->elem_end;
-        memmove(a->elems + a->elem_bgn + n, a->elems + a->elem_bgn, len);
+        memmove(a->elems + a->elem_bgn + n, a->elems + a->elem_bgn, sizeof(val_t) * len);
         a->elem_bgn += n;
         a->elem_end += n;
         return a;
     } else {
-        int size = SIZE_ALIGN_16(len + n);
-        if (size > UINT16_MAX) {
+        int size = array_space_size(len + n);
+        if (size - len < n) {
             env_set_error(env, ERR_ResourceOutLimit);
             return NULL;
         }
@@ -312,11 +682,13 @@ static array_t *array_space_extend_head(env_t *env, val_t *self, int n)
         if (elems) {
             a = (array_t *)val_2_intptr(self);
             memcpy(elems + size - len, a->elems + a->elem_bgn, sizeof(val_t) * len);
+            a->elems = elems;
             a->elem_size = size;
             a->elem_bgn = size - len;
             a->elem_end = size;
             return a;
         } else {
+            env_set_error(env, ERR_NotEnoughMemory);
             return NULL;
         }
     }
@@ -326,11 +698,22 @@ val_t array_push(env_t *env, int ac, val_t *av)
 {
     if (ac > 1 && val_is_array(av)) {
         int n = ac - 1;
-        array_t *a = array_space_extend_tail(env, av, n);
+        array_t *a = (array_t *)val_2_intptr(av);
 
+        if (array_is_sparse(a)) {
+            int i;
+
+            for (i = 1; i < ac && !env->error; i++) {
+                array_elem_extend_set(env, av, array_length((array_t *)val_2_intptr(av)), av + i);
+            }
+            return val_mk_number(array_length((array_t *)val_2_intptr(av)));
+        }
+
+        a = array_space_extend_tail(env, av, n);
         if (a) {
             memcpy(a->elems + a->elem_end, av + 1, sizeof(val_t) * n);
             a->elem_end += n;
+            array_kind_update_n(a, n, av + 1);
             return val_mk_number(array_length(a));
         }
     } else {
@@ -339,15 +722,62 @@ val_t array_push(env_t *env, int ac, val_t *av)
     return val_mk_undefined();
 }
 
+// Indexes of the sparse array are moved by n, elements are inserted or removed at head
+static void array_sparse_move(array_t *a, int n)
+{
+    val_t *pairs = array_values(a);
+    int i;
+
+    for (i = 0; i < array_value_num(a); i += 2) {
+        val_set_number(pairs + i, val_2_integer(pairs + i) + n);
+    }
+    a->length += n;
+}
+
+static val_t array_sparse_unshift(env_t *env, int ac, val_t *av)
+{
+    int i, n = ac - 1;
+    array_t *a = (array_t *)val_2_intptr(av);
+    val_t *pairs;
+
+    if (array_length(a) > ARRAY_LENGTH_MAX - n) {
+        env_set_error(env, ERR_ResourceOutLimit);
+        return val_mk_undefined();
+    }
+
+    a = array_sparse_reserve(env, av, n * 2);
+    if (!a) {
+        return val_mk_undefined();
+    }
+
+    array_sparse_move(a, n);
+    pairs = array_values(a);
+    memmove(pairs + n * 2, pairs, sizeof(val_t) * array_value_num(a));
+    for (i = 0; i < n; i++) {
+        val_set_number(pairs + i * 2, i);
+        pairs[i * 2 + 1] = av[i + 1];
+        array_kind_update(a, av + i + 1);
+    }
+    a->elem_end += n * 2;
+
+    return val_mk_number(array_length(a));
+}
+
 val_t array_unshift(env_t *env, int ac, val_t *av)
 {
     if (ac > 1 && val_is_array(av)) {
         int n = ac - 1;
-        array_t *a = array_space_extend_head(env, av, n);
+        array_t *a = (array_t *)val_2_intptr(av);
+
+        if (array_is_sparse(a)) {
+            return array_sparse_unshift(env, ac, av);
+        }
 
+        a = array_space_extend_head(env, av, n);
         if (a) {
             memcpy(a->elems + a->elem_bgn - n, av + 1, sizeof(val_t) * n);
             a->elem_bgn -= n;
+            array_kind_update_n(a, n, av + 1);
             return val_mk_number(array_length(a));
         }
     } else {
@@ -361,6 +791,17 @@ val_t array_pop(env_t *env, int ac, val_t *av)
     if (ac > 0 && val_is_array(av)) {
         array_t *a = (array_t *)val_2_intptr(av);
 
+        if (array_is_sparse(a)) {
+            int n = array_value_num(a);
+
+            if (array_length(a)) {
+                a->length--;
+                if (n && val_2_integer(array_values(a) + n - 2) == (int)a->length) {
+                    a->elem_end -= 2;
+                    return array_values(a)[n - 1];
+                }
+            }
+        } else
         if (array_length(a)) {
             return a->elems[--a->elem_end];
         }
@@ -375,6 +816,18 @@ val_t array_shift(env_t *env, int ac, val_t *av)
     if (ac > 0 && val_is_array(av)) {
         array_t *a = (array_t *)val_2_intptr(av);
 
+        if (array_is_sparse(a)) {
+            val_t *pairs = array_values(a), v = val_mk_undefined();
+
+            if (array_length(a)) {
+                if (array_value_num(a) && val_2_integer(pairs) == 0) {
+                    v = pairs[1];
+                    a->elem_bgn += 2;
+                }
+                array_sparse_move(a, -1);
+            }
+            return v;
+        } else
         if (array_length(a)) {
             return a->elems[a->elem_bgn++];
         }
@@ -384,17 +837,33 @@ val_t array_shift(env_t *env, int ac, val_t *av)
     return val_mk_undefined();
 }
 
+/*
+ * Elements are visited by array_next, in the length of start: holes of
+ * sparse array are skipped, and array may turn to sparse in callback.
+ */
+static inline int array_visit(val_t *self, int i, int max, val_t *elem) {
+    array_t *a = (array_t *)val_2_intptr(self);
+
+    i = array_next(a, i);
+    if (i < 0 || i >= max) {
+        return -1;
+    }
+    *elem = *array_elem_ref(a, i);
+    return i;
+}
+
 val_t array_foreach(env_t *env, int ac, val_t *av)
 {
     if (ac > 1 && val_is_array(av) && val_is_function(av + 1)) {
-        array_t *a = (array_t *)val_2_intptr(av);
-        int i, max = array_length(a);
+        int i, max = array_length((array_t *)val_2_intptr(av));
+        val_t elem;
 
-        for (i = 0; i < max && !env->error; i++) {
+        // Note: array may be moved by gc, in callback
+        for (i = array_visit(av, 0, max, &elem); i >= 0 && !env->error; i = array_visit(av, i + 1, max, &elem)) {
             val_t key = val_mk_number(i);
 
             env_push_call_argument(env, &key);
-            env_push_call_argument(env, array_values(a) + i);
+            env_push_call_argument(env, &elem);
             env_push_call_function(env, av + 1);
 
             interp_execute_call(env, 2);
@@ -403,3 +872,710 @@ val_t array_foreach(env_t *env, int ac, val_t *av)
 
     return val_mk_undefined();
 }
+
+/*
+ * map, filter & reduce are looped by interpreter when called from script,
+ * the native version is used when called with callback from native.
+ * The result array is allocated once, at the length of source.
+ */
+val_t array_map(env_t *env, int ac, val_t *av)
+{
+    if (ac > 1 && val_is_array(av) && val_is_function(av + 1)) {
+        int i, max = array_length((array_t *)val_2_intptr(av));
+        array_t *r = array_alloc_mapped(env, av);
+        val_t *res, elem;
+
+        if (!r) {
+            return val_mk_undefined();
+        }
+        // Note: result is kept in stack, for gc
+        res = env_stack_push(env);
+        val_set_array(res, (intptr_t) r);
+
+        for (i = array_visit(av, 0, max, &elem); i >= 0 && !env->error; i = array_visit(av, i + 1, max, &elem)) {
+            val_t key = val_mk_number(i), v;
+
+            env_push_call_argument(env, &key);
+            env_push_call_argument(env, &elem);
+            env_push_call_function(env, av + 1);
+
+            v = interp_execute_call(env, 2);
+            if (!env->error) {
+                array_elem_set(env, res, &key, &v);
+            }
+        }
+
+        return *env_stack_pop(env);
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+val_t array_filter(env_t *env, int ac, val_t *av)
+{
+    if (ac > 1 && val_is_array(av) && val_is_function(av + 1)) {
+        int i, max = array_length((array_t *)val_2_intptr(av));
+        array_t *r = array_alloc(env, array_elem_num((array_t *)val_2_intptr(av)));
+        val_t *res, elem;
+
+        if (!r) {
+            return val_mk_undefined();
+        }
+        // Note: result is kept in stack, for gc
+        res = env_stack_push(env);
+        val_set_array(res, (intptr_t) r);
+
+        for (i = array_visit(av, 0, max, &elem); i >= 0 && !env->error; i = array_visit(av, i + 1, max, &elem)) {
+            val_t key = val_mk_number(i), v;
+
+            env_push_call_argument(env, &key);
+            env_push_call_argument(env, &elem);
+            env_push_call_function(env, av + 1);
+
+            v = interp_execute_call(env, 2);
+
+            // element is read again, it may be changed in callback
+            if (val_is_true(&v) && !env->error && array_elem_ref((array_t *)val_2_intptr(av), i)) {
+                elem = *array_elem_ref((array_t *)val_2_intptr(av), i);
+                key = val_mk_number(array_length((array_t *)val_2_intptr(res)));
+                array_elem_set(env, res, &key, &elem);
+            }
+        }
+
+        return *env_stack_pop(env);
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+val_t array_reduce(env_t *env, int ac, val_t *av)
+{
+    if (ac > 1 && val_is_array(av) && val_is_function(av + 1)) {
+        int i = 0, max = array_length((array_t *)val_2_intptr(av));
+        val_t acc, elem;
+
+        if (ac > 2) {
+            acc = av[2];
+        } else
+        if ((i = array_visit(av, 0, max, &acc)) >= 0) {
+            i++;
+        } else {
+            return val_mk_undefined();
+        }
+
+        for (i = array_visit(av, i, max, &elem); i >= 0 && !env->error; i = array_visit(av, i + 1, max, &elem)) {
+            val_t key = val_mk_number(i);
+
+            env_push_call_argument(env, &key);
+            env_push_call_argument(env, &elem);
+            env_push_call_argument(env, &acc);
+            env_push_call_function(env, av + 1);
+
+            acc = interp_execute_call(env, 3);
+        }
+
+        return acc;
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+static int array_index(val_t *v, int len, int def)
+{
+    int i;
+
+    if (!val_is_number(v)) {
+        return def;
+    }
+
+    i = val_2_integer(v);
+    if (i < 0) {
+        i += len;
+    }
+    return i < 0 ? 0 : i > len ? len : i;
+}
+
+// Pairs in the range are copied, the holes of the range are kept
+static val_t array_sparse_slice(env_t *env, val_t *self, int bgn, int n)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+    int i, lo = array_sparse_find(a, bgn), hi = array_sparse_find(a, bgn + n);
+    array_t *r = array_alloc_sparse(env, hi - lo, n);
+    val_t *pairs, *res;
+
+    if (!r) {
+        return val_mk_undefined();
+    }
+
+    // Note: array may be moved by gc, in alloc
+    a = (array_t *)val_2_intptr(self);
+    pairs = array_values(a);
+    for (i = lo; i < hi; i++) {
+        val_set_number(r->elems + r->elem_end++, val_2_integer(pairs + i * 2) - bgn);
+        r->elems[r->elem_end++] = pairs[i * 2 + 1];
+    }
+    r->kind = a->kind;
+
+    // Note: result is kept in stack, for gc
+    res = env_stack_push(env);
+    val_set_array(res, (intptr_t) r);
+    array_sparse_settle(env, res);
+
+    return *env_stack_pop(env);
+}
+
+val_t array_slice(env_t *env, int ac, val_t *av)
+{
+    if (ac > 0 && val_is_array(av)) {
+        array_t *a = (array_t *)val_2_intptr(av);
+        int len = array_length(a);
+        int bgn = ac > 1 ? array_index(av + 1, len, 0) : 0;
+        int end = ac > 2 ? array_index(av + 2, len, len) : len;
+        int n = end > bgn ? end - bgn : 0;
+        array_t *r;
+
+        if (array_is_sparse(a)) {
+            return array_sparse_slice(env, av, bgn, n);
+        }
+
+        r = array_alloc(env, n);
+        if (r) {
+            // Note: array may be moved by gc, in alloc
+            a = (array_t *)val_2_intptr(av);
+            memcpy(r->elems, array_values(a) + bgn, sizeof(val_t) * n);
+            r->elem_end = n;
+            r->kind = a->kind;
+            return val_mk_array(r);
+        }
+    } else {
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return val_mk_undefined();
+}
+
+// Result of num elements is sparse, if any of the arrays is sparse
+static val_t array_sparse_concat(env_t *env, int ac, val_t *av, int num, int length)
+{
+    array_t *r = array_alloc_sparse(env, num, length);
+    val_t *res;
+    int i, j, off = 0;
+
+    if (!r) {
+        return val_mk_undefined();
+    }
+
+    // Note: arrays may be moved by gc, in alloc
+    for (i = 0; i < ac; i++) {
+        if (val_is_array(av + i)) {
+            array_t *a = (array_t *)val_2_intptr(av + i);
+            val_t *vals = array_values(a);
+
+            if (array_is_sparse(a)) {
+                for (j = 0; j < array_value_num(a); j += 2) {
+                    val_set_number(r->elems + r->elem_end++, val_2_integer(vals + j) + off);
+                    r->elems[r->elem_end++] = vals[j + 1];
+                }
+            } else {
+                for (j = 0; j < array_length(a); j++) {
+                    if (!val_is_undefined(vals + j)) {
+                        val_set_number(r->elems + r->elem_end++, j + off);
+                        r->elems[r->elem_end++] = vals[j];
+                    }
+                }
+            }
+            if (!array_is_number(a)) {
+                r->kind = ARRAY_KIND_GENERIC;
+            }
+            off += array_length(a);
+        } else {
+            val_set_number(r->elems + r->elem_end++, off++);
+            r->elems[r->elem_end++] = av[i];
+            array_kind_update(r, av + i);
+        }
+    }
+
+    // Note: result is kept in stack, for gc
+    res = env_stack_push(env);
+    val_set_array(res, (intptr_t) r);
+    array_sparse_settle(env, res);
+
+    return *env_stack_pop(env);
+}
+
+val_t array_concat(env_t *env, int ac, val_t *av)
+{
+    if (ac > 0 && val_is_array(av)) {
+        array_t *r;
+        int i, n = 0, num = 0, sparse = 0;
+
+        for (i = 0; i < ac; i++) {
+            array_t *a = val_is_array(av + i) ? (array_t *)val_2_intptr(av + i) : NULL;
+            int len = a ? array_length(a) : 1;
+
+            if (len > ARRAY_LENGTH_MAX - n) {
+                env_set_error(env, ERR_ResourceOutLimit);
+                return val_mk_undefined();
+            }
+            n += len;
+            num += a ? array_elem_num(a) : 1;
+            sparse |= a && array_is_sparse(a);
+        }
+
+        if (sparse) {
+            return array_sparse_concat(env, ac, av, num, n);
+        }
+
+        r = array_alloc(env, n);
+        if (r) {
+            // Note: arrays may be moved by gc, in alloc
+            for (i = 0; i < ac; i++) {
+                if (val_is_array(av + i)) {
+                    array_t *a = (array_t *)val_2_intptr(av + i);
+
+                    memcpy(r->elems + r->elem_end, array_values(a), sizeof(val_t) * array_length(a));
+                    r->elem_end += array_length(a);
+                    if (!array_is_number(a)) {
+                        r->kind = ARRAY_KIND_GENERIC;
+                    }
+                } else {
+                    r->elems[r->elem_end++] = av[i];
+                    array_kind_update(r, av + i);
+                }
+            }
+            return val_mk_array(r);
+        }
+    } else {
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return val_mk_undefined();
+}
+
+static inline int array_elem_equal(val_t *x, val_t *y) {
+    if (val_is_number(y)) {
+        return val_is_number(x) && val_2_double(x) == val_2_double(y);
+    } else
+    if (val_is_string(y)) {
+        return val_is_string(x) && !strcmp(val_2_cstring(x), val_2_cstring(y));
+    }
+    return *x == *y;
+}
+
+// Pairs are searched from i, holes are matched by undefined
+static int array_sparse_index_of(array_t *a, val_t *v, int i)
+{
+    val_t *pairs = array_values(a);
+    int pos, num = array_elem_num(a);
+
+    for (pos = array_sparse_find(a, i); pos < num; pos++) {
+        int id = val_2_integer(pairs + pos * 2);
+
+        if (val_is_undefined(v) && id > i) {
+            return i;
+        }
+        if (array_elem_equal(pairs + pos * 2 + 1, v)) {
+            return id;
+        }
+        i = id + 1;
+    }
+    return val_is_undefined(v) && i < array_length(a) ? i : -1;
+}
+
+val_t array_index_of(env_t *env, int ac, val_t *av)
+{
+    if (ac > 1 && val_is_array(av)) {
+        array_t *a = (array_t *)val_2_intptr(av);
+        val_t *vals = array_values(a);
+        int i, len = array_length(a);
+
+        i = ac > 2 ? array_index(av + 2, len, 0) : 0;
+        if (array_is_sparse(a)) {
+            return val_mk_number(array_sparse_index_of(a, av + 1, i));
+        } else
+        if (array_is_number(a)) {
+            double d = val_is_number(av + 1) ? val_2_double(av + 1) : 0;
+
+            for (; i < len && val_is_number(av + 1); i++) {
+                if (val_2_double(vals + i) == d) {
+                    return val_mk_number(i);
+                }
+            }
+        } else
+        if (val_is_number(av + 1)) {
+            double d = val_2_double(av + 1);
+
+            for (; i < len; i++) {
+                if (val_is_number(vals + i) && val_2_double(vals + i) == d) {
+                    return val_mk_number(i);
+                }
+            }
+        } else
+        if (val_is_string(av + 1)) {
+            const char *s = val_2_cstring(av + 1);
+
+            for (; i < len; i++) {
+                if (val_is_string(vals + i) && !strcmp(val_2_cstring(vals + i), s)) {
+                    return val_mk_number(i);
+                }
+            }
+        } else {
+            for (; i < len; i++) {
+                if (vals[i] == av[1]) {
+                    return val_mk_number(i);
+                }
+            }
+        }
+        return val_mk_number(-1);
+    } else {
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return val_mk_undefined();
+}
+
+static const char *array_elem_cstring(val_t *v, char *buf, int size)
+{
+    if (val_is_string(v)) {
+        return val_2_cstring(v);
+    } else
+    if (val_is_number(v)) {
+        snprintf(buf, size, "%.15g", val_2_double(v));
+        return buf;
+    } else
+    if (val_is_boolean(v)) {
+        return val_2_intptr(v) ? "true" : "false";
+    } else
+    if (val_is_nan(v)) {
+        return "NaN";
+    } else
+    if (val_is_undefined(v)) {
+        return "";
+    } else
+    if (val_is_array(v)) {
+        return "Array";
+    } else {
+        return "Object";
+    }
+}
+
+// Separators of n elements, holes of sparse array are joined as empty
+static char *array_join_sep(char *p, const char *sep, int sep_len, int n)
+{
+    for (; sep_len && n > 0; n--) {
+        memcpy(p, sep, sep_len);
+        p += sep_len;
+    }
+    return p;
+}
+
+val_t array_join(env_t *env, int ac, val_t *av)
+{
+    if (ac > 0 && val_is_array(av)) {
+        const char *sep = ac > 1 ? val_2_cstring(av + 1) : NULL;
+        array_t *a = (array_t *)val_2_intptr(av);
+        int i, k, n, len = 0, sep_len, head = 3;
+        char num[32], *buf;
+
+        sep = sep ? sep : ",";
+        sep_len = strlen(sep);
+        n = array_length(a);
+        for (i = array_next(a, 0); i >= 0 && len <= UINT16_MAX; i = array_next(a, i + 1)) {
+            len += strlen(array_elem_cstring(array_elem_ref(a, i), num, 32));
+        }
+        if (n > 1 && len + (int64_t)sep_len * (n - 1) > UINT16_MAX) {
+            len = UINT16_MAX + 1;
+        } else {
+            len += n > 1 ? sep_len * (n - 1) : 0;
+        }
+        if (len > UINT16_MAX) {
+            env_set_error(env, ERR_ResourceOutLimit);
+            return val_mk_undefined();
+        }
+
+        buf = env_heap_alloc(env, head + len + 1);
+        if (buf) {
+            char *p = buf + head;
+
+            // Note: array & separator may be moved by gc, in alloc
+            a = (array_t *)val_2_intptr(av);
+            sep = ac > 1 ? val_2_cstring(av + 1) : NULL;
+            sep = sep ? sep : ",";
+
+            buf[0] = MAGIC_STRING;
+            buf[1] = len >> 8;
+            buf[2] = len;
+            for (i = array_next(a, 0), k = 0; i >= 0; i = array_next(a, i + 1)) {
+                const char *s = array_elem_cstring(array_elem_ref(a, i), num, 32);
+                int l = strlen(s);
+
+                p = array_join_sep(p, sep, sep_len, i - k);
+                k = i;
+                memcpy(p, s, l);
+                p += l;
+            }
+            p = array_join_sep(p, sep, sep_len, n - 1 - k);
+            *p = 0;
+            return val_mk_owned_string((intptr_t) buf);
+        } else {
+            env_set_error(env, ERR_NotEnoughMemory);
+        }
+    } else {
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return val_mk_undefined();
+}
+
+/*
+ * Stable sort: short runs by insertion, then merged bottom-up with a temp
+ * array. Arrays of number or string are compared without interpreter,
+ * compare function of user is called only if it is given.
+ * Element pointers are fetched again after each compare, array may be
+ * moved by gc in compare function of user.
+ */
+#define SORT_RUN    16
+
+typedef struct array_sort_t {
+    env_t *env;
+    val_t *self;
+    val_t *temp;
+    val_t *func;
+    int  (*cmp)(struct array_sort_t *s, val_t *x, val_t *y);
+    int    len;
+} array_sort_t;
+
+static inline val_t *array_sort_elems(val_t *a) {
+    return array_values((array_t *)val_2_intptr(a));
+}
+
+static int array_sort_cmp_number(array_sort_t *s, val_t *x, val_t *y)
+{
+    double a = val_2_double(x), b = val_2_double(y);
+
+    (void) s;
+    return a < b ? -1 : a > b;
+}
+
+static int array_sort_cmp_string(array_sort_t *s, val_t *x, val_t *y)
+{
+    (void) s;
+    return strcmp(val_2_cstring(x), val_2_cstring(y));
+}
+
+static inline int array_sort_rank(val_t *v) {
+    return val_is_number(v) ? 0 : val_is_string(v) ? 1 : 2;
+}
+
+// number is ahead of string, and others keep their order
+static int array_sort_cmp_mixed(array_sort_t *s, val_t *x, val_t *y)
+{
+    int rx = array_sort_rank(x), ry = array_sort_rank(y);
+
+    if (rx != ry) {
+        return rx - ry;
+    } else
+    if (rx == 0) {
+        return array_sort_cmp_number(s, x, y);
+    } else
+    if (rx == 1) {
+        return array_sort_cmp_string(s, x, y);
+    } else {
+        return 0;
+    }
+}
+
+static int array_sort_cmp_call(array_sort_t *s, val_t *x, val_t *y)
+{
+    env_t *env = s->env;
+    val_t r;
+
+    env_push_call_argument(env, y);
+    env_push_call_argument(env, x);
+    env_push_call_function(env, s->func);
+
+    r = interp_execute_call(env, 2);
+    if (!env->error && (array_length((array_t *)val_2_intptr(s->self)) != s->len ||
+                        array_is_sparse((array_t *)val_2_intptr(s->self)))) {
+        // array is changed in compare function
+        env_set_error(env, ERR_InvalidInput);
+    }
+
+    if (val_is_number(&r)) {
+        double d = val_2_double(&r);
+        return d < 0 ? -1 : d > 0;
+    }
+    return 0;
+}
+
+static void array_sort_run(array_sort_t *s)
+{
+    env_t *env = s->env;
+    val_t *from = s->self, *to = s->temp;
+    int lo, i, j, k, w, n = s->len;
+
+    for (lo = 0; lo < n; lo += SORT_RUN) {
+        int hi = lo + SORT_RUN < n ? lo + SORT_RUN : n;
+
+        for (i = lo + 1; i < hi; i++) {
+            for (j = i; j > lo; j--) {
+                val_t *v = array_sort_elems(from), x;
+
+                if (s->cmp(s, v + j - 1, v + j) <= 0 || env->error) {
+                    break;
+                }
+                v = array_sort_elems(from);
+                x = v[j];
+                v[j] = v[j - 1];
+                v[j - 1] = x;
+            }
+            if (env->error) {
+                return;
+            }
+        }
+    }
+
+    for (w = SORT_RUN; w < n; w *= 2) {
+        val_t *swap;
+
+        for (lo = 0; lo < n; lo += 2 * w) {
+            int mid = lo + w < n ? lo + w : n;
+            int hi = lo + 2 * w < n ? lo + 2 * w : n;
+            val_t *src, *dst;
+
+            i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                int c;
+
+                src = array_sort_elems(from);
+                c = s->cmp(s, src + j, src + i);
+                if (env->error) {
+                    return;
+                }
+                src = array_sort_elems(from);
+                dst = array_sort_elems(to);
+                dst[k++] = c < 0 ? src[j++] : src[i++];
+            }
+            src = array_sort_elems(from);
+            dst = array_sort_elems(to);
+            memcpy(dst + k, src + i, sizeof(val_t) * (mid - i));
+            k += mid - i;
+            memcpy(dst + k, src + j, sizeof(val_t) * (hi - j));
+        }
+
+        swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != s->self) {
+        memcpy(array_sort_elems(s->self), array_sort_elems(from), sizeof(val_t) * n);
+    }
+}
+
+static void array_sort_dense(env_t *env, val_t *self, val_t *func)
+{
+    array_sort_t sort;
+    array_t *a = (array_t *)val_2_intptr(self), *t;
+    val_t *v;
+    int i, n = array_length(a);
+
+    if (n < 2) {
+        return;
+    }
+
+    sort.env  = env;
+    sort.self = self;
+    sort.func = func;
+    sort.len  = n;
+    if (sort.func) {
+        sort.cmp = array_sort_cmp_call;
+    } else
+    if (array_is_number(a)) {
+        sort.cmp = array_sort_cmp_number;
+    } else {
+        v = array_values(a);
+        for (i = 0; i < n && val_is_string(v + i); i++);
+        sort.cmp = i == n ? array_sort_cmp_string : array_sort_cmp_mixed;
+    }
+
+    t = array_alloc(env, n);
+    if (!t) {
+        return;
+    }
+    // Note: array may be moved by gc, in alloc
+    a = (array_t *)val_2_intptr(self);
+    memcpy(t->elems, array_values(a), sizeof(val_t) * n);
+    t->elem_end = n;
+    t->kind = a->kind;
+
+    // Note: temp array is kept in stack, for gc
+    sort.temp = env_stack_push(env);
+    val_set_array(sort.temp, (intptr_t) t);
+
+    array_sort_run(&sort);
+
+    env_stack_pop(env);
+}
+
+/*
+ * Values of sparse array are sorted in a dense copy, and written back to
+ * the head, holes are moved to the end.
+ */
+static void array_sort_sparse(env_t *env, val_t *self, val_t *func)
+{
+    array_t *a = (array_t *)val_2_intptr(self);
+    int i, num = array_elem_num(a), len = array_length(a);
+    array_t *d = array_alloc(env, num);
+    val_t *vals, *pairs;
+
+    if (!d) {
+        return;
+    }
+    // Note: array may be moved by gc, in alloc
+    a = (array_t *)val_2_intptr(self);
+    pairs = array_values(a);
+    for (i = 0; i < num; i++) {
+        d->elems[i] = pairs[i * 2 + 1];
+    }
+    d->elem_end = num;
+    d->kind = a->kind;
+
+    // Note: dense copy is kept in stack, for gc
+    vals = env_stack_push(env);
+    val_set_array(vals, (intptr_t) d);
+
+    array_sort_dense(env, vals, func);
+
+    a = (array_t *)val_2_intptr(self);
+    d = (array_t *)val_2_intptr(vals);
+    if (!env->error) {
+        // array may be changed in compare function of user
+        if (!array_is_sparse(a) || array_elem_num(a) != num || array_length(a) != len) {
+            env_set_error(env, ERR_InvalidInput);
+        } else {
+            pairs = array_values(a);
+            for (i = 0; i < num; i++) {
+                val_set_number(pairs + i * 2, i);
+                pairs[i * 2 + 1] = d->elems[i];
+            }
+        }
+    }
+
+    env_stack_pop(env);
+}
+
+val_t array_sort(env_t *env, int ac, val_t *av)
+{
+    if (ac < 1 || !val_is_array(av) || (ac > 1 && !val_is_function(av + 1))) {
+        env_set_error(env, ERR_InvalidInput);
+        return val_mk_undefined();
+    }
+
+    if (array_is_sparse((array_t *)val_2_intptr(av))) {
+        array_sort_sparse(env, av, ac > 1 ? av + 1 : NULL);
+    } else {
+        array_sort_dense(env, av, ac > 1 ? av + 1 : NULL);
+    }
+
+    return *av;
+}
@@ -33,29 +33,101 @@ SOFTWARE.
 
 #define MAGIC_ARRAY         (MAGIC_BASE + 11)
 
+// Kind of elements, generic array never turn back to number array
+#define ARRAY_KIND_GENERIC  0
+#define ARRAY_KIND_NUMBER   1   // only number is held, elements are not scanned by gc
+
+// Layout of elements
+#define ARRAY_LAYOUT_DENSE  0   // elements in order, holes are undefined
+#define ARRAY_LAYOUT_SPARSE 1   // pairs of (index, value), sorted by index
+
+// Array turn to sparse, if less than 1/ARRAY_DENSE_RATIO of it will be filled
+#define ARRAY_DENSE_RATIO   4
+#define ARRAY_DENSE_MIN     64
+
+#define ARRAY_SIZE_MAX      ((INT32_MAX - (int)sizeof(struct array_t)) / (int)sizeof(val_t))
+#define ARRAY_LENGTH_MAX    INT32_MAX
+
 typedef struct array_t {
     uint8_t magic;
     uint8_t age;
-    uint16_t elem_size;
-    uint16_t elem_bgn;
-    uint16_t elem_end;
+    uint8_t kind;
+    uint8_t layout;
+    uint32_t elem_size;
+    uint32_t elem_bgn;
+    uint32_t elem_end;
+    uint32_t length;            // length of sparse array
     val_t *elems;
 } array_t;
 
+val_t *array_sparse_ref(array_t *a, int id);
+
 static inline int array_mem_space(array_t *a) {
     return SIZE_ALIGN(sizeof(array_t) + sizeof(val_t) * a->elem_size);
 }
 
+static inline int array_is_sparse(array_t *a) {
+    return a->layout == ARRAY_LAYOUT_SPARSE;
+}
+
+// Values held in elems, which are pairs for sparse array
 static inline val_t *array_values(array_t *a) {
     return a->elems + a->elem_bgn;
 }
 
-static inline int array_length(array_t *a) {
+static inline int array_value_num(array_t *a) {
     return a->elem_end - a->elem_bgn;
 }
 
+static inline int array_length(array_t *a) {
+    return array_is_sparse(a) ? (int)a->length : (int)(a->elem_end - a->elem_bgn);
+}
+
+// Elements held, holes of sparse array are not counted
+static inline int array_elem_num(array_t *a) {
+    return array_is_sparse(a) ? array_value_num(a) / 2 : array_value_num(a);
+}
+
+static inline int array_dense_enough(int num, int length) {
+    return length <= ARRAY_DENSE_MIN || length / ARRAY_DENSE_RATIO <= num;
+}
+
+static inline int array_is_number(array_t *a) {
+    return a->kind == ARRAY_KIND_NUMBER;
+}
+
+static inline void array_kind_update(array_t *a, val_t *v) {
+    if (!val_is_number(v)) {
+        a->kind = ARRAY_KIND_GENERIC;
+    }
+}
+
+static inline void array_kind_update_n(array_t *a, int n, val_t *v) {
+    int i;
+
+    for (i = 0; i < n && array_is_number(a); i++) {
+        array_kind_update(a, v + i);
+    }
+}
+
+// Return NULL, if out of range or a hole of sparse array
+static inline val_t *array_elem_ref(array_t *a, int id) {
+    if (array_is_sparse(a)) {
+        return array_sparse_ref(a, id);
+    } else
+    if (id >= 0 && id < array_length(a)) {
+        return a->elems + (a->elem_bgn + id);
+    } else {
+        return NULL;
+    }
+}
+
+array_t *array_alloc(env_t *env, int size);
+array_t *array_alloc_mapped(env_t *env, val_t *self);
+int array_next(array_t *a, int i);
 intptr_t array_create(env_t *env, int ac, val_t *av);
 
+int  array_has(array_t *a, val_t *v);
 void array_elem_get(env_t *env, val_t *a, val_t *i, val_t *e);
 
 void array_elem_set(env_t *env, val_t *a, val_t *i, val_t *v);
@@ -75,6 +147,14 @@ val_t array_pop(env_t *env, int ac, val_t *av);
 val_t array_shift(env_t *env, int ac, val_t *av);
 val_t array_unshift(env_t *env, int ac, val_t *av);
 val_t array_foreach(env_t *env, int ac, val_t *av);
+val_t array_map(env_t *env, int ac, val_t *av);
+val_t array_filter(env_t *env, int ac, val_t *av);
+val_t array_reduce(env_t *env, int ac, val_t *av);
+val_t array_slice(env_t *env, int ac, val_t *av);
+val_t array_concat(env_t *env, int ac, val_t *av);
+val_t array_index_of(env_t *env, int ac, val_t *av);
+val_t array_join(env_t *env, int ac, val_t *av);
+val_t array_sort(env_t *env, int ac, val_t *av);
 
 
 
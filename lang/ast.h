@@ -45,6 +45,7 @@ enum EXPR_TYPE {
     EXPR_NEG,
     EXPR_NOT,
     EXPR_LOGIC_NOT,
+    EXPR_AWAIT,
     EXPR_ARRAY,
     EXPR_DICT,
 
@@ -98,6 +99,7 @@ enum EXPR_TYPE {
     EXPR_FUNCDEF,
     EXPR_FUNCHEAD,
     EXPR_PAIR,
+    EXPR_RANGE,
 
     EXPR_DUMMY
 };
@@ -108,9 +110,13 @@ enum STMT_TYPE {
     STMT_VAR,
     STMT_RET,
     STMT_WHILE,
+    STMT_FOR,
+    STMT_SWITCH,
+    STMT_CASE,
     STMT_BREAK,
     STMT_CONTINUE,
     STMT_THROW,
+    STMT_YIELD,
     STMT_TRY,
     STMT_PASS,
 };
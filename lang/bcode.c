@@ -188,6 +188,172 @@ int bcode_parse(const uint8_t *code, int *offset, const char **name, int *param1
     case BC_ELEM_LSHIFT_ASSIGN:     *name = "ELEM_LS_ASSIGN"; if(offset) *offset = shift; return 0;
     case BC_ELEM_RSHIFT_ASSIGN:     *name = "ELEM_RS_ASSIGN"; if(offset) *offset = shift; return 0;
 
+    case BC_MUL_NN:     *name = "MUL_NN"; if(offset) *offset = shift; return 0;
+    case BC_DIV_NN:     *name = "DIV_NN"; if(offset) *offset = shift; return 0;
+    case BC_MOD_NN:     *name = "MOD_NN"; if(offset) *offset = shift; return 0;
+    case BC_ADD_NN:     *name = "ADD_NN"; if(offset) *offset = shift; return 0;
+    case BC_SUB_NN:     *name = "SUB_NN"; if(offset) *offset = shift; return 0;
+    case BC_LSHIFT_NN:  *name = "LSHIFT_NN"; if(offset) *offset = shift; return 0;
+    case BC_RSHIFT_NN:  *name = "RSHIFT_NN"; if(offset) *offset = shift; return 0;
+    case BC_AAND_NN:    *name = "LOGIC_AND_NN"; if(offset) *offset = shift; return 0;
+    case BC_AOR_NN:     *name = "LOGIC_OR_NN"; if(offset) *offset = shift; return 0;
+    case BC_AXOR_NN:    *name = "LOGIC_XOR_NN"; if(offset) *offset = shift; return 0;
+
+    case BC_TEQ_NN:     *name = "TEQ_NN"; if(offset) *offset = shift; return 0;
+    case BC_TNE_NN:     *name = "TNE_NN"; if(offset) *offset = shift; return 0;
+    case BC_TGT_NN:     *name = "TGT_NN"; if(offset) *offset = shift; return 0;
+    case BC_TGE_NN:     *name = "TGE_NN"; if(offset) *offset = shift; return 0;
+    case BC_TLT_NN:     *name = "TLT_NN"; if(offset) *offset = shift; return 0;
+    case BC_TLE_NN:     *name = "TLE_NN"; if(offset) *offset = shift; return 0;
+
+    case BC_ADD_ASSIGN_NN: *name = "ADD_ASSIGN_NN"; if(offset) *offset = shift; return 0;
+    case BC_SUB_ASSIGN_NN: *name = "SUB_ASSIGN_NN"; if(offset) *offset = shift; return 0;
+
+    case BC_ADD_NUM:    *name = "ADD_NUM"; if(offset) *offset = shift; return 0;
+    case BC_SUB_NUM:    *name = "SUB_NUM"; if(offset) *offset = shift; return 0;
+    case BC_ELEM_ARRAY: *name = "ELEM_ARRAY"; if(offset) *offset = shift; return 0;
+    case BC_PROP_CACHE: *name = "PROP_CACHE"; if(offset) *offset = shift; return 0;
+    case BC_PROP_METH_CACHE: *name = "PROP_METH_CACHE"; if(offset) *offset = shift; return 0;
+
+    case BC_TEQ_SJMP_F: *param1 = (int8_t) (code[shift++]);
+                        *name = "TEQ_SJMP_F"; if(offset) *offset = shift; return 1;
+    case BC_TEQ_JMP_F:  index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "TEQ_JMP_F"; if(offset) *offset = shift; return 1;
+
+    case BC_TNE_SJMP_F: *param1 = (int8_t) (code[shift++]);
+                        *name = "TNE_SJMP_F"; if(offset) *offset = shift; return 1;
+    case BC_TNE_JMP_F:  index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "TNE_JMP_F"; if(offset) *offset = shift; return 1;
+
+    case BC_TGT_SJMP_F: *param1 = (int8_t) (code[shift++]);
+                        *name = "TGT_SJMP_F"; if(offset) *offset = shift; return 1;
+    case BC_TGT_JMP_F:  index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "TGT_JMP_F"; if(offset) *offset = shift; return 1;
+
+    case BC_TGE_SJMP_F: *param1 = (int8_t) (code[shift++]);
+                        *name = "TGE_SJMP_F"; if(offset) *offset = shift; return 1;
+    case BC_TGE_JMP_F:  index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "TGE_JMP_F"; if(offset) *offset = shift; return 1;
+
+    case BC_TLT_SJMP_F: *param1 = (int8_t) (code[shift++]);
+                        *name = "TLT_SJMP_F"; if(offset) *offset = shift; return 1;
+    case BC_TLT_JMP_F:  index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "TLT_JMP_F"; if(offset) *offset = shift; return 1;
+
+    case BC_TLE_SJMP_F: *param1 = (int8_t) (code[shift++]);
+                        *name = "TLE_SJMP_F"; if(offset) *offset = shift; return 1;
+    case BC_TLE_JMP_F:  index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "TLE_JMP_F"; if(offset) *offset = shift; return 1;
+
+    case BC_STORE_VAR: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "STORE_VAR"; if(offset) *offset = shift; return 2;
+
+    case BC_STORE_VAR_POP: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "STORE_VAR_POP"; if(offset) *offset = shift; return 2;
+
+    case BC_ADD_STORE_VAR: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "ADD_STORE_VAR"; if(offset) *offset = shift; return 2;
+
+    case BC_SUB_STORE_VAR: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "SUB_STORE_VAR"; if(offset) *offset = shift; return 2;
+
+    case BC_ADD_STORE_VAR_NN: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "ADD_STORE_VAR_NN"; if(offset) *offset = shift; return 2;
+
+    case BC_SUB_STORE_VAR_NN: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "SUB_STORE_VAR_NN"; if(offset) *offset = shift; return 2;
+
+    case BC_PUSH_CLOSURE:index = (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *param2 = (code[shift++]);
+                        shift += *param2 * 2;
+                        *name  = "PUSH_CLOSURE"; if(offset) *offset = shift; return 2;
+
+    case BC_BOX_VAR:    *param1 = (code[shift++]);
+                        *name  = "BOX_VAR"; if(offset) *offset = shift; return 1;
+
+    case BC_PUSH_CELL: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "PUSH_CELL"; if(offset) *offset = shift; return 2;
+
+    case BC_STORE_CELL: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "STORE_CELL"; if(offset) *offset = shift; return 2;
+
+    case BC_STORE_CELL_POP: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "STORE_CELL_POP"; if(offset) *offset = shift; return 2;
+
+    case BC_ADD_STORE_CELL: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "ADD_STORE_CELL"; if(offset) *offset = shift; return 2;
+
+    case BC_SUB_STORE_CELL: *param1 = (code[shift++]);
+                        *param2 = (code[shift++]);
+                        *name  = "SUB_STORE_CELL"; if(offset) *offset = shift; return 2;
+
+    case BC_TAIL_CALL:  *param1 = code[shift++];
+                        *name = "TAIL_CALL"; if(offset) *offset = shift; return 1;
+
+    case BC_CALL0:      *param1 = 0; *name = "CALL0"; if(offset) *offset = shift; return 1;
+    case BC_CALL1:      *param1 = 1; *name = "CALL1"; if(offset) *offset = shift; return 1;
+    case BC_CALL2:      *param1 = 2; *name = "CALL2"; if(offset) *offset = shift; return 1;
+    case BC_CALL3:      *param1 = 3; *name = "CALL3"; if(offset) *offset = shift; return 1;
+
+    case BC_FOREACH_NEXT: *name = "FOREACH_NEXT"; if(offset) *offset = shift; return 0;
+
+    case BC_FOR_RANGE_SJMP: *param1 = (int8_t) (code[shift++]);
+                        *name = "FOR_RANGE_SJMP"; if(offset) *offset = shift; return 1;
+    case BC_FOR_RANGE_JMP:  index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "FOR_RANGE_JMP"; if(offset) *offset = shift; return 1;
+
+    case BC_FOR_EACH_SJMP: *param1 = (int8_t) (code[shift++]);
+                        *name = "FOR_EACH_SJMP"; if(offset) *offset = shift; return 1;
+    case BC_FOR_EACH_JMP:  index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "FOR_EACH_JMP"; if(offset) *offset = shift; return 1;
+
+    case BC_SWITCH_TABLE: index = (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        index = (code[shift++]);
+                        *param2 = (index << 8) | (code[shift++]);
+                        *name = "SWITCH_TABLE"; if(offset) *offset = shift; return 2;
+
+    case BC_SWITCH_NUM: index = (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        shift += *param1 * 2;
+                        *name = "SWITCH_NUM"; if(offset) *offset = shift; return 1;
+
+    case BC_SWITCH_STR: index = (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        shift += *param1 * 2;
+                        *name = "SWITCH_STR"; if(offset) *offset = shift; return 1;
+
+    case BC_CASE_JMP:   index = (int8_t) (code[shift++]);
+                        *param1 = (index << 8) | (code[shift++]);
+                        *name = "CASE_JMP"; if(offset) *offset = shift; return 1;
+
+    case BC_THROW:      *name = "THROW"; if(offset) *offset = shift; return 0;
+
+    case BC_GEN_START:  *name = "GEN_START"; if(offset) *offset = shift; return 0;
+    case BC_YIELD:      *name = "YIELD"; if(offset) *offset = shift; return 0;
+    case BC_GEN_RET:    *name = "GEN_RET"; if(offset) *offset = shift; return 0;
+    case BC_ASYNC:      *name = "ASYNC"; if(offset) *offset = shift; return 0;
+    case BC_AWAIT:      *name = "AWAIT"; if(offset) *offset = shift; return 0;
+
     default:            *name = "UNKNOWN"; if(offset) *offset = shift; return 0;
     }
 }
@@ -134,6 +134,123 @@ typedef enum bcode_t {
     BC_ARRAY,
     BC_DICT,
 
+    // Number specialised, operands are proved to be number by compiler.
+    // Keep the same order as the generic one: BC_MUL ... BC_TLE
+    BC_MUL_NN,
+    BC_DIV_NN,
+    BC_MOD_NN,
+    BC_ADD_NN,
+    BC_SUB_NN,
+    BC_LSHIFT_NN,
+    BC_RSHIFT_NN,
+    BC_AAND_NN,
+    BC_AOR_NN,
+    BC_AXOR_NN,
+
+    BC_TEQ_NN,
+    BC_TNE_NN,
+    BC_TGT_NN,
+    BC_TGE_NN,
+    BC_TLT_NN,
+    BC_TLE_NN,
+
+    BC_ADD_ASSIGN_NN,
+    BC_SUB_ASSIGN_NN,
+
+    // Quickened by interpreter at runtime, never emitted by compiler.
+    // Guard failure fall back to the generic one.
+    BC_ADD_NUM,
+    BC_SUB_NUM,
+    BC_ELEM_ARRAY,
+    BC_PROP_CACHE,
+    BC_PROP_METH_CACHE,
+
+    // Compare then jump if the result is false, pop the operands.
+    // Short form follow the long form, keep the order of BC_TEQ ... BC_TLE
+    BC_TEQ_JMP_F,
+    BC_TEQ_SJMP_F,
+    BC_TNE_JMP_F,
+    BC_TNE_SJMP_F,
+    BC_TGT_JMP_F,
+    BC_TGT_SJMP_F,
+    BC_TGE_JMP_F,
+    BC_TGE_SJMP_F,
+    BC_TLT_JMP_F,
+    BC_TLT_SJMP_F,
+    BC_TLE_JMP_F,
+    BC_TLE_SJMP_F,
+
+    // Store to variable: id, generation. Emitted for the assignment of
+    // variable, the reference is not pushed.
+    BC_STORE_VAR,           // value => value
+    BC_STORE_VAR_POP,       // value =>
+    BC_ADD_STORE_VAR,       // value =>
+    BC_SUB_STORE_VAR,       // value =>
+    BC_ADD_STORE_VAR_NN,
+    BC_SUB_STORE_VAR_NN,
+
+    // Closure: function id(u16), number of captured variables(u8),
+    // followed by id & generation of each captured variable.
+    // Captured value is copied to the upvalue scope of closure.
+    BC_PUSH_CLOSURE,
+
+    // Variable captured and assigned is boxed as a cell, shared by closures
+    BC_BOX_VAR,             // id: box the variable of current scope
+    BC_PUSH_CELL,           // id, generation
+    BC_STORE_CELL,
+    BC_STORE_CELL_POP,
+    BC_ADD_STORE_CELL,
+    BC_SUB_STORE_CELL,
+
+    // Call in return position, followed by BC_RET for the native function.
+    // The frame of caller is reused by script function.
+    BC_TAIL_CALL,           // argc
+
+    // Call with the number of arguments in opcode
+    BC_CALL0,
+    BC_CALL1,
+    BC_CALL2,
+    BC_CALL3,
+
+    // Resume the foreach (map, filter, reduce) loop of native, placed as return
+    // address of callback.
+    // It is never emitted by compiler.
+    BC_FOREACH_NEXT,        // result =>
+
+    // Step the loop of for statement, the state is kept on the stack.
+    // Push the value of this round, or jump out if it is finished.
+    // Short form follow the long form.
+    BC_FOR_RANGE_JMP,       // counter, limit => counter, limit, number
+    BC_FOR_RANGE_SJMP,
+    BC_FOR_EACH_JMP,        // array, index => array, index, element
+    BC_FOR_EACH_SJMP,
+
+    // Switch: pop the value, and jump by the entries of BC_CASE_JMP followed,
+    // the first entry is the default one.
+    BC_SWITCH_TABLE,        // value => ; lo(number id), n: entry of value is 1 + value - lo
+    BC_SWITCH_NUM,          // value => ; n, followed by id of n numbers sorted
+    BC_SWITCH_STR,          // value => ; n, followed by id of n strings sorted
+    BC_CASE_JMP,            // entry of switch, long form only
+
+    // Raise the value, the handler is searched in the table of function,
+    // see executable_func_handler.
+    BC_THROW,               // value =>
+
+    // Generator: function with yield statement is started by BC_GEN_START,
+    // which return a generator to caller, instead of running the body.
+    // BC_YIELD detaches the frame into the generator, and return the value to
+    // the one resumed it, see interp_generator_resume. BC_GEN_RET finish it.
+    BC_GEN_START,           // => generator, at offset 0 of code only
+    BC_YIELD,               // value =>
+    BC_GEN_RET,             // value =>
+
+    // Async: function with await is started by BC_ASYNC, which place the
+    // generator of frame at the bottom of stack, and run the body. BC_AWAIT
+    // detaches the frame when the future is pending, and return the future
+    // of result to caller, see interp_async_await. BC_GEN_RET settle it.
+    BC_ASYNC,               // => generator, at offset 0 of code only
+    BC_AWAIT,               // value => result
+
 } bcode_t;
 
 int bcode_parse(const uint8_t *code, int *offset, const char **name, int *param1, int *param2);
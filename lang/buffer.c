@@ -0,0 +1,330 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "err.h"
+#include "string.h"
+#include "array.h"
+#include "buffer.h"
+
+buffer_t *buffer_alloc(env_t *env, int size)
+{
+    buffer_t *b;
+
+    if (size < 0) {
+        env_set_error(env, ERR_InvalidInput);
+        return NULL;
+    }
+
+    b = env_heap_alloc(env, sizeof(buffer_t) + size);
+    if (b) {
+        b->magic = MAGIC_BUFFER;
+        b->age = 0;
+        b->reserved = 0;
+        b->size = size;
+        b->offset = 0;
+        b->base = b;
+        memset(b + 1, 0, size);
+    } else {
+        env_set_error(env, ERR_NotEnoughMemory);
+    }
+
+    return b;
+}
+
+void buffer_elem_get(env_t *env, val_t *self, val_t *i, val_t *elem)
+{
+    buffer_t *b = (buffer_t *)val_2_intptr(self);
+    int id = val_2_integer(i);
+
+    (void) env;
+    if (id >= 0 && id < buffer_length(b)) {
+        val_set_number(elem, buffer_data(b)[id]);
+    } else {
+        val_set_undefined(elem);
+    }
+}
+
+void buffer_elem_set(env_t *env, val_t *self, val_t *i, val_t *v)
+{
+    buffer_t *b = (buffer_t *)val_2_intptr(self);
+    int id = val_2_integer(i);
+
+    if (id >= 0 && id < buffer_length(b) && val_is_number(v)) {
+        buffer_data(b)[id] = val_2_integer(v);
+    } else {
+        env_set_error(env, ERR_HasNoneElement);
+    }
+}
+
+/*
+ * Operate the element with v, and store back as byte. The result is
+ * the value before truncated, as the array does.
+ */
+void buffer_elem_op_set(env_t *env, val_t *self, val_t *i, val_t *v, val_t *r,
+                        void (*op)(env_t *, val_t *, val_t *, val_t *))
+{
+    val_t elem;
+
+    buffer_elem_get(env, self, i, &elem);
+    if (!val_is_number(&elem)) {
+        env_set_error(env, ERR_HasNoneElement);
+        return;
+    }
+
+    op(env, &elem, v, &elem);
+    buffer_elem_set(env, self, i, &elem);
+    *r = elem;
+}
+
+val_t buffer_create(env_t *env, int ac, val_t *av)
+{
+    buffer_t *b;
+    int i, size;
+
+    if (ac < 1) {
+        env_set_error(env, ERR_InvalidInput);
+        return val_mk_undefined();
+    }
+
+    if (val_is_number(av)) {
+        size = val_2_integer(av);
+    } else
+    if (val_is_string(av)) {
+        size = string_len(av);
+    } else
+    if (val_is_array(av)) {
+        size = array_length((array_t *)val_2_intptr(av));
+    } else {
+        env_set_error(env, ERR_InvalidInput);
+        return val_mk_undefined();
+    }
+
+    b = buffer_alloc(env, size);
+    if (!b) {
+        return val_mk_undefined();
+    }
+
+    // Note: argument may be moved by gc, in alloc
+    if (val_is_string(av)) {
+        memcpy(buffer_data(b), val_2_cstring(av), size);
+    } else
+    if (val_is_array(av)) {
+        array_t *a = (array_t *)val_2_intptr(av);
+
+        // Note: holes of sparse array are zero
+        for (i = 0; i < size; i++) {
+            val_t *v = array_elem_ref(a, i);
+
+            buffer_data(b)[i] = v && val_is_number(v) ? val_2_integer(v) : 0;
+        }
+    }
+
+    return val_mk_buffer(b);
+}
+
+static int buffer_index(val_t *v, int len, int def)
+{
+    int i;
+
+    if (!val_is_number(v)) {
+        return def;
+    }
+
+    i = val_2_integer(v);
+    if (i < 0) {
+        i += len;
+    }
+    return i < 0 ? 0 : i > len ? len : i;
+}
+
+val_t buffer_slice(env_t *env, int ac, val_t *av)
+{
+    if (ac > 0 && val_is_buffer(av)) {
+        int len = buffer_length((buffer_t *)val_2_intptr(av));
+        int bgn = ac > 1 ? buffer_index(av + 1, len, 0) : 0;
+        int end = ac > 2 ? buffer_index(av + 2, len, len) : len;
+        buffer_t *s = env_heap_alloc(env, sizeof(buffer_t));
+
+        if (s) {
+            // Note: buffer may be moved by gc, in alloc
+            buffer_t *b = (buffer_t *)val_2_intptr(av);
+
+            s->magic = MAGIC_BUFFER;
+            s->age = 0;
+            s->reserved = 0;
+            s->size = end > bgn ? end - bgn : 0;
+            s->offset = b->offset + bgn;
+            s->base = b->base;
+            return val_mk_buffer(s);
+        } else {
+            env_set_error(env, ERR_NotEnoughMemory);
+        }
+    } else {
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return val_mk_undefined();
+}
+
+/*
+ * Arguments of read: offset, size, little endian or not (big endian as default)
+ * Arguments of write: offset, size, value, little endian or not
+ * Return the bytes at offset, NULL if out of range.
+ */
+static uint8_t *buffer_access(env_t *env, int ac, val_t *av, int min, int max)
+{
+    buffer_t *b;
+    int off, size;
+
+    if (ac < 3 || !val_is_buffer(av) || !val_is_number(av + 1) || !val_is_number(av + 2)) {
+        env_set_error(env, ERR_InvalidInput);
+        return NULL;
+    }
+
+    b = (buffer_t *)val_2_intptr(av);
+    off = val_2_integer(av + 1);
+    size = val_2_integer(av + 2);
+    if (size < min || size > max || off < 0 || off + size > buffer_length(b)) {
+        env_set_error(env, ERR_InvalidInput);
+        return NULL;
+    }
+
+    return buffer_data(b) + off;
+}
+
+static uint64_t buffer_get(uint8_t *p, int size, int le)
+{
+    uint64_t u = 0;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        u |= (uint64_t) p[le ? i : size - 1 - i] << (i * 8);
+    }
+    return u;
+}
+
+static void buffer_put(uint8_t *p, int size, int le, uint64_t u)
+{
+    int i;
+
+    for (i = 0; i < size; i++) {
+        p[le ? i : size - 1 - i] = u >> (i * 8);
+    }
+}
+
+val_t buffer_read_uint(env_t *env, int ac, val_t *av)
+{
+    uint8_t *p = buffer_access(env, ac, av, 1, 6);
+
+    if (p) {
+        return val_mk_number(buffer_get(p, val_2_integer(av + 2), ac > 3 && val_is_true(av + 3)));
+    }
+    return val_mk_undefined();
+}
+
+val_t buffer_read_int(env_t *env, int ac, val_t *av)
+{
+    uint8_t *p = buffer_access(env, ac, av, 1, 6);
+
+    if (p) {
+        int size = val_2_integer(av + 2);
+        uint64_t u = buffer_get(p, size, ac > 3 && val_is_true(av + 3));
+
+        // sign extend
+        if (u & ((uint64_t)1 << (size * 8 - 1))) {
+            u |= ~(uint64_t)0 << (size * 8);
+        }
+        return val_mk_number((int64_t) u);
+    }
+    return val_mk_undefined();
+}
+
+val_t buffer_read_float(env_t *env, int ac, val_t *av)
+{
+    uint8_t *p = buffer_access(env, ac, av, 4, 8);
+
+    if (p) {
+        int size = val_2_integer(av + 2);
+        uint64_t u = buffer_get(p, size, ac > 3 && val_is_true(av + 3));
+
+        if (size == 4) {
+            union { uint32_t u; float f; } f32;
+
+            f32.u = u;
+            return val_mk_number(f32.f);
+        } else
+        if (size == 8) {
+            union { uint64_t u; double d; } f64;
+
+            f64.u = u;
+            return val_mk_number(f64.d);
+        }
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return val_mk_undefined();
+}
+
+val_t buffer_write_int(env_t *env, int ac, val_t *av)
+{
+    uint8_t *p = buffer_access(env, ac, av, 1, 6);
+
+    if (p && val_is_number(av + 3)) {
+        int size = val_2_integer(av + 2);
+
+        buffer_put(p, size, ac > 4 && val_is_true(av + 4), (uint64_t)(int64_t) val_2_double(av + 3));
+        return val_mk_number(val_2_integer(av + 1) + size);
+    } else
+    if (p) {
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return val_mk_undefined();
+}
+
+val_t buffer_write_float(env_t *env, int ac, val_t *av)
+{
+    uint8_t *p = buffer_access(env, ac, av, 4, 8);
+
+    if (p && val_is_number(av + 3)) {
+        int size = val_2_integer(av + 2);
+        int le = ac > 4 && val_is_true(av + 4);
+
+        if (size == 4) {
+            union { uint32_t u; float f; } f32;
+
+            f32.f = val_2_double(av + 3);
+            buffer_put(p, size, le, f32.u);
+            return val_mk_number(val_2_integer(av + 1) + size);
+        } else
+        if (size == 8) {
+            union { uint64_t u; double d; } f64;
+
+            f64.d = val_2_double(av + 3);
+            buffer_put(p, size, le, f64.u);
+            return val_mk_number(val_2_integer(av + 1) + size);
+        }
+    }
+    if (p) {
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return val_mk_undefined();
+}
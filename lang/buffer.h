@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __LANG_BUFFER_INC__
+#define __LANG_BUFFER_INC__
+
+#include "config.h"
+#include "val.h"
+#include "env.h"
+
+#define MAGIC_BUFFER        (MAGIC_BASE + 15)
+
+/*
+ * Bytes of buffer is held by the base buffer, follow its head.
+ * Slice of buffer refer the bytes of base, without copy.
+ */
+typedef struct buffer_t {
+    uint8_t magic;
+    uint8_t age;
+    uint16_t reserved;
+    uint32_t size;
+    uint32_t offset;            // offset in bytes of base
+    struct buffer_t *base;      // buffer hold the bytes, itself if not a slice
+} buffer_t;
+
+static inline int buffer_is_slice(buffer_t *b) {
+    return b->base != b;
+}
+
+static inline int buffer_mem_space(buffer_t *b) {
+    return SIZE_ALIGN(sizeof(buffer_t) + (buffer_is_slice(b) ? 0 : b->size));
+}
+
+static inline uint8_t *buffer_data(buffer_t *b) {
+    return (uint8_t *)(b->base + 1) + b->offset;
+}
+
+static inline int buffer_length(buffer_t *b) {
+    return b->size;
+}
+
+buffer_t *buffer_alloc(env_t *env, int size);
+
+void buffer_elem_get(env_t *env, val_t *b, val_t *i, val_t *e);
+void buffer_elem_set(env_t *env, val_t *b, val_t *i, val_t *v);
+void buffer_elem_op_set(env_t *env, val_t *b, val_t *i, val_t *v, val_t *r,
+                        void (*op)(env_t *, val_t *, val_t *, val_t *));
+
+val_t buffer_create(env_t *env, int ac, val_t *av);
+val_t buffer_slice(env_t *env, int ac, val_t *av);
+val_t buffer_read_int(env_t *env, int ac, val_t *av);
+val_t buffer_read_uint(env_t *env, int ac, val_t *av);
+val_t buffer_read_float(env_t *env, int ac, val_t *av);
+val_t buffer_write_int(env_t *env, int ac, val_t *av);
+val_t buffer_write_float(env_t *env, int ac, val_t *av);
+
+#endif /* __LANG_BUFFER_INC__ */
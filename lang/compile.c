@@ -110,7 +110,7 @@ static void compile_gc(compile_t *cpl);
  */
 static void *compile_malloc(compile_t *cpl, int size)
 {
-    int keep_size = sizeof(intptr_t) * (cpl->func_num * 2 + 1);
+    int keep_size = sizeof(intptr_t) * (cpl->func_num * 2 + 2);
     void *p;
 
     size += sizeof(intptr_t) * 2;
@@ -138,15 +138,28 @@ static inline intptr_t *compile_mem_head(void *mem) {
 static void compile_gc(compile_t *cpl)
 {
     intptr_t *keep_tbl = (intptr_t *)(cpl->heap.base + cpl->heap.free);
-    int keep_num = cpl->func_num * 2 + 1;
     intptr_t *head;
+    int keep_num;
     int i, n, free = 0;
 
+    if (!cpl->func_buf) {
+        return;
+    }
+
     keep_tbl[0] = (intptr_t) compile_mem_head(cpl->func_buf);
     for (i = 0, n = 1; i < cpl->func_num; i++) {
-        keep_tbl[n++] = (intptr_t)compile_mem_head(cpl->func_buf[i].var_map);
-        keep_tbl[n++] = (intptr_t)compile_mem_head(cpl->func_buf[i].code_buf);
+        // function without variable or code has nothing to keep
+        if (cpl->func_buf[i].var_map) {
+            keep_tbl[n++] = (intptr_t)compile_mem_head(cpl->func_buf[i].var_map);
+        }
+        if (cpl->func_buf[i].code_buf) {
+            keep_tbl[n++] = (intptr_t)compile_mem_head(cpl->func_buf[i].code_buf);
+        }
+    }
+    if (cpl->try_buf) {
+        keep_tbl[n++] = (intptr_t)compile_mem_head(cpl->try_buf);
     }
+    keep_num = n;
 
     /*
      * compute & recorde new address
@@ -161,16 +174,26 @@ static void compile_gc(compile_t *cpl)
 
     /*
      * update pointer reference
+     * Note: func_buf is not moved yet, update the entries in place,
+     * they will be moved together with func_buf.
      */
-    head = compile_mem_head(cpl->func_buf);
-    cpl->func_buf = (compile_func_t *) (head[1] + sizeof(intptr_t) * 2);
     for (i = 0; i < cpl->func_num; i++) {
-        head = compile_mem_head(cpl->func_buf[i].var_map);
-        cpl->func_buf[i].var_map = (intptr_t *)(head[1] + sizeof(intptr_t) * 2);
+        if (cpl->func_buf[i].var_map) {
+            head = compile_mem_head(cpl->func_buf[i].var_map);
+            cpl->func_buf[i].var_map = (intptr_t *)(head[1] + sizeof(intptr_t) * 2);
+        }
 
-        head = compile_mem_head(cpl->func_buf[i].code_buf);
-        cpl->func_buf[i].code_buf = (uint8_t *)(head[1] + sizeof(intptr_t) * 2);
+        if (cpl->func_buf[i].code_buf) {
+            head = compile_mem_head(cpl->func_buf[i].code_buf);
+            cpl->func_buf[i].code_buf = (uint8_t *)(head[1] + sizeof(intptr_t) * 2);
+        }
     }
+    if (cpl->try_buf) {
+        head = compile_mem_head(cpl->try_buf);
+        cpl->try_buf = (compile_try_t *)(head[1] + sizeof(intptr_t) * 2);
+    }
+    head = compile_mem_head(cpl->func_buf);
+    cpl->func_buf = (compile_func_t *) (head[1] + sizeof(intptr_t) * 2);
 
     /*
      * data relocation
@@ -281,20 +304,31 @@ static int compile_func_append(compile_t *cpl, int owner)
     cpl->func_buf[func_id].var_max = 0;
     cpl->func_buf[func_id].var_num = 0;
     cpl->func_buf[func_id].arg_num = 0;
+    cpl->func_buf[func_id].upv_num = 0;
     cpl->func_buf[func_id].code_max = 0;
     cpl->func_buf[func_id].code_num = 0;
     cpl->func_buf[func_id].code_buf = NULL;
     cpl->func_buf[func_id].var_map = NULL;
+    cpl->func_buf[func_id].try_num = 0;
 
     return func_id;
 }
 
-static int compile_varmap_check_extend(compile_t *cpl, int space)
+/*
+ * Variables is stored from the head of var_map,
+ * and the upvalues is stored from the tail of var_map.
+ */
+static inline intptr_t *compile_func_upv(compile_func_t *func, int i)
+{
+    return func->var_map + func->var_max - 1 - i;
+}
+
+static int compile_varmap_check_extend(compile_t *cpl, int func_id, int space)
 {
     int size;
-    compile_func_t *func = compile_func_cur(cpl);
+    compile_func_t *func = cpl->func_buf + func_id;
 
-    if (0 < (size = compile_extend_size(cpl, func->var_max, func->var_num, space,
+    if (0 < (size = compile_extend_size(cpl, func->var_max, func->var_num + func->upv_num, space,
                                  LIMIT_VMAP_SIZE, DEF_VMAP_SIZE))) {
         intptr_t *ptr;
         if (NULL == (ptr = (intptr_t *)compile_malloc(cpl, size * sizeof(intptr_t)))) {
@@ -302,8 +336,12 @@ static int compile_varmap_check_extend(compile_t *cpl, int space)
             return -1;
         }
 
+        // Note: func_buf may be moved by gc, in malloc
+        func = cpl->func_buf + func_id;
         if (func->var_map) {
             memcpy(ptr, func->var_map, func->var_num * sizeof(intptr_t));
+            memcpy(ptr + size - func->upv_num, compile_func_upv(func, func->upv_num - 1),
+                   func->upv_num * sizeof(intptr_t));
         }
 
         func->var_map = ptr;
@@ -329,18 +367,91 @@ static int compile_varmap_find_add(compile_t *cpl, intptr_t sym_id)
         if (sym_id == func->var_map[i]) return i; // already exist!
     }
 
-    if (0 > compile_varmap_check_extend(cpl, 1)) {
+    if (0 > compile_varmap_check_extend(cpl, cpl->func_cur, 1)) {
         return -1;
     }
 
+    func = compile_func_cur(cpl);
     func->var_map[func->var_num++] = sym_id;
 
     return i;
 }
 
+static inline int compile_func_var_find(compile_func_t *func, intptr_t sym_id)
+{
+    int i;
+
+    for (i = 0; i < func->var_num; i++) {
+        if (sym_id == func->var_map[i]) return i;
+    }
+    return -1;
+}
+
+static inline int compile_func_upv_find(compile_func_t *func, intptr_t sym_id)
+{
+    int i;
+
+    for (i = 0; i < func->upv_num; i++) {
+        if (sym_id == *compile_func_upv(func, i)) return i;
+    }
+    return -1;
+}
+
+// return: index of upvalue or -1
+static int compile_upvmap_find_add(compile_t *cpl, int func_id, intptr_t sym_id)
+{
+    compile_func_t *func = cpl->func_buf + func_id;
+    int id;
+
+    if (0 <= (id = compile_func_upv_find(func, sym_id))) {
+        return id;
+    }
+
+    if (0 > compile_varmap_check_extend(cpl, func_id, 1)) {
+        return -1;
+    }
+
+    func = cpl->func_buf + func_id;
+    id = func->upv_num++;
+    *compile_func_upv(func, id) = sym_id;
+
+    return id;
+}
+
+/*
+ * Capture the variable of owner, by the functions between current and owner.
+ * return: index of upvalue in current function or -1
+ */
+static int compile_upvalue_add(compile_t *cpl, int owner, intptr_t sym_id)
+{
+    int func_id = cpl->func_cur;
+    int id = -1;
+
+    while (func_id != owner) {
+        int upv = compile_upvmap_find_add(cpl, func_id, sym_id);
+
+        if (upv < 0) {
+            return -1;
+        }
+        if (func_id == cpl->func_cur) {
+            id = upv;
+        }
+        func_id = cpl->func_buf[func_id].owner;
+    }
+
+    return id;
+}
+
+/*
+ * Variables of function is in the scope of generation 0,
+ * variables captured by function is in the upvalue scope of generation 1,
+ * variables of main is in the root scope, of generation 1 in function
+ * defined in main or generation 2 in the nested function.
+ */
 static int compile_varmap_lookup(compile_t *cpl, intptr_t sym_id, int *generation)
 {
     compile_func_t *func;
+    int owner, id;
 
     if (cpl->error || sym_id == 0) {
         return -1;
@@ -350,21 +461,32 @@ static int compile_varmap_lookup(compile_t *cpl, intptr_t sym_id, int *generatio
         *generation = 0;
 
     func = compile_func_cur(cpl);
-    while (func) {
-        int i, num = func->var_num;
-        for (i = 0; i < num; i++) {
-            if (sym_id == func->var_map[i]) {
-                return i;
+    if (0 <= (id = compile_func_var_find(func, sym_id)) || !generation) {
+        return id;
+    }
+
+    if (0 <= (id = compile_func_upv_find(func, sym_id))) {
+        *generation = 1;
+        return id;
+    }
+
+    for (owner = func->owner; owner >= 0; owner = cpl->func_buf[owner].owner) {
+        compile_func_t *f = cpl->func_buf + owner;
+
+        if (f->owner < 0) {
+            if (0 <= (id = compile_func_var_find(f, sym_id))) {
+                // Mark the closure flag
+                f->closure = 1;
+                *generation = func->owner == owner ? 1 : 2;
             }
+            return id;
         }
 
-        if (generation) {
-            func = compile_func_parent(cpl, func);
-            (*generation)++;
+        if (0 <= compile_func_var_find(f, sym_id) || 0 <= compile_func_upv_find(f, sym_id)) {
             // Mark the closure flag
-            if (func) func->closure = 1;
-        } else {
-            func = NULL;
+            f->closure = 1;
+            *generation = 1;
+            return compile_upvalue_add(cpl, owner, sym_id);
         }
     }
 
@@ -441,6 +563,8 @@ static int compile_code_check_extend(compile_t *cpl, int space)
             return -1;
         }
 
+        // Note: func_buf may be moved by gc, in malloc
+        func = compile_func_cur(cpl);
         if (func->code_buf) {
             memcpy(ptr, func->code_buf, func->code_num);
         }
@@ -480,12 +604,13 @@ static inline void compile_code_appends(compile_t *cpl, int n, uint8_t *code)
 
 static int compile_code_extend(compile_t *cpl, int bytes)
 {
-    compile_func_t *func = cpl->func_buf + cpl->func_cur;
+    compile_func_t *func;
 
     if (cpl->error || 0 > compile_code_check_extend(cpl, bytes)) {
         return 1;
     }
 
+    func = compile_func_cur(cpl);
     func->code_num += bytes;
 
     return 0;
@@ -493,13 +618,14 @@ static int compile_code_extend(compile_t *cpl, int bytes)
 
 static int compile_code_insert(compile_t *cpl, int pos, int bytes)
 {
-    compile_func_t *func = cpl->func_buf + cpl->func_cur;
+    compile_func_t *func;
     int i, n;
 
     if (cpl->error || 0 > compile_code_check_extend(cpl, bytes)) {
         return 1;
     }
 
+    func = compile_func_cur(cpl);
     n = func->code_num - pos;
     for (i = 1; i <= n; i++) {
         func->code_buf[func->code_num + bytes - i] = func->code_buf[func->code_num - i];
@@ -575,25 +701,38 @@ static inline void compile_code_append_var(compile_t *cpl, int id, int generatio
     func->code_buf[func->code_num++] = generation;
 }
 
-static inline void compile_code_append_call(compile_t *cpl, int ac)
+// call: BC_FUNC_CALL or BC_TAIL_CALL
+static inline void compile_code_append_call(compile_t *cpl, uint8_t call, int ac)
 {
     compile_func_t *func;
 
+    if (call == BC_FUNC_CALL && ac <= 3) {
+        compile_code_append(cpl, BC_CALL0 + ac);
+        return;
+    }
+
     if (cpl->error || 0 > compile_code_check_extend(cpl, 2)) {
         return;
     }
 
     func = compile_func_cur(cpl);
-    func->code_buf[func->code_num++] = BC_FUNC_CALL;
+    func->code_buf[func->code_num++] = call;
     func->code_buf[func->code_num++] = ac;
 }
 
 static void compile_expr(compile_t *cpl, expr_t *e);
+static void compile_expr_discard(compile_t *cpl, expr_t *e);
 
 static void compile_code_set_jmp(compile_t *cpl, int pos, uint8_t jmp, int step)
 {
-    uint8_t *buf = compile_code_buf(cpl) + pos;
+    uint8_t *buf;
+
+    // code buffer may be not allocated, if memory run out
+    if (cpl->error) {
+        return;
+    }
 
+    buf = compile_code_buf(cpl) + pos;
     if (step > 32767 || step < -32768) {
         cpl->error = 5555;
     }
@@ -756,6 +895,25 @@ static void compile_expr_lft(compile_t *cpl, expr_t *e)
     }
 }
 
+static void compile_expr_store(compile_t *cpl, expr_t *e, uint8_t code)
+{
+    int generation;
+    int var_id = compile_varmap_lookup_name(cpl, ast_expr_text(e), &generation);
+
+    if (var_id < 0) {
+        // keep the error raised in the function defined, if any
+        if (!cpl->error) {
+            cpl->error = ERR_NotDefinedId;
+        }
+    } else {
+        uint8_t buf[3];
+        buf[0] = code;
+        buf[1] = var_id;
+        buf[2] = generation;
+        compile_code_appends(cpl, 3, buf);
+    }
+}
+
 static int compile_var_def(compile_t *cpl, expr_t *e)
 {
     if (e->type == EXPR_ID) {
@@ -828,17 +986,287 @@ static void compile_arg_list(compile_t *cpl, expr_t *e, int *ac)
 static void compile_stmt_block(compile_t *cpl, stmt_t *s)
 {
     while(s && !cpl->error) {
-        compile_stmt(cpl, s);
         if (s->type == STMT_EXPR) {
-            compile_code_append(cpl, BC_POP);
+            compile_expr_discard(cpl, s->expr);
+        } else {
+            compile_stmt(cpl, s);
         }
         s = s->next;
     }
 }
 
+/****************************************************************
+ *                        Closure
+ *
+ * Function defined in other function is a closure, the variables of
+ * outer functions it used are captured into its upvalue scope when
+ * it created (BC_PUSH_CLOSURE). Access of them is O(1), and scope of
+ * outer function is not kept alive by the closure.
+ *
+ * Captured variable is copied, unless it is assigned by the owner or
+ * any closure, then it is boxed as a cell (BC_BOX_VAR) at the entry
+ * of owner, and accessed by cell instructions, the cell is shared.
+ * It is decided after the owner compiled, see compile_func_close.
+ ***************************************************************/
+#if LIMIT_VMAP_SIZE > 32
+# error "variable mask of closure is 32 bits"
+#endif
+
+static inline uint8_t compile_code_cell(uint8_t code)
+{
+    switch (code) {
+    case BC_PUSH_VAR:       return BC_PUSH_CELL;
+    case BC_STORE_VAR:      return BC_STORE_CELL;
+    case BC_STORE_VAR_POP:  return BC_STORE_CELL_POP;
+    case BC_ADD_STORE_VAR:  return BC_ADD_STORE_CELL;
+    case BC_SUB_STORE_VAR:  return BC_SUB_STORE_CELL;
+    default:                return code;
+    }
+}
+
+static inline int compile_code_is_var_access(uint8_t code) {
+    return code == BC_PUSH_REF || compile_code_cell(code) != code;
+}
+
+static inline int compile_code_is_var_assign(uint8_t code) {
+    return code != BC_PUSH_VAR && compile_code_is_var_access(code);
+}
+
+/*
+ * Map upvalue of descendant to the variable of function, -1 if it is not
+ */
+static void compile_closure_map(compile_t *cpl, int func_id, int desc_id, int8_t *map)
+{
+    compile_func_t *desc = cpl->func_buf + desc_id;
+    int i;
+
+    for (i = 0; i < desc->upv_num; i++) {
+        intptr_t sym_id = *compile_func_upv(desc, i);
+        int owner = desc->owner;
+
+        // variable of the nearer function shadow it
+        while (owner > func_id && 0 > compile_func_var_find(cpl->func_buf + owner, sym_id)) {
+            owner = cpl->func_buf[owner].owner;
+        }
+        map[i] = owner == func_id ? compile_func_var_find(cpl->func_buf + func_id, sym_id) : -1;
+    }
+}
+
+/*
+ * Walk through the code, the variables access of generation:
+ * box them if the boxed mask is given, or return the mask of assigned.
+ * map: upvalue to variable of the owner, NULL for the owner self.
+ */
+static uint32_t compile_closure_walk(compile_func_t *fn, int generation, const int8_t *map, uint32_t boxed, uint32_t *captured)
+{
+    uint32_t assigned = 0;
+    int pos = 0;
+
+    while (pos < fn->code_num) {
+        const char *name;
+        int p1 = 0, p2 = -1, at = pos, id;
+        uint8_t code = fn->code_buf[pos];
+
+        bcode_parse(fn->code_buf, &pos, &name, &p1, &p2);
+        if (code == BC_PUSH_CLOSURE) {
+            const uint8_t *desc = fn->code_buf + at + 4;
+            int i;
+
+            for (i = 0; captured && i < p2; i++, desc += 2) {
+                if (desc[1] == 0) {
+                    *captured |= 1u << desc[0];
+                }
+            }
+            continue;
+        }
+
+        if (p2 != generation || !compile_code_is_var_access(code)) {
+            continue;
+        }
+
+        id = map ? map[p1] : p1;
+        if (id < 0) {
+            continue;
+        }
+
+        if (boxed) {
+            if (boxed & (1u << id)) {
+                fn->code_buf[at] = compile_code_cell(code);
+            }
+        } else
+        if (compile_code_is_var_assign(code)) {
+            assigned |= 1u << id;
+        }
+    }
+
+    return assigned;
+}
+
+/*
+ * Decide the variables should be boxed, after the function compiled.
+ * All functions after it are its descendants.
+ */
+static void compile_func_close(compile_t *cpl, int func_id)
+{
+    compile_func_t *fn = cpl->func_buf + func_id;
+    int8_t map[LIMIT_VMAP_SIZE];
+    uint32_t captured = 0, assigned, boxed;
+    uint8_t *code;
+    int i, n, head;
+
+    if (cpl->error || fn->owner < 0 || !fn->closure) {
+        return;
+    }
+
+    // Note: descendant captured nothing, is static, see compile_code_append_closure
+    assigned = compile_closure_walk(fn, 0, NULL, 0, &captured);
+    for (i = func_id + 1; i < cpl->func_num; i++) {
+        if (!cpl->func_buf[i].upv_num) continue;
+        compile_closure_map(cpl, func_id, i, map);
+        assigned |= compile_closure_walk(cpl->func_buf + i, 1, map, 0, NULL);
+    }
+
+    boxed = captured & assigned;
+    if (!boxed) {
+        return;
+    }
+
+    compile_closure_walk(fn, 0, NULL, boxed, NULL);
+    for (i = func_id + 1; i < cpl->func_num; i++) {
+        if (!cpl->func_buf[i].upv_num) continue;
+        compile_closure_map(cpl, func_id, i, map);
+        compile_closure_walk(cpl->func_buf + i, 1, map, boxed, NULL);
+    }
+
+    // Box them at entry, BC_GEN_START or BC_ASYNC is kept in the head
+    for (i = 0, n = 0; i < fn->var_num; i++) {
+        n += (boxed >> i) & 1;
+    }
+    head = cpl->generator ? 1 : 0;
+    if (0 == compile_code_insert(cpl, head, n * 2)) {
+        code = compile_code_buf(cpl) + head;
+        for (i = 0, n = 0; i < LIMIT_VMAP_SIZE; i++) {
+            if (boxed & (1u << i)) {
+                code[n++] = BC_BOX_VAR;
+                code[n++] = i;
+            }
+        }
+
+        for (i = 0; i < cpl->try_num; i++) {
+            compile_try_t *h = cpl->try_buf + i;
+
+            if (h->func == func_id) {
+                h->bgn += n;
+                h->end += n;
+                h->handler += n;
+            }
+        }
+    }
+}
+
+/*
+ * Nested function captured nothing has no upvalue scope, the super of it
+ * is the root scope: variables of main is in generation 1, not 2.
+ */
+static void compile_closure_static(compile_func_t *fn)
+{
+    int pos = 0;
+
+    while (pos < fn->code_num) {
+        const char *name;
+        int p1 = 0, p2 = -1, at = pos;
+
+        bcode_parse(fn->code_buf, &pos, &name, &p1, &p2);
+        if (p2 == 2 && compile_code_is_var_access(fn->code_buf[at])) {
+            fn->code_buf[at + 2] = 1;
+        }
+    }
+}
+
+/*
+ * Function captured nothing is static (BC_PUSH_SCRIPT), the object of it
+ * is created once, and shared.
+ */
+static void compile_code_append_closure(compile_t *cpl, int func)
+{
+    compile_func_t *owner = compile_func_cur(cpl);
+    compile_func_t *fn = cpl->func_buf + func;
+    int i, n = fn->upv_num, func_id = func + cpl->func_offset;
+    uint8_t *code;
+
+    // function defined in main, captured nothing always
+    if (n == 0) {
+        if (owner->owner >= 0) {
+            compile_closure_static(fn);
+        }
+        compile_code_append_arg_u16(cpl, BC_PUSH_SCRIPT, func_id);
+        return;
+    }
+
+    if (cpl->error || 0 > compile_code_check_extend(cpl, 4 + n * 2)) {
+        return;
+    }
+
+    owner = compile_func_cur(cpl);
+    fn = cpl->func_buf + func;
+    code = owner->code_buf + owner->code_num;
+    code[0] = BC_PUSH_CLOSURE;
+    code[1] = func_id >> 8;
+    code[2] = func_id;
+    code[3] = n;
+    for (i = 0; i < n; i++) {
+        intptr_t sym_id = *compile_func_upv(fn, i);
+        int id = compile_func_var_find(owner, sym_id);
+
+        if (id >= 0) {
+            code[4 + i * 2] = id;
+            code[5 + i * 2] = 0;
+        } else {
+            code[4 + i * 2] = compile_func_upv_find(owner, sym_id);
+            code[5 + i * 2] = 1;
+        }
+    }
+    owner->code_num += 4 + n * 2;
+}
+
+/*
+ * Yield statement of the function self, the nested function is defined
+ * in expression, and not visited.
+ */
+static int compile_block_has_yield(stmt_t *s)
+{
+    for (; s; s = s->next) {
+        if (s->type == STMT_YIELD || compile_block_has_yield(s->block) || compile_block_has_yield(s->other)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Await expression of the function self, nested function is in EXPR_FUNCPROC
+static int compile_expr_has_await(expr_t *e)
+{
+    if (!e || e->type <= EXPR_STRING) {
+        return 0;
+    }
+
+    return e->type == EXPR_AWAIT || compile_expr_has_await(ast_expr_lft(e)) ||
+           compile_expr_has_await(ast_expr_rht(e));
+}
+
+static int compile_block_has_await(stmt_t *s)
+{
+    for (; s; s = s->next) {
+        if (compile_expr_has_await(s->expr) || compile_block_has_await(s->block) || compile_block_has_await(s->other)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 static void compile_func_def(compile_t *cpl, expr_t *e)
 {
-    int owner, curr, func_id;
+    int owner, curr, try_nest, generator;
     expr_t *args, *name;
     stmt_t *block;
 
@@ -855,18 +1283,33 @@ static void compile_func_def(compile_t *cpl, expr_t *e)
         return;
     }
     cpl->func_cur = curr;
+    try_nest = cpl->try_nest;
+    generator = cpl->generator;
+    cpl->try_nest = 0;
+    if (compile_block_has_yield(block)) {
+        cpl->generator = BC_GEN_START;
+    } else {
+        cpl->generator = compile_block_has_await(block) ? BC_ASYNC : 0;
+    }
     compile_arg_def_list(cpl, args);
+    if (cpl->generator) {
+        compile_code_append(cpl, cpl->generator);
+    }
     compile_stmt_block(cpl, block);
-    compile_code_append(cpl, BC_RET0);
+    if (cpl->generator) {
+        compile_code_append(cpl, BC_PUSH_UND);
+        compile_code_append(cpl, BC_GEN_RET);
+    } else {
+        compile_code_append(cpl, BC_RET0);
+    }
+    compile_func_close(cpl, curr);
+    cpl->try_nest = try_nest;
+    cpl->generator = generator;
     cpl->func_cur = owner;
 
-    func_id = curr + cpl->func_offset;
+    compile_code_append_closure(cpl, curr);
     if (name) {
-        compile_expr_lft(cpl, name);
-        compile_code_append_arg_u16(cpl, BC_PUSH_SCRIPT, func_id);
-        compile_code_append(cpl, BC_ASSIGN);
-    } else {
-        compile_code_append_arg_u16(cpl, BC_PUSH_SCRIPT, func_id);
+        compile_expr_store(cpl, name, BC_STORE_VAR);
     }
 }
 
@@ -935,7 +1378,7 @@ static void compile_dict(compile_t *cpl, expr_t *dict)
     compile_code_append_arg_u16(cpl, BC_DICT, n * 2);
 }
 
-static void compile_callor(compile_t *cpl, expr_t *e, int argc)
+static void compile_callor(compile_t *cpl, expr_t *e, int argc, uint8_t call)
 {
     if (e->type == EXPR_PROP) {
         compile_expr_binary(cpl, e, BC_PROP_METH);
@@ -947,7 +1390,7 @@ static void compile_callor(compile_t *cpl, expr_t *e, int argc)
     } else {
         compile_expr(cpl, e);
     }
-    compile_code_append_call(cpl, argc);
+    compile_code_append_call(cpl, call, argc);
 }
 
 static void compile_assign(compile_t *cpl, expr_t *e)
@@ -968,6 +1411,10 @@ static void compile_assign(compile_t *cpl, expr_t *e)
         compile_expr(cpl, ast_expr_rht(ast_expr_lft(e)));
         compile_expr(cpl, ast_expr_rht(e));
         compile_code_append(cpl, BC_ELEM_ASSIGN + op);
+    } else
+    if (lft == EXPR_ID && op == 0) {
+        compile_expr(cpl, ast_expr_rht(e));
+        compile_expr_store(cpl, ast_expr_lft(e), BC_STORE_VAR);
     } else {
         compile_expr_lft(cpl, ast_expr_lft(e));
         compile_expr(cpl, ast_expr_rht(e));
@@ -975,10 +1422,33 @@ static void compile_assign(compile_t *cpl, expr_t *e)
     }
 }
 
+/*
+ * Compile expression whose result is not used.
+ * The assignment of variable store the value directly, without the result.
+ */
+static void compile_expr_discard(compile_t *cpl, expr_t *e)
+{
+    uint8_t code;
+
+    switch (e->type) {
+    case EXPR_ASSIGN:       code = BC_STORE_VAR_POP; break;
+    case EXPR_ADD_ASSIGN:   code = BC_ADD_STORE_VAR; break;
+    case EXPR_SUB_ASSIGN:   code = BC_SUB_STORE_VAR; break;
+    default:                code = BC_POP;
+    }
+
+    if (code != BC_POP && ast_expr_lft(e)->type == EXPR_ID) {
+        compile_expr(cpl, ast_expr_rht(e));
+        compile_expr_store(cpl, ast_expr_lft(e), code);
+    } else {
+        compile_expr(cpl, e);
+        compile_code_append(cpl, BC_POP);
+    }
+}
+
 static inline void compile_comma(compile_t *cpl, expr_t *e)
 {
-    compile_expr(cpl, ast_expr_lft(e));
-    compile_code_append(cpl, BC_POP);
+    compile_expr_discard(cpl, ast_expr_lft(e));
     compile_expr(cpl, ast_expr_rht(e));
 }
 
@@ -994,7 +1464,7 @@ static inline void compile_ternary(compile_t *cpl, expr_t *e)
     compile_false_pop_jmp(cpl, pos1, pos2 + (compile_code_pos(cpl) - end));
 }
 
-static inline void compile_func_call(compile_t *cpl, expr_t *e)
+static inline void compile_func_call(compile_t *cpl, expr_t *e, uint8_t call)
 {
     int argc = 0;
     expr_t *args, *func;
@@ -1003,7 +1473,23 @@ static inline void compile_func_call(compile_t *cpl, expr_t *e)
     args = ast_expr_rht(e);
 
     compile_arg_list(cpl, args, &argc);
-    compile_callor(cpl, func, argc);
+    compile_callor(cpl, func, argc, call);
+}
+
+/*
+ * Function with await expression is async, see compile_func_def. The
+ * frame is detached at await if the future is pending, as yield.
+ */
+static void compile_expr_await(compile_t *cpl, expr_t *e)
+{
+    if (cpl->generator != BC_ASYNC) {
+        // await in main, or with yield
+        cpl->error = ERR_InvalidSementic;
+        return;
+    }
+
+    compile_expr(cpl, ast_expr_lft(e));
+    compile_code_append(cpl, BC_AWAIT);
 }
 
 static void compile_expr(compile_t *cpl, expr_t *e)
@@ -1025,6 +1511,7 @@ static void compile_expr(compile_t *cpl, expr_t *e)
     case EXPR_NEG:      compile_expr(cpl, ast_expr_lft(e)); compile_code_append(cpl, BC_NEG); break;
     case EXPR_NOT:      compile_expr(cpl, ast_expr_lft(e)); compile_code_append(cpl, BC_NOT); break;
     case EXPR_LOGIC_NOT:compile_expr(cpl, ast_expr_lft(e)); compile_code_append(cpl, BC_LOGIC_NOT); break;
+    case EXPR_AWAIT:    compile_expr_await(cpl, e); break;
     case EXPR_ARRAY:    compile_array(cpl, e); break;
     case EXPR_DICT:     compile_dict(cpl, e); break;
 
@@ -1052,7 +1539,7 @@ static void compile_expr(compile_t *cpl, expr_t *e)
     case EXPR_LOGIC_AND:compile_expr_logic_and(cpl, e); break;
     case EXPR_LOGIC_OR: compile_expr_logic_or(cpl, e); break;
 
-    case EXPR_CALL:     compile_func_call(cpl, e); break;
+    case EXPR_CALL:     compile_func_call(cpl, e, BC_FUNC_CALL); break;
     case EXPR_PROP:     compile_expr_binary(cpl, e, BC_PROP); break;
     case EXPR_ELEM:     compile_expr_binary(cpl, e, BC_ELEM); break;
 
@@ -1085,8 +1572,24 @@ static void compile_stmt_expr(compile_t *cpl, stmt_t *s)
 
 static void compile_stmt_return(compile_t *cpl, stmt_t *s)
 {
+    // generator or async function is finished, the frame could not be reused
+    if (cpl->generator) {
+        if (s->expr) {
+            compile_expr(cpl, s->expr);
+        } else {
+            compile_code_append(cpl, BC_PUSH_UND);
+        }
+        compile_code_append(cpl, BC_GEN_RET);
+        return;
+    }
+
     if (s->expr) {
-        compile_expr(cpl, s->expr);
+        // call in return position of function, reuse the frame
+        if (s->expr->type == EXPR_CALL && compile_func_cur(cpl)->owner >= 0 && !cpl->try_nest) {
+            compile_func_call(cpl, s->expr, BC_TAIL_CALL);
+        } else {
+            compile_expr(cpl, s->expr);
+        }
         compile_code_append(cpl, BC_RET);
     } else {
         compile_code_append(cpl, BC_RET0);
@@ -1113,24 +1616,48 @@ static void compile_stmt_var(compile_t *cpl, stmt_t *s)
         }
 
         if (e->type == EXPR_ASSIGN) {
-            compile_expr(cpl, e);
-            compile_code_append(cpl, BC_POP);
+            compile_expr_discard(cpl, e);
         }
 
         e = next;
     }
 }
 
-/****************************************************************
- *                        if else form
- *
- * Begin:       +------------+
- *              |  condition +
- * test:        + ---------- +
- *         +----|  test jmp  |
- * Block:  |    + ---------- +
- *         |    |            |
- *         |    |   Block    |
+/*
+ * Compile the condition, for a jump when it is false.
+ * Compare is fused with the jump, return the jump instruction to use.
+ */
+static uint8_t compile_cond(compile_t *cpl, expr_t *e)
+{
+    uint8_t jmp;
+
+    switch (e->type) {
+    case EXPR_TEQ:  jmp = BC_TEQ_JMP_F; break;
+    case EXPR_TNE:  jmp = BC_TNE_JMP_F; break;
+    case EXPR_TGT:  jmp = BC_TGT_JMP_F; break;
+    case EXPR_TGE:  jmp = BC_TGE_JMP_F; break;
+    case EXPR_TLT:  jmp = BC_TLT_JMP_F; break;
+    case EXPR_TLE:  jmp = BC_TLE_JMP_F; break;
+    default:
+        compile_expr(cpl, e);
+        return BC_POP_JMP_F;
+    }
+
+    compile_expr(cpl, ast_expr_lft(e));
+    compile_expr(cpl, ast_expr_rht(e));
+    return jmp;
+}
+
+/****************************************************************
+ *                        if else form
+ *
+ * Begin:       +------------+
+ *              |  condition +
+ * test:        + ---------- +
+ *         +----|  test jmp  |
+ * Block:  |    + ---------- +
+ *         |    |            |
+ *         |    |   Block    |
  * skip:   |    + ---------- +
  *         |    |    skip    |----+
  * Other:  +--->+ ---------- +    |
@@ -1142,8 +1669,9 @@ static void compile_stmt_var(compile_t *cpl, stmt_t *s)
 static void compile_stmt_cond(compile_t *cpl, stmt_t *s)
 {
     int test_pos, skip_pos, block, other;
+    uint8_t jmp;
 
-    compile_expr(cpl, s->expr);
+    jmp = compile_cond(cpl, s->expr);
     test_pos = compile_code_pos(cpl);
 
     compile_code_extend(cpl, 3);
@@ -1161,41 +1689,47 @@ static void compile_stmt_cond(compile_t *cpl, stmt_t *s)
         compile_code_set_jmp(cpl, skip_pos, BC_JMP, compile_code_pos(cpl) - other);
     }
 
-    compile_code_set_jmp(cpl, test_pos, BC_POP_JMP_F, other - block);
+    compile_code_set_jmp(cpl, test_pos, jmp, other - block);
 }
 
 /****************************************************************
  *                        Loop form
  *
- * Begin:       +------------+ <---------------------+   <------+
- *              |  condition +                       |          |
- *              + ---------- +                       |          |
- *              | JMP 3 Step | -- is true -+         |          |
- *              |  (2 BYTE)  |             |         |          |
- * skip:        + ---------- + <-----------|----+    |          |
- *         +--- |   JMP to   |             |    |    |          |
- *         |    |  LoopEnd   |             |    |    |          |
- *         |    |  (3 BYTE)  |             |    |    |        Total
- *         |    + ---------- + <-----------+    |    |   <--+   |
- *         |    |            |                  |    |      |   |
- *         |    | statements | -- break --------+    |      |   |
- *         |    |            | -- continue ----------+    Block |
- * End:    |    + ---------- +                       |      |   |
- *         |    | JMP Begin  | ----------------------+      |   |
- * LoopEnd +--> +------------+                           <--+---+
+ *              +------------+
+ *              | JMP Begin  | ------------------+
+ * skip:        + ---------- + <-----------+     |
+ *         +--- |   JMP to   |             |     |
+ *         |    |  LoopEnd   |             |     |
+ * Begin:  |    +------------+ <-----------|-----+   <------+
+ *         |    |  condition +             |     |          |
+ *         |    + ---------- +             |     |          |
+ *         |    | test jmp   | -- false ---+     |          |
+ *         |    + ---------- +                   |          |
+ *         |    |            |                   |          |
+ *         |    | statements | -- break ---------|-> skip   |
+ *         |    |            | -- continue ------+          |
+ * End:    |    + ---------- +                              |
+ *         |    | JMP Begin  | -----------------------------+
+ * LoopEnd +--> +------------+
+ *
+ * The skip is a fixed point before the block for break, the optimizer
+ * thread the jumps to LoopEnd and remove the skip.
  ***************************************************************/
 static void compile_stmt_while(compile_t *cpl, stmt_t *s)
 {
-    int bgn, skip, end, total, block, bgn_bk, skip_bk;
-    uint8_t code[2] = {BC_POP_SJMP_T, 3};
-
-    bgn = compile_code_pos(cpl);
-    compile_expr(cpl, s->expr);
-    compile_code_appends(cpl, 2, code);
+    int entry, bgn, skip, test, end, bgn_bk, skip_bk;
+    uint8_t jmp;
 
+    entry = compile_code_pos(cpl);
+    compile_code_extend(cpl, 3);
     skip = compile_code_pos(cpl);
     compile_code_extend(cpl, 3);
 
+    bgn = compile_code_pos(cpl);
+    jmp = compile_cond(cpl, s->expr);
+    test = compile_code_pos(cpl);
+    compile_code_extend(cpl, 3);
+
     // Set begin and skip position, and save old/super position
     // used for statements compile of break & continue
     bgn_bk = cpl->bgn_pos; skip_bk = cpl->skip_pos;
@@ -1208,316 +1742,1977 @@ static void compile_stmt_while(compile_t *cpl, stmt_t *s)
     cpl->skip_pos = skip_bk;
 
     end = compile_code_pos(cpl);
-    total = end - bgn + 3;
-    compile_code_append_jmp(cpl, BC_JMP, -total);
+    compile_code_append_jmp(cpl, BC_JMP, bgn - (end + 3));
 
-    block = total - (skip - bgn + 3);
-    compile_code_set_jmp(cpl, skip, BC_JMP, block);
+    compile_code_set_jmp(cpl, entry, BC_JMP, bgn - skip);
+    compile_code_set_jmp(cpl, skip, BC_JMP, end - bgn + 3);
+    compile_code_set_jmp(cpl, test, jmp, skip - (test + 3));
 }
 
-static void compile_stmt_break(compile_t *cpl, stmt_t *s)
+/****************************************************************
+ *                        For in form
+ *
+ *              +------------+
+ *              |   state    |  counter, limit | array, index
+ *              +------------+
+ *              | JMP Begin  | ------------------+
+ * skip:        + ---------- + <-----------+     |
+ *         +--- |   JMP to   |             |     |
+ *         |    |  LoopEnd   |             |     |
+ * Begin:  |    +------------+ <-----------|-----+   <------+
+ *         |    |  FOR step  | -- done ----|-----------+    |
+ *         |    + ---------- +             |           |    |
+ *         |    | store var  |             |           |    |
+ *         |    + ---------- +             |           |    |
+ *         |    | statements | -- break ---+           |    |
+ *         |    |            | -- continue -> Begin    |    |
+ * End:    |    + ---------- +                         |    |
+ *         |    | JMP Begin  | ------------------------|----+
+ * LoopEnd +--> +------------+ <-----------------------+
+ *              | POP, POP   |
+ *              +------------+
+ *
+ * The state of loop is kept on the stack, the step instruction fuse
+ * the increase, test and jump, and push the value of this round, it
+ * is stored to the variable. So the variable could be assigned in the
+ * block, without effect on the loop.
+ ***************************************************************/
+static void compile_stmt_for(compile_t *cpl, stmt_t *s)
 {
-    int bgn, end, total;
+    expr_t *name = ast_expr_lft(s->expr);
+    expr_t *iter = ast_expr_rht(s->expr);
+    int entry, bgn, skip, end, bgn_bk, skip_bk;
+    uint8_t loop;
 
-    (void) s;
-    bgn = cpl->skip_pos;
-    end = compile_code_pos(cpl);
-    total = end - bgn + 3;
+    // loop variable is defined in current function, as var statement
+    if (0 > compile_varmap_find_add(cpl, compile_sym_add(cpl, ast_expr_text(name)))) {
+        cpl->error = ERR_NotEnoughMemory;
+        return;
+    }
 
-    compile_code_append_jmp(cpl, BC_JMP, -total);
-}
+    if (iter->type == EXPR_RANGE) {
+        compile_expr(cpl, ast_expr_lft(iter));
+        compile_expr(cpl, ast_expr_rht(iter));
+        loop = BC_FOR_RANGE_JMP;
+    } else {
+        compile_expr(cpl, iter);
+        compile_code_append(cpl, BC_PUSH_ZERO);
+        loop = BC_FOR_EACH_JMP;
+    }
 
-static void compile_stmt_continue(compile_t *cpl, stmt_t *s)
-{
-    int bgn, end, total;
+    entry = compile_code_pos(cpl);
+    compile_code_extend(cpl, 3);
+    skip = compile_code_pos(cpl);
+    compile_code_extend(cpl, 3);
+
+    bgn = compile_code_pos(cpl);
+    compile_code_extend(cpl, 3);
+    compile_expr_store(cpl, name, BC_STORE_VAR_POP);
+
+    bgn_bk = cpl->bgn_pos; skip_bk = cpl->skip_pos;
+    cpl->bgn_pos = bgn;    cpl->skip_pos = skip;
+
+    compile_stmt_block(cpl, s->block); if (cpl->error) return;
+
+    cpl->bgn_pos = bgn_bk;
+    cpl->skip_pos = skip_bk;
 
-    (void) s;
-    bgn = cpl->bgn_pos;
     end = compile_code_pos(cpl);
-    total = end - bgn + 3;
-    compile_code_append_jmp(cpl, BC_JMP, -total);
+    compile_code_append_jmp(cpl, BC_JMP, bgn - (end + 3));
+    compile_code_append(cpl, BC_POP);
+    compile_code_append(cpl, BC_POP);
+
+    compile_code_set_jmp(cpl, entry, BC_JMP, bgn - skip);
+    compile_code_set_jmp(cpl, skip, BC_JMP, end - bgn + 3);
+    compile_code_set_jmp(cpl, bgn, loop, end - bgn);
 }
 
-static int compile_save_main_vmap(compile_t *cpl)
-{
-    compile_func_t *f = compile_func_cur(cpl);
-    int i;
+/****************************************************************
+ *                        Switch form
+ *
+ *              +------------+
+ *              |   value    |
+ *              +------------+
+ *              | JMP Table  | ------------------+
+ * skip:        + ---------- + <-- break         |
+ *         +--- |  JMP End   |                   |
+ * Table:  |    +------------+ <-----------------+
+ *         |    |  SWITCH_x  |  pop the value
+ *         |    + ---------- +
+ *         |    |  CASE_JMP  | -- default ---------------+
+ *         |    |  CASE_JMP  | -- case ------+           |
+ *         |    |    ...     |               |           |
+ * Case:   |    + ---------- + <-------------+           |
+ *         |    |   block    |                           |
+ *         |    |  JMP skip  |                           |
+ *         |    |    ...     |                           |
+ *         |    + ---------- + <-------------------------+
+ *         |    |  default   |
+ * End:    +--> +------------+
+ *
+ * The value of case should be integer or string constant, all of them
+ * in the same type. Integers in a dense range are indexed by the table
+ * (BC_SWITCH_TABLE), the others are sorted and binary searched by
+ * interpreter (BC_SWITCH_NUM, BC_SWITCH_STR).
+ *
+ * A case without statement share the block of next one, or there is no
+ * fall through. Break in the block jump out of switch.
+ ***************************************************************/
+#define SWITCH_DENSE_RATIO  2
+#define SWITCH_DENSE_MIN    8
+#define SWITCH_UNSET        (-32768)    // offset of entry not set yet
 
-    if (cpl->error) {
-        return -cpl->error;
-    }
+#define CASE_NUM            1
+#define CASE_STR            2
 
-    if (!env_is_interactive(cpl->env)) {
-        return 0;
+// return: type of constant, or 0 if not
+static int compile_case_const(expr_t *e, int *num)
+{
+    if (e->type == EXPR_NUM) {
+        *num = ast_expr_num(e);
+        return CASE_NUM;
     }
-
-    if (f->var_num > INTERACTIVE_VAR_MAX) {
-        cpl->error = ERR_ResourceOutLimit;
-        return -1;
+    if (e->type == EXPR_NEG && ast_expr_lft(e)->type == EXPR_NUM) {
+        *num = -ast_expr_num(ast_expr_lft(e));
+        return CASE_NUM;
     }
+    return e->type == EXPR_STRING ? CASE_STR : 0;
+}
 
-    for (i = 0; i < f->var_num; i++) {
-        cpl->env->main_var_map[i] = f->var_map[i];
+static inline expr_t *compile_case_next(expr_t **e) {
+    expr_t *curr = *e;
+
+    if (curr && curr->type == EXPR_COMMA) {
+        *e = ast_expr_rht(curr);
+        return ast_expr_lft(curr);
     }
+    *e = NULL;
+    return curr;
+}
 
-    cpl->env->main_var_num = i;
-    return 0;
+static inline int compile_switch_id(uint8_t *ids, int i) {
+    return (ids[i * 2] << 8) | ids[i * 2 + 1];
 }
 
-int compile_init(compile_t *cpl, env_t *env, void *heap_ptr, int heap_size)
+// compare the constant of id with number or string
+static int compile_switch_cmp(compile_t *cpl, uint8_t op, int id, double num, const char *str)
 {
-    cpl->error = 0;
-
-    cpl->func_size = 0;
-    cpl->func_cur = 0;
-    cpl->func_num = 0;
-    cpl->func_buf = NULL;
-
-    if (env->exe.func_num > 0) {
-        cpl->func_offset = env->exe.func_num - 1;
+    if (op == BC_SWITCH_STR) {
+        return strcmp((const char *)cpl->env->exe.string_map[id], str);
     } else {
-        cpl->func_offset = 0;
+        double n = cpl->env->exe.number_map[id];
+        return n < num ? -1 : n > num ? 1 : 0;
     }
+}
 
-    cpl->env = env;
-
-    heap_init(&cpl->heap, heap_ptr, heap_size);
+// sort the ids of constant, by insertion
+static void compile_switch_sort(compile_t *cpl, uint8_t op, uint8_t *ids, int n)
+{
+    int i, j;
 
-    if (0 != compile_func_append(cpl, -1)) {
-        return -1;
-    }
+    for (i = 1; i < n; i++) {
+        int id = compile_switch_id(ids, i);
+        double num = op == BC_SWITCH_NUM ? cpl->env->exe.number_map[id] : 0;
+        const char *str = op == BC_SWITCH_STR ? (const char *)cpl->env->exe.string_map[id] : NULL;
 
-    // Interactive mode, restore main var history
-    if (env->main_var_map && env->main_var_num) {
-        int i;
-        for (i = 0; i < env->main_var_num; i++) {
-            compile_var_add(cpl, env->main_var_map[i]);
+        for (j = i; j > 0 && compile_switch_cmp(cpl, op, compile_switch_id(ids, j - 1), num, str) > 0; j--) {
+            ids[j * 2] = ids[j * 2 - 2];
+            ids[j * 2 + 1] = ids[j * 2 - 1];
         }
+        ids[j * 2] = id >> 8;
+        ids[j * 2 + 1] = id;
     }
-
-    return 0;
 }
 
-int compile_deinit(compile_t *cpl)
+// return: the entry of constant
+static int compile_switch_entry(compile_t *cpl, int table, expr_t *e)
 {
-    if (cpl) {
-        int i;
-        //if (cpl->func_buf) {
-        if (0) {
-            for (i = 0; i < cpl->func_num; i++) {
-                compile_func_t *f = cpl->func_buf + i;
+    uint8_t *code = compile_code_buf(cpl) + table;
+    const char *str = NULL;
+    int num = 0, lo, hi;
 
-                if (f->var_map) free(f->var_map);
-                if (f->code_buf) free(f->code_buf);
-            }
+    if (CASE_STR == compile_case_const(e, &num)) {
+        str = ast_expr_text(e);
+    }
 
-            free(cpl->func_buf);
+    if (code[0] == BC_SWITCH_TABLE) {
+        return 1 + num - (int) cpl->env->exe.number_map[compile_switch_id(code + 1, 0)];
+    }
+
+    lo = 0;
+    hi = compile_switch_id(code + 1, 0) - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = compile_switch_cmp(cpl, code[0], compile_switch_id(code + 3, mid), num, str);
+
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else
+        if (cmp > 0) {
+            hi = mid - 1;
+        } else {
+            return 1 + mid;
         }
-        return 0;
     }
     return -1;
 }
 
-int compile_stmt(compile_t *cpl, stmt_t *stmt)
+static void compile_switch_set(compile_t *cpl, int entries, int entry, int target)
 {
-    if (!cpl || !stmt) {
-        return -1;
+    uint8_t *code = compile_code_buf(cpl) + entries + entry * 3;
+
+    if ((int16_t) ((code[1] << 8) | code[2]) != SWITCH_UNSET) {
+        // value is duplicated
+        cpl->error = ERR_InvalidSementic;
+        return;
     }
+    compile_code_set_jmp(cpl, entries + entry * 3, BC_CASE_JMP, target - (entries + entry * 3 + 3));
+}
 
-    if (cpl->error) {
-        return -cpl->error;
+// Emit the switch instruction, return the number of entries
+static int compile_switch_head(compile_t *cpl, stmt_t *cases)
+{
+    stmt_t *c;
+    expr_t *list, *e;
+    int type = 0, n = 0, min = 0, max = 0, num = 0, id;
+    uint8_t *code;
+    uint8_t op;
+
+    for (c = cases; c; c = c->next) {
+        for (list = c->expr; (e = compile_case_next(&list)) != NULL; n++) {
+            int t = compile_case_const(e, &num);
+
+            if (!t || (type && t != type)) {
+                cpl->error = ERR_InvalidSementic;
+                return -1;
+            }
+            if (!type || num < min) min = num;
+            if (!type || num > max) max = num;
+            type = t;
+        }
     }
 
-    switch(stmt->type) {
-    case STMT_PASS: break;
-    case STMT_EXPR: compile_stmt_expr(cpl, stmt); break;
-    case STMT_VAR:  compile_stmt_var(cpl, stmt); break;
-    case STMT_IF:   compile_stmt_cond(cpl, stmt); break;
-    case STMT_WHILE:    compile_stmt_while(cpl, stmt); break;
-    case STMT_BREAK:    compile_stmt_break(cpl, stmt); break;
-    case STMT_CONTINUE: compile_stmt_continue(cpl, stmt); break;
-    case STMT_RET:  compile_stmt_return(cpl, stmt); break;
-    default: cpl->error = ERR_NotImplemented;
+    if (type == CASE_NUM && (double) max - min < (double) n * SWITCH_DENSE_RATIO + SWITCH_DENSE_MIN) {
+        if (0 > (id = compile_number_find_add(cpl, min))) {
+            cpl->error = ERR_ResourceOutLimit;
+            return -1;
+        }
+        n = max - min + 1;
+        compile_code_append_arg_u16(cpl, BC_SWITCH_TABLE, id);
+        compile_code_append(cpl, n >> 8);
+        compile_code_append(cpl, n);
+        return n + 1;
+    }
+
+    op = type == CASE_STR ? BC_SWITCH_STR : BC_SWITCH_NUM;
+    compile_code_append_arg_u16(cpl, op, n);
+    for (c = cases; c && !cpl->error; c = c->next) {
+        for (list = c->expr; (e = compile_case_next(&list)) != NULL; ) {
+            if (op == BC_SWITCH_STR) {
+                id = compile_string_find_add(cpl, compile_sym_add(cpl, ast_expr_text(e)));
+            } else {
+                compile_case_const(e, &num);
+                id = compile_number_find_add(cpl, num);
+            }
+            if (id < 0) {
+                cpl->error = ERR_ResourceOutLimit;
+                return -1;
+            }
+            compile_code_append(cpl, id >> 8);
+            compile_code_append(cpl, id);
+        }
+    }
+    if (cpl->error) {
+        return -1;
     }
 
-    return -cpl->error;
+    code = compile_code_buf(cpl) + compile_code_pos(cpl) - n * 2;
+    compile_switch_sort(cpl, op, code, n);
+
+    return n + 1;
 }
 
-int compile_one_stmt(compile_t *cpl, stmt_t *stmt)
+static void compile_stmt_switch(compile_t *cpl, stmt_t *s)
 {
-    int ret = compile_stmt(cpl, stmt);
+    int entry, skip, table, entries, end, dflt = -1, skip_bk, n, i;
+    stmt_t *c;
 
-    if (ret == 0) {
-        //compile_code_dump(cpl);
-        compile_code_append(cpl, BC_STOP);
-        return compile_save_main_vmap(cpl);
+    compile_expr(cpl, s->expr);
+
+    entry = compile_code_pos(cpl);
+    compile_code_extend(cpl, 3);
+    skip = compile_code_pos(cpl);
+    compile_code_extend(cpl, 3);
+
+    table = compile_code_pos(cpl);
+    if (0 > (n = compile_switch_head(cpl, s->block))) {
+        return;
+    }
+    entries = compile_code_pos(cpl);
+    for (i = 0; i < n; i++) {
+        compile_code_append_jmp(cpl, BC_CASE_JMP, SWITCH_UNSET);
     }
 
-    return ret;
-}
+    skip_bk = cpl->skip_pos;
+    cpl->skip_pos = skip;
 
-int compile_multi_stmt(compile_t *cpl, stmt_t *s)
-{
-    while (s) {
-        int t = s->type;
+    for (c = s->block; c && !cpl->error; c = c->next) {
+        int pos = compile_code_pos(cpl);
+        expr_t *list, *e;
 
-        if (compile_stmt(cpl, s)) {
-            break;
+        if (!c->expr) {
+            if (dflt >= 0) {
+                cpl->error = ERR_InvalidSementic;
+                return;
+            }
+            dflt = pos;
+        }
+        for (list = c->expr; (e = compile_case_next(&list)) != NULL; ) {
+            compile_switch_set(cpl, entries, compile_switch_entry(cpl, table, e), pos);
         }
-        s= s->next;
 
-        if (s && t == STMT_EXPR) {
-            compile_code_append(cpl, BC_POP);
+        if (c->block) {
+            compile_stmt_block(cpl, c->block);
+            compile_code_append_jmp(cpl, BC_JMP, skip - (compile_code_pos(cpl) + 3));
         }
     }
-    compile_code_append(cpl, BC_STOP);
-    return compile_save_main_vmap(cpl);
+    if (cpl->error) {
+        return;
+    }
+
+    cpl->skip_pos = skip_bk;
+
+    end = compile_code_pos(cpl);
+    for (i = 0; i < n; i++) {
+        uint8_t *code = compile_code_buf(cpl) + entries + i * 3;
+
+        if ((int16_t) ((code[1] << 8) | code[2]) == SWITCH_UNSET) {
+            compile_code_set_jmp(cpl, entries + i * 3, BC_CASE_JMP, (dflt >= 0 ? dflt : end) - (entries + i * 3 + 3));
+        }
+    }
+
+    compile_code_set_jmp(cpl, entry, BC_JMP, table - skip);
+    compile_code_set_jmp(cpl, skip, BC_JMP, end - table);
 }
 
-static void compile_func_stack_pop(compile_t *cpl, compile_func_t *fn)
+static void compile_stmt_break(compile_t *cpl, stmt_t *s)
 {
-    if (fn->stack_space > 0) {
-        //means bug, should be assert here.
-        cpl->error = ERR_SysError;
-    } else {
-        fn->stack_space--;
-    }
+    int bgn, end, total;
+
+    (void) s;
+    bgn = cpl->skip_pos;
+    end = compile_code_pos(cpl);
+    total = end - bgn + 3;
 
+    compile_code_append_jmp(cpl, BC_JMP, -total);
 }
 
-static void compile_func_stack_push(compile_t *cpl, compile_func_t *fn)
+static void compile_stmt_continue(compile_t *cpl, stmt_t *s)
 {
-    (void) cpl;
-    fn->stack_space++;
-    if (fn->stack_space > fn->stack_high) {
-        fn->stack_high = fn->stack_space;
-    }
+    int bgn, end, total;
+
+    (void) s;
+    bgn = cpl->bgn_pos;
+    end = compile_code_pos(cpl);
+    total = end - bgn + 3;
+    compile_code_append_jmp(cpl, BC_JMP, -total);
 }
 
-static int compile_code_revise(compile_t *cpl, compile_func_t *fn)
+static int compile_try_add(compile_t *cpl, int bgn, int end, int handler)
 {
-    int off = 0;
-    int end = fn->code_num;
-    uint8_t *code = fn->code_buf;
+    compile_try_t *h;
+    int size;
 
-    while (off < end) {
-        const char *name;
-        int p1, p2;
-        int cp = off;
+    if (compile_func_cur(cpl)->try_num >= LIMIT_FUNC_TRY_SIZE) {
+        cpl->error = ERR_ResourceOutLimit;
+        return -1;
+    }
 
-        bcode_parse(code, &off, &name, &p1, &p2);
+    if (0 < (size = compile_extend_size(cpl, cpl->try_max, cpl->try_num, 1,
+                                 LIMIT_TRY_SIZE, DEF_TRY_SIZE))) {
+        compile_try_t *ptr;
+        if (NULL == (ptr = (compile_try_t *) compile_malloc(cpl, size * sizeof(compile_try_t)))) {
+            cpl->error = ERR_NotEnoughMemory;
+            return -1;
+        }
 
-        switch (code[cp]) {
-        case BC_STOP: break;
-        case BC_PASS: break;
+        if (cpl->try_buf) {
+            memcpy(ptr, cpl->try_buf, cpl->try_num * sizeof(compile_try_t));
+        }
 
-        /* Return instruction */
-        case BC_RET0: break;
-        case BC_RET:  break;
+        cpl->try_buf = ptr;
+        cpl->try_max = size;
+    } else
+    if (size < 0) {
+        return -1;
+    }
 
-        /* Jump instruction */
-        case BC_SJMP: break;
-        case BC_JMP:  break;
+    h = cpl->try_buf + cpl->try_num++;
+    h->func = cpl->func_cur;
+    h->bgn = bgn;
+    h->end = end;
+    h->handler = handler;
+    h->depth = 0;
+    compile_func_cur(cpl)->try_num++;
 
-        case BC_SJMP_T: break;
-        case BC_SJMP_F: break;
+    return 0;
+}
 
-        case BC_JMP_T: break;
-        case BC_JMP_F: break;
+/*
+ * Sort the handlers by function, keep the order of handlers in a function.
+ * Inner handler be added before the outer one.
+ */
+static void compile_try_group(compile_t *cpl)
+{
+    int i, j;
 
-        case BC_POP_SJMP_T: compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_POP_SJMP_F: compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_POP_JMP_T:  compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_POP_JMP_F:  compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_POP:        compile_func_stack_pop(cpl, fn);
-                            break;
+    for (i = 1; i < cpl->try_num; i++) {
+        compile_try_t h = cpl->try_buf[i];
+
+        for (j = i; j > 0 && cpl->try_buf[j - 1].func > h.func; j--) {
+            cpl->try_buf[j] = cpl->try_buf[j - 1];
+        }
+        cpl->try_buf[j] = h;
+    }
+}
+
+/*
+ * return: first handler of function, valid after compile_try_group
+ */
+static compile_try_t *compile_func_try(compile_t *cpl, int func_id)
+{
+    int i, n = 0;
+
+    for (i = 0; i < func_id; i++) {
+        n += cpl->func_buf[i].try_num;
+    }
+    return cpl->try_buf + n;
+}
+
+/****************************************************************
+ *                        Try form
+ *
+ * Begin:  +------------+
+ *         | statements |  guarded
+ * End:    + ---------- +
+ *         |  JMP Done  | ------------+
+ * Handler:+------------+             |
+ *         | store var  |  or POP     |
+ *         + ---------- +             |
+ *         | statements |             |
+ * Done:   +------------+ <-----------+
+ *
+ * Nothing is emitted to enter the try block, the range of it is recorded
+ * in the handler table of function (see executable.h), with the stack
+ * depth at begin, which is filled by compile_code_revise. On error the
+ * interpreter restore the stack, push the error value and jump to the
+ * handler.
+ *
+ * Call in return position of try block is not tail call, the frame is
+ * kept for the handler.
+ ***************************************************************/
+static void compile_stmt_try(compile_t *cpl, stmt_t *s)
+{
+    int bgn, end, handler, done;
+
+    bgn = compile_code_pos(cpl);
+    cpl->try_nest++;
+    compile_stmt_block(cpl, s->block);
+    cpl->try_nest--;
+    if (cpl->error) {
+        return;
+    }
+
+    end = compile_code_pos(cpl);
+    if (end == bgn) {
+        // nothing guarded, the handler is never reached
+        return;
+    }
+    compile_code_extend(cpl, 3);
+    handler = compile_code_pos(cpl);
+    if (cpl->error || 0 != compile_try_add(cpl, bgn, end, handler)) {
+        return;
+    }
+
+    if (s->expr) {
+        // error variable is defined in current function, as var statement
+        if (0 > compile_varmap_find_add(cpl, compile_sym_add(cpl, ast_expr_text(s->expr)))) {
+            cpl->error = ERR_NotEnoughMemory;
+            return;
+        }
+        compile_expr_store(cpl, s->expr, BC_STORE_VAR_POP);
+    } else {
+        compile_code_append(cpl, BC_POP);
+    }
+    compile_stmt_block(cpl, s->other);
+
+    done = compile_code_pos(cpl);
+    compile_code_set_jmp(cpl, end, BC_JMP, done - handler);
+}
+
+static void compile_stmt_throw(compile_t *cpl, stmt_t *s)
+{
+    if (s->expr) {
+        compile_expr(cpl, s->expr);
+    } else {
+        compile_code_append(cpl, BC_PUSH_UND);
+    }
+    compile_code_append(cpl, BC_THROW);
+}
+
+/*
+ * Function with yield statement is a generator, see compile_func_def.
+ * The frame is detached at yield, with the stack above it, so yield in
+ * the middle of loop or try block is fine.
+ */
+static void compile_stmt_yield(compile_t *cpl, stmt_t *s)
+{
+    if (cpl->generator != BC_GEN_START) {
+        // yield in main, or with await
+        cpl->error = ERR_InvalidSementic;
+        return;
+    }
+
+    if (s->expr) {
+        compile_expr(cpl, s->expr);
+    } else {
+        compile_code_append(cpl, BC_PUSH_UND);
+    }
+    compile_code_append(cpl, BC_YIELD);
+}
+
+static int compile_save_main_vmap(compile_t *cpl)
+{
+    compile_func_t *f = compile_func_cur(cpl);
+    int i;
+
+    if (cpl->error) {
+        return -cpl->error;
+    }
+
+    if (!env_is_interactive(cpl->env)) {
+        return 0;
+    }
+
+    if (f->var_num > INTERACTIVE_VAR_MAX) {
+        cpl->error = ERR_ResourceOutLimit;
+        return -1;
+    }
+
+    for (i = 0; i < f->var_num; i++) {
+        cpl->env->main_var_map[i] = f->var_map[i];
+    }
+
+    cpl->env->main_var_num = i;
+    return 0;
+}
+
+int compile_init(compile_t *cpl, env_t *env, void *heap_ptr, int heap_size)
+{
+    cpl->error = 0;
+
+    cpl->func_size = 0;
+    cpl->func_cur = 0;
+    cpl->func_num = 0;
+    cpl->func_buf = NULL;
+
+    cpl->try_max = 0;
+    cpl->try_num = 0;
+    cpl->try_nest = 0;
+    cpl->generator = 0;
+    cpl->try_buf = NULL;
+
+    if (env->exe.func_num > 0) {
+        cpl->func_offset = env->exe.func_num - 1;
+    } else {
+        cpl->func_offset = 0;
+    }
+
+    cpl->env = env;
+
+    heap_init(&cpl->heap, heap_ptr, heap_size);
+
+    if (0 != compile_func_append(cpl, -1)) {
+        return -1;
+    }
+
+    // Interactive mode, restore main var history
+    if (env->main_var_map && env->main_var_num) {
+        int i;
+        for (i = 0; i < env->main_var_num; i++) {
+            compile_var_add(cpl, env->main_var_map[i]);
+        }
+    }
+
+    return 0;
+}
+
+int compile_deinit(compile_t *cpl)
+{
+    if (cpl) {
+        int i;
+        //if (cpl->func_buf) {
+        if (0) {
+            for (i = 0; i < cpl->func_num; i++) {
+                compile_func_t *f = cpl->func_buf + i;
+
+                if (f->var_map) free(f->var_map);
+                if (f->code_buf) free(f->code_buf);
+            }
+
+            free(cpl->func_buf);
+        }
+        return 0;
+    }
+    return -1;
+}
+
+int compile_stmt(compile_t *cpl, stmt_t *stmt)
+{
+    if (!cpl || !stmt) {
+        return -1;
+    }
+
+    if (cpl->error) {
+        return -cpl->error;
+    }
+
+    switch(stmt->type) {
+    case STMT_PASS: break;
+    case STMT_EXPR: compile_stmt_expr(cpl, stmt); break;
+    case STMT_VAR:  compile_stmt_var(cpl, stmt); break;
+    case STMT_IF:   compile_stmt_cond(cpl, stmt); break;
+    case STMT_WHILE:    compile_stmt_while(cpl, stmt); break;
+    case STMT_FOR:      compile_stmt_for(cpl, stmt); break;
+    case STMT_SWITCH:   compile_stmt_switch(cpl, stmt); break;
+    case STMT_BREAK:    compile_stmt_break(cpl, stmt); break;
+    case STMT_CONTINUE: compile_stmt_continue(cpl, stmt); break;
+    case STMT_TRY:      compile_stmt_try(cpl, stmt); break;
+    case STMT_THROW:    compile_stmt_throw(cpl, stmt); break;
+    case STMT_YIELD:    compile_stmt_yield(cpl, stmt); break;
+    case STMT_RET:  compile_stmt_return(cpl, stmt); break;
+    default: cpl->error = ERR_NotImplemented;
+    }
+
+    return -cpl->error;
+}
+
+int compile_one_stmt(compile_t *cpl, stmt_t *stmt)
+{
+    int ret = compile_stmt(cpl, stmt);
+
+    if (ret == 0) {
+        //compile_code_dump(cpl);
+        compile_code_append(cpl, BC_STOP);
+        return compile_save_main_vmap(cpl);
+    }
+
+    return ret;
+}
+
+int compile_multi_stmt(compile_t *cpl, stmt_t *s)
+{
+    while (s) {
+        // result of the last expression is kept, for interactive mode
+        if (s->type == STMT_EXPR && s->next) {
+            compile_expr_discard(cpl, s->expr);
+        } else {
+            compile_stmt(cpl, s);
+        }
+        if (cpl->error) {
+            break;
+        }
+        s = s->next;
+    }
+    compile_code_append(cpl, BC_STOP);
+    return compile_save_main_vmap(cpl);
+}
+
+/****************************************************************
+ *                    Byte code optimize
+ *
+ * Peephole pass run on each function after it compiled, and
+ * before the code be relocated:
+ *   - jump to jump, is threaded to the final target
+ *   - jump to return, is replaced by the return
+ *   - jump to next instruction, is removed
+ *   - "Jc L1; JMP L2; L1:" is folded into "J!c L2"
+ *   - "LOGIC_NOT; POP_JMP_x" is folded into "POP_JMP_!x"
+ *   - "PUSH_x; POP" is removed
+ *   - "PUSH_TRUE/FALSE; POP_JMP_x" is resolved at compile time
+ *   - unreachable code is removed
+ *
+ * The code is layout again at last, short jump is used if possible.
+ * Bounds of try block and the handler are kept as jump target, the
+ * handler is reachable always, see compile_stmt_try.
+ ***************************************************************/
+#define OPT_START       1   // begin of instruction
+#define OPT_DEAD        2   // instruction removed
+#define OPT_TARGET      4   // instruction is target of jump
+#define OPT_REACH       8   // instruction is reachable
+#define OPT_SHORT       16  // jump instruction use short form
+
+#define OPT_ROUND_MAX   8
+#define OPT_THREAD_MAX  8
+
+typedef struct compile_opt_t {
+    int       size;
+    int       try_num;
+    uint8_t  *code;
+    uint8_t  *flag;
+    uint16_t *target;
+    uint16_t *pos;
+    compile_try_t *try_buf;
+} compile_opt_t;
+
+/*
+ * Get free memory of compile heap, for temporary usage.
+ * The memory is invalid after next compile_malloc!
+ */
+static void *compile_scratch(compile_t *cpl, int size)
+{
+    int keep_size = sizeof(intptr_t) * (cpl->func_num * 2 + 2);
+
+    size = SIZE_ALIGN(size);
+    if (cpl->heap.free + size + keep_size > cpl->heap.size) {
+        compile_gc(cpl);
+        if (cpl->heap.free + size + keep_size > cpl->heap.size) {
+            return NULL;
+        }
+    }
+
+    return cpl->heap.base + cpl->heap.free;
+}
+
+static inline int compile_code_is_cmp_jmp(uint8_t code) {
+    return code >= BC_TEQ_JMP_F && code <= BC_TLE_SJMP_F;
+}
+
+// Step of for loop, push a value if it go on, see compile_stmt_for
+static inline int compile_code_is_loop_jmp(uint8_t code) {
+    return code >= BC_FOR_RANGE_JMP && code <= BC_FOR_EACH_SJMP;
+}
+
+static inline int compile_code_is_jmp(uint8_t code) {
+    return (code >= BC_JMP && code <= BC_POP_SJMP_F) || compile_code_is_cmp_jmp(code) ||
+           compile_code_is_loop_jmp(code) || code == BC_CASE_JMP;
+}
+
+// Entry of switch table, is kept in place and in long form
+static inline int compile_code_is_fixed_jmp(uint8_t code) {
+    return code == BC_CASE_JMP;
+}
+
+// Note: jumps are kept as long form in optimize
+static inline int compile_code_is_cond_jmp(uint8_t code) {
+    return code == BC_JMP_T || code == BC_JMP_F || code == BC_POP_JMP_T || code == BC_POP_JMP_F;
+}
+
+static inline int compile_code_is_pop_jmp(uint8_t code) {
+    return code == BC_POP_JMP_T || code == BC_POP_JMP_F;
+}
+
+static inline int compile_code_is_terminal(uint8_t code) {
+    return code == BC_JMP || code == BC_RET || code == BC_RET0 || code == BC_STOP || code == BC_THROW ||
+           code == BC_GEN_RET;
+}
+
+static inline int compile_code_is_pure_push(uint8_t code) {
+    return code >= BC_PUSH_UND && code <= BC_PUSH_NATIVE;
+}
+
+static inline uint8_t compile_code_jmp_long(uint8_t code) {
+    // short form follow the long form, see bcode.h
+    if (compile_code_is_cmp_jmp(code)) {
+        return ((code - BC_TEQ_JMP_F) & 1) ? code - 1 : code;
+    }
+    if (compile_code_is_loop_jmp(code)) {
+        return ((code - BC_FOR_RANGE_JMP) & 1) ? code - 1 : code;
+    }
+    if (compile_code_is_fixed_jmp(code)) {
+        return code;
+    }
+    return ((code - BC_JMP) & 1) ? code - 1 : code;
+}
+
+static inline uint8_t compile_code_jmp_invert(uint8_t code) {
+    switch (code) {
+    case BC_JMP_T:      return BC_JMP_F;
+    case BC_JMP_F:      return BC_JMP_T;
+    case BC_POP_JMP_T:  return BC_POP_JMP_F;
+    default:            return BC_POP_JMP_T;
+    }
+}
+
+// jump instruction is presented as long form
+static inline uint8_t compile_opt_code(compile_opt_t *opt, int p)
+{
+    uint8_t code = opt->code[p];
+
+    return compile_code_is_jmp(code) ? compile_code_jmp_long(code) : code;
+}
+
+// set jump instruction, and keep the form of it
+static inline void compile_opt_set_jmp(compile_opt_t *opt, int p, uint8_t code)
+{
+    int is_short = opt->code[p] != compile_code_jmp_long(opt->code[p]);
+
+    opt->code[p] = code + is_short;
+}
+
+static inline int compile_opt_length(compile_opt_t *opt, int p)
+{
+    const char *name;
+    int param1, param2;
+    int off = p;
+
+    bcode_parse(opt->code, &off, &name, &param1, &param2);
+    return off - p;
+}
+
+static inline int compile_opt_next(compile_opt_t *opt, int p)
+{
+    p += compile_opt_length(opt, p);
+    while (p < opt->size && (opt->flag[p] & OPT_DEAD)) {
+        p += compile_opt_length(opt, p);
+    }
+    return p;
+}
+
+static inline int compile_opt_resolve(compile_opt_t *opt, int p)
+{
+    while (p < opt->size && (opt->flag[p] & OPT_DEAD)) {
+        p += compile_opt_length(opt, p);
+    }
+    return p;
+}
+
+static void compile_opt_remove(compile_opt_t *opt, int p)
+{
+    int next = compile_opt_next(opt, p);
+
+    opt->flag[p] |= OPT_DEAD;
+    // jump to it, will land on the next one
+    if ((opt->flag[p] & OPT_TARGET) && next < opt->size) {
+        opt->flag[next] |= OPT_TARGET;
+    }
+}
+
+// Replace instruction with a shorter one, the left bytes removed
+static void compile_opt_shrink(compile_opt_t *opt, int p, uint8_t code)
+{
+    int i, n = compile_opt_length(opt, p);
+
+    opt->code[p] = code;
+    for (i = compile_opt_length(opt, p); i < n; i++) {
+        opt->code[p + i] = BC_PASS;
+        opt->flag[p + i] = OPT_START | OPT_DEAD;
+    }
+}
+
+static int compile_opt_decode(compile_opt_t *opt)
+{
+    int p = 0, i;
+
+    memset(opt->flag, 0, opt->size);
+    while (p < opt->size) {
+        const char *name;
+        int param1, param2;
+        int off = p;
+
+        bcode_parse(opt->code, &off, &name, &param1, &param2);
+        opt->flag[p] = OPT_START;
+        if (compile_code_is_jmp(opt->code[p])) {
+            int target = off + param1;
+
+            if (target < 0 || target >= opt->size) {
+                return -1;
+            }
+            opt->target[p] = target;
+        }
+        p = off;
+    }
+
+    for (i = 0; i < opt->try_num; i++) {
+        compile_try_t *h = opt->try_buf + i;
+
+        if (!(opt->flag[h->bgn] & OPT_START) || !(opt->flag[h->handler] & OPT_START) ||
+            (h->end < opt->size && !(opt->flag[h->end] & OPT_START))) {
+            return -1;
+        }
+    }
+
+    return p == opt->size ? 0 : -1;
+}
+
+static int compile_opt_mark_target(compile_opt_t *opt)
+{
+    int p, i;
+
+    for (p = 0; p < opt->size; p++) {
+        opt->flag[p] &= ~OPT_TARGET;
+    }
+
+    for (p = compile_opt_resolve(opt, 0); p < opt->size; p = compile_opt_next(opt, p)) {
+        if (compile_code_is_jmp(opt->code[p])) {
+            int target = compile_opt_resolve(opt, opt->target[p]);
+
+            if (target >= opt->size) {
+                return -1;
+            }
+            opt->target[p] = target;
+            opt->flag[target] |= OPT_TARGET;
+        }
+    }
+
+    for (i = 0; i < opt->try_num; i++) {
+        compile_try_t *h = opt->try_buf + i;
+
+        opt->flag[compile_opt_resolve(opt, h->handler)] |= OPT_TARGET;
+        opt->flag[compile_opt_resolve(opt, h->bgn)] |= OPT_TARGET;
+        if ((p = compile_opt_resolve(opt, h->end)) < opt->size) {
+            opt->flag[p] |= OPT_TARGET;
+        }
+    }
+
+    return 0;
+}
+
+static int compile_opt_peephole(compile_opt_t *opt)
+{
+    int changed = 0;
+    int p, q;
+
+    for (p = compile_opt_resolve(opt, 0); p < opt->size; p = compile_opt_next(opt, p)) {
+        uint8_t code = compile_opt_code(opt, p);
+
+        if (opt->flag[p] & OPT_DEAD) {
+            // removed in this round
+            continue;
+        }
+
+        q = compile_opt_next(opt, p);
+        if (compile_code_is_jmp(code)) {
+            int target = opt->target[p];
+            int i;
+
+            for (i = 0; i < OPT_THREAD_MAX && target != p && compile_opt_code(opt, target) == BC_JMP; i++) {
+                target = compile_opt_resolve(opt, opt->target[target]);
+            }
+            if (target != opt->target[p]) {
+                opt->target[p] = target;
+                changed++;
+            }
+
+            if (target == q && !compile_code_is_cmp_jmp(code) && !compile_code_is_loop_jmp(code) &&
+                !compile_code_is_fixed_jmp(code)) {
+                if (compile_code_is_pop_jmp(code)) {
+                    compile_opt_shrink(opt, p, BC_POP);
+                } else {
+                    compile_opt_remove(opt, p);
+                }
+                changed++;
+            } else
+            if (code == BC_JMP && (opt->code[target] == BC_RET || opt->code[target] == BC_RET0 || opt->code[target] == BC_STOP)) {
+                compile_opt_shrink(opt, p, opt->code[target]);
+                changed++;
+            } else
+            if (compile_code_is_cond_jmp(code) && q < opt->size && compile_opt_code(opt, q) == BC_JMP &&
+                !(opt->flag[q] & OPT_TARGET) && target == compile_opt_next(opt, q)) {
+                compile_opt_set_jmp(opt, q, compile_code_jmp_invert(code));
+                compile_opt_remove(opt, p);
+                changed++;
+            }
+            continue;
+        }
+
+        if (q >= opt->size || (opt->flag[q] & OPT_TARGET)) {
+            continue;
+        }
+
+        if (code == BC_LOGIC_NOT && compile_code_is_pop_jmp(compile_opt_code(opt, q))) {
+            compile_opt_set_jmp(opt, q, compile_code_jmp_invert(compile_opt_code(opt, q)));
+            compile_opt_remove(opt, p);
+            changed++;
+        } else
+        if ((code == BC_PUSH_TRUE || code == BC_PUSH_FALSE) && compile_code_is_pop_jmp(compile_opt_code(opt, q))) {
+            if ((code == BC_PUSH_TRUE) == (compile_opt_code(opt, q) == BC_POP_JMP_T)) {
+                compile_opt_set_jmp(opt, q, BC_JMP);
+            } else {
+                compile_opt_remove(opt, q);
+            }
+            compile_opt_remove(opt, p);
+            changed++;
+        } else
+        if (compile_code_is_pure_push(code) && opt->code[q] == BC_POP) {
+            compile_opt_remove(opt, q);
+            compile_opt_remove(opt, p);
+            changed++;
+        }
+    }
+
+    return changed;
+}
+
+static int compile_opt_reach(compile_opt_t *opt)
+{
+    int changed, p, i;
+
+    for (p = 0; p < opt->size; p++) {
+        opt->flag[p] &= ~OPT_REACH;
+    }
+
+    p = compile_opt_resolve(opt, 0);
+    if (p >= opt->size) {
+        return 0;
+    }
+    opt->flag[p] |= OPT_REACH;
+
+    for (i = 0; i < opt->try_num; i++) {
+        int handler = compile_opt_resolve(opt, opt->try_buf[i].handler);
+
+        if (handler < opt->size) {
+            opt->flag[handler] |= OPT_REACH;
+        }
+    }
+
+    // Loop until nothing new, backward jump need more sweep
+    do {
+        changed = 0;
+        for (; p < opt->size; p = compile_opt_next(opt, p)) {
+            uint8_t code = compile_opt_code(opt, p);
+            int q;
+
+            if (!(opt->flag[p] & OPT_REACH)) {
+                continue;
+            }
+
+            // target may be removed in this round, land on the next one
+            if (compile_code_is_jmp(code) && (q = compile_opt_resolve(opt, opt->target[p])) < opt->size &&
+                !(opt->flag[q] & OPT_REACH)) {
+                opt->flag[q] |= OPT_REACH;
+                changed++;
+            }
+
+            q = compile_opt_next(opt, p);
+            if (!compile_code_is_terminal(code) && q < opt->size && !(opt->flag[q] & OPT_REACH)) {
+                opt->flag[q] |= OPT_REACH;
+                // not changed, the next sweep is going on
+            }
+        }
+        p = compile_opt_resolve(opt, 0);
+    } while (changed);
+
+    changed = 0;
+    for (; p < opt->size; p = compile_opt_next(opt, p)) {
+        if (!(opt->flag[p] & OPT_REACH)) {
+            opt->flag[p] |= OPT_DEAD;
+            changed++;
+        }
+    }
+
+    return changed;
+}
+
+// return: size of code after layout
+static int compile_opt_layout(compile_opt_t *opt)
+{
+    int changed, p, end;
+
+    do {
+        changed = 0;
+        end = 0;
+        for (p = 0; p < opt->size; p += compile_opt_length(opt, p)) {
+            opt->pos[p] = end;
+            if (opt->flag[p] & OPT_DEAD) {
+                continue;
+            }
+            if (compile_code_is_jmp(opt->code[p])) {
+                end += (opt->flag[p] & OPT_SHORT) ? 2 : 3;
+            } else {
+                end += compile_opt_length(opt, p);
+            }
+        }
+        opt->pos[p] = end;
+
+        for (p = compile_opt_resolve(opt, 0); p < opt->size; p = compile_opt_next(opt, p)) {
+            if (compile_code_is_jmp(opt->code[p]) && !compile_code_is_fixed_jmp(opt->code[p]) && !(opt->flag[p] & OPT_SHORT)) {
+                int step = opt->pos[opt->target[p]] - (opt->pos[p] + 2);
+
+                if (step >= -128 && step <= 127) {
+                    opt->flag[p] |= OPT_SHORT;
+                    changed++;
+                }
+            }
+        }
+    } while (changed);
+
+    return end;
+}
+
+static void compile_opt_emit(compile_opt_t *opt, uint8_t *buf)
+{
+    int p;
+
+    for (p = compile_opt_resolve(opt, 0); p < opt->size; p = compile_opt_next(opt, p)) {
+        uint8_t *dst = buf + opt->pos[p];
+        uint8_t code = compile_opt_code(opt, p);
+
+        if (compile_code_is_jmp(code)) {
+            int step;
+
+            if (opt->flag[p] & OPT_SHORT) {
+                step = opt->pos[opt->target[p]] - (opt->pos[p] + 2);
+                dst[0] = code + 1;
+                dst[1] = step;
+            } else {
+                step = opt->pos[opt->target[p]] - (opt->pos[p] + 3);
+                dst[0] = code;
+                dst[1] = step >> 8;
+                dst[2] = step;
+            }
+        } else {
+            memcpy(dst, opt->code + p, compile_opt_length(opt, p));
+        }
+    }
+}
+
+static void compile_code_optimize(compile_t *cpl, int func_id)
+{
+    compile_func_t *fn;
+    compile_opt_t opt;
+    uint8_t *scratch;
+    int size, round, i;
+
+    size = cpl->func_buf[func_id].code_num;
+    if (cpl->error || size < 1) {
+        return;
+    }
+
+    // target & pos table, code copy and flag
+    if (NULL == (scratch = compile_scratch(cpl, size * 6 + 2))) {
+        // Not enough memory, keep the code unoptimized
+        return;
+    }
+    fn = cpl->func_buf + func_id;
+
+    opt.size   = size;
+    opt.try_num = fn->try_num;
+    opt.try_buf = compile_func_try(cpl, func_id);
+    opt.target = (uint16_t *) scratch;
+    opt.pos    = (uint16_t *) (scratch + size * 2);
+    opt.code   = scratch + size * 4 + 2;
+    opt.flag   = scratch + size * 5 + 2;
+    memcpy(opt.code, fn->code_buf, size);
+
+    if (0 != compile_opt_decode(&opt)) {
+        return;
+    }
+
+    for (round = 0; round < OPT_ROUND_MAX; round++) {
+        int changed;
+
+        if (0 != compile_opt_mark_target(&opt)) {
+            return;
+        }
+
+        changed  = compile_opt_peephole(&opt);
+        changed += compile_opt_reach(&opt);
+        if (!changed) {
+            break;
+        }
+    }
+
+    if (0 != compile_opt_mark_target(&opt)) {
+        return;
+    }
 
-        case BC_PUSH_UND:   compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_NAN:   compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_TRUE:  compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_FALSE: compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_ZERO:  compile_func_stack_push(cpl, fn);
-                            break;
+    size = compile_opt_layout(&opt);
+    if (size > fn->code_num) {
+        return;
+    }
 
-        case BC_PUSH_NUM:   compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_STR:   compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_VAR:   compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_REF:   compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_SCRIPT:compile_func_stack_push(cpl, fn);
-                            break;
-        case BC_PUSH_NATIVE:compile_func_stack_push(cpl, fn);
-                            break;
+    compile_opt_emit(&opt, fn->code_buf);
+    fn->code_num = size;
 
-        case BC_NEG:        break;
-        case BC_NOT:
-        case BC_LOGIC_NOT:  break;
+    for (i = 0; i < opt.try_num; i++) {
+        compile_try_t *h = opt.try_buf + i;
 
-        case BC_MUL:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_DIV:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_MOD:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_ADD:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_SUB:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_AAND:       compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_AOR:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_AXOR:       compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_LSHIFT:     compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_RSHIFT:     compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_TEQ:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_TNE:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_TGT:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_TGE:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_TLT:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_TLE:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_TIN:        compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_ASSIGN:     compile_func_stack_pop(cpl, fn);
-                            break;
-        case BC_FUNC_CALL:  compile_func_stack_pop(cpl, fn);
+        h->bgn = opt.pos[h->bgn];
+        h->end = opt.pos[h->end];
+        h->handler = opt.pos[h->handler];
+    }
+}
+
+/*
+ * Stack change of instruction.
+ */
+static int compile_code_stack_change(uint8_t code, int param)
+{
+    switch (code) {
+    case BC_PUSH_UND:
+    case BC_PUSH_NAN:
+    case BC_PUSH_ZERO:
+    case BC_PUSH_TRUE:
+    case BC_PUSH_FALSE:
+    case BC_PUSH_NUM:
+    case BC_PUSH_STR:
+    case BC_PUSH_VAR:
+    case BC_PUSH_REF:
+    case BC_PUSH_SCRIPT:
+    case BC_PUSH_NATIVE:
+    case BC_PUSH_CLOSURE:
+    case BC_PUSH_CELL:
+    case BC_GEN_START:
+    case BC_ASYNC:          return 1;
+
+    // value of the round, not pushed when jump out
+    case BC_FOR_RANGE_JMP:
+    case BC_FOR_RANGE_SJMP:
+    case BC_FOR_EACH_JMP:
+    case BC_FOR_EACH_SJMP:  return 1;
+
+    case BC_RET:
+    case BC_THROW:
+    case BC_YIELD:
+    case BC_GEN_RET:
+    case BC_POP:
+    case BC_POP_JMP_T:
+    case BC_POP_SJMP_T:
+    case BC_POP_JMP_F:
+    case BC_POP_SJMP_F:     return -1;
+
+    case BC_MUL:
+    case BC_DIV:
+    case BC_MOD:
+    case BC_ADD:
+    case BC_SUB:
+    case BC_LSHIFT:
+    case BC_RSHIFT:
+    case BC_AAND:
+    case BC_AOR:
+    case BC_AXOR:
+    case BC_TEQ:
+    case BC_TNE:
+    case BC_TGT:
+    case BC_TGE:
+    case BC_TLT:
+    case BC_TLE:
+    case BC_TIN:
+    case BC_PROP:
+    case BC_ELEM:
+    case BC_SWITCH_TABLE:
+    case BC_SWITCH_NUM:
+    case BC_SWITCH_STR:     return -1;
+
+    case BC_TEQ_JMP_F:
+    case BC_TEQ_SJMP_F:
+    case BC_TNE_JMP_F:
+    case BC_TNE_SJMP_F:
+    case BC_TGT_JMP_F:
+    case BC_TGT_SJMP_F:
+    case BC_TGE_JMP_F:
+    case BC_TGE_SJMP_F:
+    case BC_TLT_JMP_F:
+    case BC_TLT_SJMP_F:
+    case BC_TLE_JMP_F:
+    case BC_TLE_SJMP_F:     return -2;
+
+    case BC_STORE_VAR_POP:
+    case BC_ADD_STORE_VAR:
+    case BC_SUB_STORE_VAR:
+    case BC_ADD_STORE_VAR_NN:
+    case BC_SUB_STORE_VAR_NN:
+    case BC_STORE_CELL_POP:
+    case BC_ADD_STORE_CELL:
+    case BC_SUB_STORE_CELL:     return -1;
+
+    case BC_FUNC_CALL:
+    case BC_TAIL_CALL:
+    case BC_CALL0:
+    case BC_CALL1:
+    case BC_CALL2:
+    case BC_CALL3:          return -param;
+    case BC_ARRAY:
+    case BC_DICT:           return 1 - param;
+
+    default: break;
+    }
+
+    // number specialised: operand, operand => value, or reference, value => value
+    if (code >= BC_MUL_NN && code <= BC_SUB_ASSIGN_NN) {
+        return -1;
+    }
+
+    // reference, value => value
+    if (code >= BC_ASSIGN && code <= BC_RSHIFT_ASSIGN) {
+        return -1;
+    }
+
+    // object, key, value => value
+    if (code >= BC_PROP_ASSIGN && code <= BC_ELEM_RSHIFT_ASSIGN) {
+        return -2;
+    }
+
+    // STOP, PASS, RET0, NEG, NOT, LOGIC_NOT, PROP_METH, ELEM_METH, AWAIT
+    // and the jumps without pop
+    return 0;
+}
+
+/*
+ * Compute the stack high of function, and the stack depth of try block
+ */
+static void compile_code_revise(compile_t *cpl, int func_id)
+{
+    compile_func_t *fn;
+    compile_try_t *handlers;
+    int16_t *depth;
+    int off, cur, high, last, i;
+
+    if (cpl->error) {
+        return;
+    }
+
+    // depth table of jump target, if no memory, run without it
+    depth = (int16_t *) compile_scratch(cpl, sizeof(int16_t) * cpl->func_buf[func_id].code_num);
+    fn = cpl->func_buf + func_id;
+    handlers = compile_func_try(cpl, func_id);
+    if (depth) {
+        for (off = 0; off < fn->code_num; off++) {
+            depth[off] = -1;
+        }
+    }
+
+    off = cur = high = last = 0;
+    while (off < fn->code_num) {
+        const char *name;
+        int p1, p2;
+        int cp = off;
+        uint8_t code = fn->code_buf[cp];
+
+        bcode_parse(fn->code_buf, &off, &name, &p1, &p2);
+
+        if (depth && depth[cp] >= 0) {
+            if (compile_code_is_terminal(last) || depth[cp] > cur) {
+                cur = depth[cp];
+            }
+        }
+
+        // handler is entered with the error value pushed
+        for (i = 0; i < fn->try_num; i++) {
+            compile_try_t *h = handlers + i;
+
+            if (h->bgn == cp) {
+                h->depth = cur;
+            }
+            if (h->handler == cp) {
+                cur = h->depth + 1;
+                if (cur > high) {
+                    high = cur;
+                }
+            }
+        }
+
+        cur += compile_code_stack_change(code, p1);
+        if (cur < 0) {
+            //means bug, should be assert here.
+            cpl->error = ERR_SysError;
+            return;
+        }
+        if (cur > high) {
+            high = cur;
+        }
+
+        if (depth && compile_code_is_jmp(code)) {
+            int target = off + p1;
+            int at = compile_code_is_loop_jmp(code) ? cur - 1 : cur;
+
+            if (target >= 0 && target < fn->code_num && depth[target] < at) {
+                depth[target] = at;
+            }
+        }
+        last = code;
+    }
+
+    fn->stack_space = cur;
+    fn->stack_high = high;
+}
+
+/****************************************************************
+ *                    Number type inference
+ *
+ * Interpret the code of function abstractly, track which local
+ * variables and stack slots must hold a number. The arithmetic and
+ * compare instructions, whose operands are proved to be number, are
+ * replaced by the number specialised one (BC_XXX_NN).
+ *
+ *   - only the variables of function self (generation 0) are tracked
+ *   - all variables are unknown at entry (argument, history of main)
+ *   - call may modify the variables, if they are captured by closure
+ *   - state of jump target is the join of all its incoming edges,
+ *     and the walk is repeated until the states are stable
+ *   - handler of try block is joined at the begin of block, with all
+ *     variables unknown, see compile_type_handler
+ *
+ * If anything unexpected, the code is keep unchanged.
+ ***************************************************************/
+#define TYPE_ANY        0
+#define TYPE_NUM        1
+#define TYPE_REF        2       // reference of some tracked variable
+#define TYPE_REF_VAR    0x80    // reference of tracked variable: TYPE_REF_VAR | id
+
+#define TYPE_VAR_MAX    32
+#define TYPE_ROUND_MAX  32
+
+typedef struct compile_type_state_t {
+    uint32_t num;       // bitmap of variables hold number
+    int16_t  sp;        // depth of stack, -1 means not reached
+    int16_t  reserved;
+} compile_type_state_t;
+
+typedef struct compile_type_t {
+    int       size;
+    int       high;
+    int       state_size;
+    int       closure;
+    int       try_num;
+    compile_try_t *try_buf;
+    uint8_t  *code;
+    uint16_t *index;    // index of target state + 1, 0 means not jump target
+    uint8_t  *states;
+    compile_type_state_t *cur;
+} compile_type_t;
+
+static inline compile_type_state_t *compile_type_state(compile_type_t *t, int i) {
+    return (compile_type_state_t *) (t->states + t->state_size * i);
+}
+
+static inline uint8_t *compile_type_slot(compile_type_state_t *s) {
+    return (uint8_t *) (s + 1);
+}
+
+static inline int compile_type_is_ref(uint8_t type) {
+    return type == TYPE_REF || (type & TYPE_REF_VAR);
+}
+
+static inline int compile_code_is_arith(uint8_t code) {
+    return code >= BC_MUL && code <= BC_AXOR;
+}
+
+static inline int compile_code_is_compare(uint8_t code) {
+    return code >= BC_TEQ && code <= BC_TLE;
+}
+
+static inline uint8_t compile_code_generic(uint8_t code) {
+    if (code >= BC_MUL_NN && code <= BC_TLE_NN) {
+        return code - BC_MUL_NN + BC_MUL;
+    }
+    if (code == BC_ADD_ASSIGN_NN) {
+        return BC_ADD_ASSIGN;
+    }
+    if (code == BC_SUB_ASSIGN_NN) {
+        return BC_SUB_ASSIGN;
+    }
+    if (code == BC_ADD_STORE_VAR_NN) {
+        return BC_ADD_STORE_VAR;
+    }
+    if (code == BC_SUB_STORE_VAR_NN) {
+        return BC_SUB_STORE_VAR;
+    }
+    return code;
+}
+
+/*
+ * Join state s with current state, return 1 if s changed, -1 if conflict
+ */
+static int compile_type_join(compile_type_t *t, compile_type_state_t *s)
+{
+    compile_type_state_t *cur = t->cur;
+    uint8_t *dst, *src;
+    int i, changed = 0;
+
+    if (s->sp < 0) {
+        memcpy(s, cur, t->state_size);
+        return 1;
+    }
+
+    if (s->sp != cur->sp) {
+        return -1;
+    }
+
+    if ((s->num & cur->num) != s->num) {
+        s->num &= cur->num;
+        changed = 1;
+    }
+
+    dst = compile_type_slot(s);
+    src = compile_type_slot(cur);
+    for (i = 0; i < s->sp; i++) {
+        if (dst[i] != src[i]) {
+            uint8_t type = (compile_type_is_ref(dst[i]) || compile_type_is_ref(src[i])) ? TYPE_REF : TYPE_ANY;
+
+            if (dst[i] != type) {
+                dst[i] = type;
+                changed = 1;
+            }
+        }
+    }
+
+    return changed;
+}
+
+static int compile_type_assign(compile_type_t *t, int pos, uint8_t code, uint8_t ref, uint8_t val, int rewrite)
+{
+    compile_type_state_t *cur = t->cur;
+    uint32_t bit;
+    int is_num;
+
+    if (ref == TYPE_REF) {
+        cur->num = 0;
+    }
+
+    if (!(ref & TYPE_REF_VAR)) {
+        return (code == BC_ASSIGN || code == BC_STORE_VAR) ? val : TYPE_ANY;
+    }
+
+    bit = 1u << (ref & (TYPE_VAR_MAX - 1));
+    is_num = (cur->num & bit) && val == TYPE_NUM;
+
+    switch (code) {
+    case BC_ASSIGN:
+    case BC_STORE_VAR:
+    case BC_STORE_VAR_POP:  is_num = val == TYPE_NUM; break;
+    case BC_ADD_ASSIGN:     if (is_num && rewrite) t->code[pos] = BC_ADD_ASSIGN_NN; break;
+    case BC_SUB_ASSIGN:     if (is_num && rewrite) t->code[pos] = BC_SUB_ASSIGN_NN; break;
+    case BC_ADD_STORE_VAR:  if (is_num && rewrite) t->code[pos] = BC_ADD_STORE_VAR_NN; break;
+    case BC_SUB_STORE_VAR:  if (is_num && rewrite) t->code[pos] = BC_SUB_STORE_VAR_NN; break;
+    case BC_MUL_ASSIGN:
+    case BC_AND_ASSIGN:
+    case BC_OR_ASSIGN:
+    case BC_XOR_ASSIGN:
+    case BC_LSHIFT_ASSIGN:
+    case BC_RSHIFT_ASSIGN:  break;
+    default:                is_num = 0; // division may produce NaN
+    }
+
+    if (is_num) {
+        cur->num |= bit;
+        return TYPE_NUM;
+    } else {
+        cur->num &= ~bit;
+        return TYPE_ANY;
+    }
+}
+
+/*
+ * Apply instruction on current state, rewrite it if possible
+ */
+static int compile_type_step(compile_type_t *t, int pos, uint8_t code, int p1, int p2, int rewrite)
+{
+    compile_type_state_t *cur = t->cur;
+    uint8_t *slot = compile_type_slot(cur);
+    int sp = cur->sp;
+    int pop = 0, push = 1;
+    uint8_t a, b, out = TYPE_ANY;
+
+    code = compile_code_generic(code);
+    switch (code) {
+    case BC_STOP:
+    case BC_PASS:
+    case BC_RET0:
+    case BC_JMP:
+    case BC_SJMP:
+    case BC_JMP_T:
+    case BC_SJMP_T:
+    case BC_JMP_F:
+    case BC_SJMP_F:
+    case BC_CASE_JMP:       push = 0; break;
+
+    case BC_RET:
+    case BC_THROW:
+    case BC_GEN_RET:
+    case BC_POP:
+    case BC_POP_JMP_T:
+    case BC_POP_SJMP_T:
+    case BC_POP_JMP_F:
+    case BC_POP_SJMP_F:
+    case BC_SWITCH_TABLE:
+    case BC_SWITCH_NUM:
+    case BC_SWITCH_STR:     pop = 1; push = 0; break;
+
+    case BC_PUSH_ZERO:
+    case BC_PUSH_NUM:
+    case BC_FOR_RANGE_JMP:
+    case BC_FOR_RANGE_SJMP: out = TYPE_NUM; break;
+    case BC_FOR_EACH_JMP:
+    case BC_FOR_EACH_SJMP:  break;
+    case BC_PUSH_VAR:       if (p2 == 0 && p1 < TYPE_VAR_MAX && (cur->num & (1u << p1))) {
+                                out = TYPE_NUM;
+                            }
                             break;
-        case BC_PROP:       compile_func_stack_pop(cpl, fn);
+    case BC_PUSH_REF:       if (p2 == 0 && p1 < TYPE_VAR_MAX) {
+                                out = TYPE_REF_VAR | p1;
+                            }
                             break;
-        case BC_PROP_METH:  compile_func_stack_pop(cpl, fn);
+    case BC_PUSH_UND:
+    case BC_PUSH_NAN:
+    case BC_PUSH_TRUE:
+    case BC_PUSH_FALSE:
+    case BC_PUSH_STR:
+    case BC_PUSH_SCRIPT:
+    case BC_PUSH_NATIVE:
+    case BC_PUSH_CLOSURE:
+    case BC_PUSH_CELL:
+    case BC_GEN_START:
+    case BC_ASYNC:          break;
+
+    case BC_BOX_VAR:        return 0;
+
+    // boxed variable is not traced
+    case BC_STORE_CELL:     if (sp < 1) return -1;
+                            return 0;
+    case BC_STORE_CELL_POP:
+    case BC_ADD_STORE_CELL:
+    case BC_SUB_STORE_CELL: pop = 1; push = 0; break;
+
+    case BC_NEG:
+    case BC_NOT:            if (sp < 1) return -1;
+                            slot[sp - 1] = slot[sp - 1] == TYPE_NUM ? TYPE_NUM : TYPE_ANY;
+                            return 0;
+
+    case BC_LOGIC_NOT:      if (sp < 1) return -1;
+                            slot[sp - 1] = TYPE_ANY;
+                            return 0;
+
+    case BC_PROP_METH:
+    case BC_ELEM_METH:      if (sp < 2) return -1;
+                            slot[sp - 1] = slot[sp - 2] = TYPE_ANY;
+                            return 0;
+
+    case BC_TIN:
+    case BC_PROP:
+    case BC_ELEM:           pop = 2; break;
+
+    case BC_FUNC_CALL:
+    case BC_TAIL_CALL:
+    case BC_CALL0:
+    case BC_CALL1:
+    case BC_CALL2:
+    case BC_CALL3:          pop = p1 + 1;
+                            if (t->closure) {
+                                cur->num = 0;
+                            }
                             break;
-        case BC_ELEM:       compile_func_stack_pop(cpl, fn);
+
+    case BC_ARRAY:
+    case BC_DICT:           pop = p1; break;
+
+    // closure of generator may run, until it is resumed
+    case BC_YIELD:          pop = 1; push = 0;
+                            if (t->closure) {
+                                cur->num = 0;
+                            }
                             break;
-        case BC_ELEM_METH:  compile_func_stack_pop(cpl, fn);
+    case BC_AWAIT:          pop = 1;
+                            if (t->closure) {
+                                cur->num = 0;
+                            }
                             break;
-        default:            cpl->error = ERR_InvalidByteCode;
+
+    case BC_STORE_VAR:
+    case BC_STORE_VAR_POP:
+    case BC_ADD_STORE_VAR:
+    case BC_SUB_STORE_VAR:  if (sp < 1) return -1;
+                            a = (p2 == 0 && p1 < TYPE_VAR_MAX) ? TYPE_REF_VAR | p1 : TYPE_ANY;
+                            out = compile_type_assign(t, pos, code, a, slot[sp - 1], rewrite);
+                            pop = 1;
+                            push = code == BC_STORE_VAR;
                             break;
+
+    default:
+        if (compile_code_is_cmp_jmp(code)) {
+            pop = 2;
+            push = 0;
+        } else
+        if (compile_code_is_arith(code) || compile_code_is_compare(code)) {
+            if (sp < 2) return -1;
+            a = slot[sp - 2];
+            b = slot[sp - 1];
+            pop = 2;
+            if (a == TYPE_NUM && b == TYPE_NUM) {
+                if (rewrite) {
+                    t->code[pos] = code - BC_MUL + BC_MUL_NN;
+                }
+                // Note: division by zero give NaN
+                if (compile_code_is_arith(code) && code != BC_DIV && code != BC_MOD) {
+                    out = TYPE_NUM;
+                }
+            }
+        } else
+        if (code >= BC_ASSIGN && code <= BC_RSHIFT_ASSIGN) {
+            if (sp < 2) return -1;
+            a = slot[sp - 2];
+            b = slot[sp - 1];
+            pop = 2;
+            out = compile_type_assign(t, pos, code, a, b, rewrite);
+        } else
+        if (code >= BC_PROP_ASSIGN && code <= BC_ELEM_RSHIFT_ASSIGN) {
+            if (sp < 3) return -1;
+            pop = 3;
+            if (code == BC_PROP_ASSIGN || code == BC_ELEM_ASSIGN) {
+                out = slot[sp - 1];
+            }
+        } else {
+            return -1;
         }
     }
 
+    if (sp < pop || sp - pop + push > t->high) {
+        return -1;
+    }
+    sp -= pop;
+    if (push) {
+        slot[sp++] = out;
+    }
+    cur->sp = sp;
+
     return 0;
 }
 
+/*
+ * Handler could be entered from any instruction of try block, the stack
+ * is restored to the depth of begin, and the error value pushed.
+ */
+static int compile_type_handler(compile_type_t *t, compile_try_t *h)
+{
+    compile_type_state_t *cur = t->cur;
+    uint32_t num = cur->num;
+    int ret;
+
+    if (cur->sp >= t->high) {
+        return -1;
+    }
+
+    compile_type_slot(cur)[cur->sp++] = TYPE_ANY;
+    cur->num = 0;
+    ret = compile_type_join(t, compile_type_state(t, t->index[h->handler] - 1));
+    cur->num = num;
+    cur->sp--;
+
+    return ret;
+}
+
+/*
+ * Walk through the code, return 1 if any target state changed, -1 if failed
+ */
+static int compile_type_walk(compile_type_t *t, int rewrite)
+{
+    int pos = 0, live = 1, changed = 0;
+
+    t->cur->num = 0;
+    t->cur->sp = 0;
+    while (pos < t->size) {
+        const char *name;
+        int p1 = 0, p2 = 0, next = pos, ret;
+        uint8_t code = t->code[pos];
+
+        if (t->index[pos]) {
+            compile_type_state_t *s = compile_type_state(t, t->index[pos] - 1);
+
+            if (live) {
+                if ((ret = compile_type_join(t, s)) < 0) {
+                    return -1;
+                }
+                changed |= ret;
+            }
+
+            if (s->sp < 0) {
+                live = 0;
+            } else {
+                memcpy(t->cur, s, t->state_size);
+                live = 1;
+            }
+        }
+
+        bcode_parse(t->code, &next, &name, &p1, &p2);
+        if (live) {
+            int i;
+
+            for (i = 0; i < t->try_num; i++) {
+                if (t->try_buf[i].bgn == pos) {
+                    if ((ret = compile_type_handler(t, t->try_buf + i)) < 0) {
+                        return -1;
+                    }
+                    changed |= ret;
+                }
+            }
+
+            // loop jump out before the value pushed
+            if (compile_code_is_loop_jmp(code)) {
+                if ((ret = compile_type_join(t, compile_type_state(t, t->index[next + p1] - 1))) < 0) {
+                    return -1;
+                }
+                changed |= ret;
+            }
+
+            if (compile_type_step(t, pos, code, p1, p2, rewrite)) {
+                return -1;
+            }
+
+            if (compile_code_is_jmp(code) && !compile_code_is_loop_jmp(code)) {
+                if ((ret = compile_type_join(t, compile_type_state(t, t->index[next + p1] - 1))) < 0) {
+                    return -1;
+                }
+                changed |= ret;
+            }
+
+            live = !compile_code_is_terminal(compile_code_jmp_long(code));
+        }
+        pos = next;
+    }
+
+    return changed;
+}
+
+static void compile_code_specialize(compile_t *cpl, int func_id)
+{
+    compile_func_t *fn;
+    compile_type_t t;
+    uint8_t *scratch;
+    int pos, jmp_num, round;
+
+    fn = cpl->func_buf + func_id;
+    if (cpl->error || fn->code_num < 1) {
+        return;
+    }
+
+    // count the jumps, for memory of target states
+    pos = jmp_num = 0;
+    while (pos < fn->code_num) {
+        const char *name;
+        int p1, p2, cp = pos;
+
+        bcode_parse(fn->code_buf, &pos, &name, &p1, &p2);
+        if (compile_code_is_jmp(fn->code_buf[cp])) {
+            if (pos + p1 < 0 || pos + p1 >= fn->code_num) {
+                return;
+            }
+            jmp_num++;
+        }
+    }
+    jmp_num += fn->try_num;
+
+    t.size  = fn->code_num;
+    t.high  = fn->stack_high;
+    t.state_size = sizeof(compile_type_state_t) + SIZE_ALIGN_4(t.high);
+    // Note: main function may be modified by function of other compile
+    t.closure = fn->closure || func_id == 0;
+
+    scratch = compile_scratch(cpl, SIZE_ALIGN_4(t.size * 2) + t.state_size * (jmp_num + 1));
+    if (!scratch) {
+        return;
+    }
+    fn = cpl->func_buf + func_id;
+
+    t.try_num = fn->try_num;
+    t.try_buf = compile_func_try(cpl, func_id);
+    t.code   = fn->code_buf;
+    t.index  = (uint16_t *) scratch;
+    t.cur    = (compile_type_state_t *) (scratch + SIZE_ALIGN_4(t.size * 2));
+    t.states = scratch + SIZE_ALIGN_4(t.size * 2) + t.state_size;
+
+    // alloc state for each jump target
+    memset(t.index, 0, t.size * 2);
+    pos = jmp_num = 0;
+    while (pos < t.size) {
+        const char *name;
+        int p1, p2, cp = pos;
+
+        bcode_parse(t.code, &pos, &name, &p1, &p2);
+        if (compile_code_is_jmp(t.code[cp]) && !t.index[pos + p1]) {
+            compile_type_state(&t, jmp_num)->sp = -1;
+            t.index[pos + p1] = ++jmp_num;
+        }
+    }
+    for (pos = 0; pos < t.try_num; pos++) {
+        int handler = t.try_buf[pos].handler;
+
+        if (handler >= t.size) {
+            return;
+        }
+        if (!t.index[handler]) {
+            compile_type_state(&t, jmp_num)->sp = -1;
+            t.index[handler] = ++jmp_num;
+        }
+    }
+
+    for (round = 0; round < TYPE_ROUND_MAX; round++) {
+        int changed = compile_type_walk(&t, 0);
+
+        if (changed < 0) {
+            return;
+        }
+        if (!changed) {
+            compile_type_walk(&t, 1);
+            return;
+        }
+    }
+}
+
+/*
+ * Append the handler table to code, see executable.h
+ */
+static void compile_code_handler(compile_t *cpl, int func_id)
+{
+    compile_func_t *fn;
+    compile_try_t *handlers;
+    uint8_t *code;
+    int i, n, cur;
+
+    n = cpl->func_buf[func_id].try_num;
+    if (cpl->error || n < 1) {
+        return;
+    }
+
+    cur = cpl->func_cur;
+    cpl->func_cur = func_id;
+    if (0 == compile_code_extend(cpl, n * FUNC_HANDLER_SIZE + 2)) {
+        fn = cpl->func_buf + func_id;
+        code = fn->code_buf + fn->code_num - (n * FUNC_HANDLER_SIZE + 2);
+        handlers = compile_func_try(cpl, func_id);
+        for (i = 0; i < n; i++, code += FUNC_HANDLER_SIZE) {
+            compile_try_t *h = handlers + i;
+
+            code[0] = h->bgn >> 8;      code[1] = h->bgn;
+            code[2] = h->end >> 8;      code[3] = h->end;
+            code[4] = h->handler >> 8;  code[5] = h->handler;
+            code[6] = h->depth >> 8;    code[7] = h->depth;
+        }
+        code[0] = n >> 8;
+        code[1] = n;
+    }
+    cpl->func_cur = cur;
+}
+
+static inline int compile_func_flags(compile_func_t *fn) {
+    return (fn->closure ? FUNC_FL_CLOSURE : 0) | (fn->try_num ? FUNC_FL_HANDLER : 0);
+}
+
+static int compile_code_finish(compile_t *cpl)
+{
+    int i;
+
+    compile_try_group(cpl);
+    for (i = 0; i < cpl->func_num && !cpl->error; i++) {
+        compile_code_optimize(cpl, i);
+        compile_code_revise(cpl, i);
+        compile_code_specialize(cpl, i);
+        compile_code_handler(cpl, i);
+    }
+
+    return cpl->error ? -1 : 0;
+}
+
 static int compile_code_relocate(compile_t *cpl)
 {
     executable_t   *exe;
@@ -1528,12 +3723,12 @@ static int compile_code_relocate(compile_t *cpl)
         return -1;
     }
 
-    exe = &cpl->env->exe;
-    for (i = 0; i < cpl->func_num; i++) {
-        cfp = cpl->func_buf + i;
-        compile_code_revise(cpl, cfp);
+    if (0 != compile_code_finish(cpl)) {
+        return -1;
     }
 
+    exe = &cpl->env->exe;
+
     /*
      * Main entry function relocation
      */
@@ -1549,7 +3744,7 @@ static int compile_code_relocate(compile_t *cpl)
 
     exe->func_map[0] = exe->main_code + exe->main_code_end;
     executable_func_set_head(exe->main_code + exe->main_code_end,
-            cfp->var_num, cfp->arg_num, cfp->code_num, cfp->stack_high, cfp->closure);
+            cfp->var_num, cfp->arg_num, cfp->code_num, cfp->stack_high, compile_func_flags(cfp));
     memcpy(exe->main_code + exe->main_code_end + FUNC_HEAD_SIZE, cfp->code_buf, cfp->code_num);
     exe->main_code_end += FUNC_HEAD_SIZE + cfp->code_num;
     if (exe->func_num == 0) {
@@ -1569,7 +3764,7 @@ static int compile_code_relocate(compile_t *cpl)
 
         exe->func_map[exe->func_num++] = exe->func_code + exe->func_code_end;
         executable_func_set_head(exe->func_code + exe->func_code_end,
-                cfp->var_num, cfp->arg_num, cfp->code_num, cfp->stack_high, cfp->closure);
+                cfp->var_num, cfp->arg_num, cfp->code_num, cfp->stack_high, compile_func_flags(cfp));
         memcpy(exe->func_code + exe->func_code_end + FUNC_HEAD_SIZE, cfp->code_buf, cfp->code_num);
         exe->func_code_end += FUNC_HEAD_SIZE + cfp->code_num;
     }
@@ -1657,7 +3852,7 @@ static int compile_map_image(compile_t *cpl, void *mem_ptr, int mem_size)
 
     for (i = 0; i < cpl->func_num; i++) {
         if (image_fill_code(&image, i, cpl->func_buf[i].var_num, cpl->func_buf[i].arg_num,
-                cpl->func_buf[i].stack_high, cpl->func_buf[i].closure,
+                cpl->func_buf[i].stack_high, compile_func_flags(cpl->func_buf + i),
                 cpl->func_buf[i].code_buf, cpl->func_buf[i].code_num)) {
             return -1;
         }
@@ -1686,7 +3881,7 @@ int compile_exe(env_t *env, const char *input, void *mem_ptr, int mem_size)
 
     compile_init(&cpl, env, heap_free_addr(&psr.heap), heap_free_size(&psr.heap));
 
-    if (0 != compile_multi_stmt(&cpl, stmt)) {
+    if (0 != compile_multi_stmt(&cpl, stmt) || 0 != compile_code_finish(&cpl)) {
         return -cpl.error;
     }
 
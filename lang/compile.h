@@ -33,6 +33,14 @@ SOFTWARE.
 #include "interp.h"
 #include "function.h"
 
+typedef struct compile_try_t {
+    uint16_t func;              // owner function
+    uint16_t bgn;               // guarded code: [bgn, end)
+    uint16_t end;
+    uint16_t handler;
+    uint16_t depth;             // stack depth at bgn
+} compile_try_t;
+
 typedef struct compile_func_t {
     int16_t owner;
     uint16_t stack_space;
@@ -43,6 +51,10 @@ typedef struct compile_func_t {
     uint8_t var_num;
     uint8_t arg_num;
 
+    uint8_t upv_num;            // variables captured from owner, in tail of var_map
+
+    uint8_t try_num;            // handlers, in compile_t.try_buf
+
     uint16_t code_max;
     uint16_t code_num;
     uint8_t  *code_buf;
@@ -60,10 +72,16 @@ typedef struct compile_t {
     uint16_t func_cur;
     uint16_t func_offset;
 
+    uint16_t try_max;
+    uint16_t try_num;
+    uint8_t  try_nest;  // try block of current function, no tail call
+    uint8_t  generator; // BC_GEN_START or BC_ASYNC of current function, or 0
+
     env_t  *env;
     heap_t  heap;
 
     compile_func_t *func_buf;
+    compile_try_t  *try_buf;    // handlers of all functions, see compile_stmt_try
 } compile_t;
 
 int compile_init(compile_t *cpl, env_t *env, void *heap_ptr, int heap_size);
@@ -32,6 +32,7 @@ SOFTWARE.
 #include <inttypes.h>
 #include <sys/types.h>
 #include <sys/param.h>
+#include <stdatomic.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -76,13 +77,18 @@ SOFTWARE.
 # define DEF_FUNC_SIZE              (4)
 # define DEF_VMAP_SIZE              (4)
 # define DEF_FUNC_CODE_SIZE         (32)
+# define DEF_TRY_SIZE               (4)
 
 # define LIMIT_VMAP_SIZE            (32)    // max variable number in function
 # define LIMIT_FUNC_SIZE            (32767) // max function number in  module
 # define LIMIT_FUNC_CODE_SIZE       (32767) // max code of each function
+# define LIMIT_FUNC_TRY_SIZE        (255)   // max try statement of each function
+# define LIMIT_TRY_SIZE             (4096)  // max try statement in module
 
 # define DEF_STRING_SIZE            (8)
 
+# define DEF_PROP_CACHE_SIZE        (8)     // property cache of interpreter, power of 2
+
 // lang compile resource default and limit
 
 #endif /* __CUPKEE_CONFIG__ */
@@ -26,18 +26,61 @@ SOFTWARE.
 #include "object.h"
 #include "string.h"
 #include "array.h"
+#include "buffer.h"
+#include "map.h"
+#include "generator.h"
+#include "future.h"
 #include "function.h"
 
 #define VACATED     (-1)
-#define FRAME_SIZE  (sizeof(frame_t) / sizeof(val_t))
+#define FRAME_SIZE  ((sizeof(frame_t) + sizeof(val_t) - 1) / sizeof(val_t))
 
+/*
+ * Frame is under the arguments of callee, the stack pointer of caller
+ * is not saved, it is always just above the frame.
+ */
 typedef struct frame_t {
     int fp;
-    int sp;
     intptr_t pc;
     intptr_t scope;
 } frame_t;
 
+#define MAGIC_HANDLE        (MAGIC_BASE + 23)
+#define HANDLE_TABLE_MIN    8
+#define HANDLE_TABLE_MAX    0xFFFF
+#define HANDLE_GENERATION_MAX 0xFFFF
+
+/*
+ * Handle is index of slot + 1, with the generation of slot in the high 16
+ * bits. Slot released is linked in the free list, with the generation
+ * bumped, so the handle of it is stale. Slot is retired instead, when its
+ * generation would wrap.
+ */
+typedef struct handle_slot_t {
+    val_t    value;
+    uint16_t generation;
+    uint16_t used;
+    int32_t  next;                      // next free slot, or -1
+} handle_slot_t;
+
+// Table in heap, replaced by the doubled one when it's full
+typedef struct handle_table_t {
+    uint8_t  magic;
+    uint8_t  age;
+    uint16_t reserved;
+    int32_t  size;                      // slots allocated
+    int32_t  end;                       // slots had be used
+    int32_t  free;                      // first free slot, or -1
+} handle_table_t;
+
+static inline handle_slot_t *handle_slots(handle_table_t *t) {
+    return (handle_slot_t *)(t + 1);
+}
+
+static inline int handle_table_mem_space(handle_table_t *t) {
+    return SIZE_ALIGN(sizeof(handle_table_t) + sizeof(handle_slot_t) * t->size);
+}
+
 static uint32_t hash_pjw(const void *key)
 {
     const char *ptr = key;
@@ -178,9 +221,10 @@ int env_exe_memery_calc(int size, int *num_max, int *str_max, int *fn_max, int *
     }
 
     if (fn_max) {
-        // 1/32 of function entry space
+        // 1/32 of function entry space, and the static function objects
         fent_space = SIZE_ALIGN_8(size / 32);
         *fn_max = fent_space / sizeof(intptr_t);
+        fent_space += SIZE_ALIGN_8(*fn_max * sizeof(function_t));
     } else {
         fent_space = 0;
     }
@@ -212,6 +256,14 @@ int env_init(env_t *env, void *mem_ptr, int mem_size,
     int half_size, exe_size, symbal_tbl_size;
 
     env->error = 0;
+    val_set_undefined(&env->except);
+    env->nest = 0;
+    atomic_init(&env->interrupt, 0);
+    env->budget = 0;
+    env->budget_slice = 0;
+    env->resume = NULL;
+    env->ready = NULL;
+    env->ready_tail = NULL;
 
     // stack init
     if (!stack_ptr) {
@@ -262,6 +314,11 @@ int env_init(env_t *env, void *mem_ptr, int mem_size,
     // reference init
     env->ref_num = 0;
     env->ref_ent = NULL;
+    env->handles = NULL;
+
+    // quickening init
+    env->quicken = 1;
+    memset(env->prop_cache, 0, sizeof(env->prop_cache));
 
     // static memory init
     exe_size = executable_init(&env->exe, mem_ptr + mem_offset, mem_size - mem_offset,
@@ -315,29 +372,13 @@ int env_deinit(env_t *env)
     return 0;
 }
 
-scope_t *env_scope_create(env_t *env, scope_t *super, uint8_t *entry, int ac, val_t *av)
+/*
+ * Fill variables of scope with arguments: named arguments first,
+ * then the other variables, and the nonamed arguments at last.
+ */
+static void env_scope_fill(val_t *buf, int vn, int an, int ac, val_t *av)
 {
-    scope_t *scope;
-    val_t   *buf;
-    int vn, an, vc;
-    int i, d;
-
-    if (entry) {
-        vn = executable_func_get_var_cnt(entry);
-        an = executable_func_get_arg_cnt(entry);
-    } else {
-        vn = INTERACTIVE_VAR_MAX;
-        an = 0;
-    }
-
-    d = ac - an;
-    vc = vn + (d > 0 ? d : 0);
-    scope = (scope_t *) env_heap_alloc(env, sizeof(scope_t) + sizeof(val_t) * vc);
-    if (!scope) {
-        env_set_error(env, ERR_NotEnoughMemory);
-        return NULL;
-    }
-    buf = (val_t *) (scope + 1);
+    int i, d = ac - an;
 
     if (d < 0) {
         for (i = 0; i < ac; i++) {
@@ -355,6 +396,23 @@ scope_t *env_scope_create(env_t *env, scope_t *super, uint8_t *entry, int ac, va
     for (i = 0; i < d; i++) {
         buf[vn + i] = av[an + i];
     }
+}
+
+static scope_t *env_scope_new(env_t *env, scope_t *super, int vn, int an, int ac, val_t *av)
+{
+    scope_t *scope;
+    val_t   *buf;
+    int vc, d;
+
+    d = ac - an;
+    vc = vn + (d > 0 ? d : 0);
+    scope = (scope_t *) env_heap_alloc(env, sizeof(scope_t) + sizeof(val_t) * vc);
+    if (!scope) {
+        env_set_error(env, ERR_NotEnoughMemory);
+        return NULL;
+    }
+    buf = (val_t *) (scope + 1);
+    env_scope_fill(buf, vn, an, ac, av);
 
     scope->magic = MAGIC_SCOPE;
     scope->age = 0;
@@ -366,6 +424,40 @@ scope_t *env_scope_create(env_t *env, scope_t *super, uint8_t *entry, int ac, va
     return scope;
 }
 
+scope_t *env_scope_create(env_t *env, scope_t *super, uint8_t *entry, int ac, val_t *av)
+{
+    if (entry) {
+        return env_scope_new(env, super, executable_func_get_var_cnt(entry),
+                             executable_func_get_arg_cnt(entry), ac, av);
+    } else {
+        return env_scope_new(env, super, INTERACTIVE_VAR_MAX, 0, ac, av);
+    }
+}
+
+scope_t *env_scope_alloc(env_t *env, scope_t *super, int num)
+{
+    scope_t *scope;
+    int i;
+
+    scope = (scope_t *) env_heap_alloc(env, sizeof(scope_t) + sizeof(val_t) * num);
+    if (!scope) {
+        env_set_error(env, ERR_NotEnoughMemory);
+        return NULL;
+    }
+
+    scope->magic = MAGIC_SCOPE;
+    scope->age = 0;
+    scope->num = num;
+    scope->nao = num;
+    scope->super = super;
+    scope->var_buf = (val_t *) (scope + 1);
+    for (i = 0; i < num; i++) {
+        val_set_undefined(scope->var_buf + i);
+    }
+
+    return scope;
+}
+
 int env_scope_set(env_t *env, int id, val_t *v) {
     if (env && env->scope && id >= 0 && id < env->scope->num) {
         env->scope->var_buf[id] = *v;
@@ -382,6 +474,10 @@ int env_scope_get(env_t *env, int id, val_t **v) {
     return -1;
 }
 
+/*
+ * return: code of callee, or pc of caller if error, the error is raised
+ * by the call instruction.
+ */
 const uint8_t *env_frame_setup(env_t *env, const uint8_t *pc, val_t *fv, int ac, val_t *av)
 {
     function_t *fn = (function_t *)val_2_intptr(fv);
@@ -390,43 +486,112 @@ const uint8_t *env_frame_setup(env_t *env, const uint8_t *pc, val_t *fv, int ac,
     int fp;
 
     // empty function
-    if (function_size(fn) == 0) {
+    if (function_is_empty(fn)) {
         env->sp += ac + 1; // release arguments & fobj in stack
         *env_stack_push(env) = val_mk_undefined();
         return pc;
     }
 
-    if (NULL == (scope = env_scope_create(env, fn->super, fn->entry, ac, av))) {
+    // frame is below the arguments & function
+    fp = env->sp + ac + 1 - FRAME_SIZE;
+    if (fp < function_stack_high(fn)) {
+        env->error = ERR_StackOverflow;
+        return pc;
+    }
+
+    if (NULL == (scope = env_scope_new(env, NULL, fn->varc, fn->argc, ac, av))) {
         // error had be set in
-        return NULL;
+        return pc;
+    }
+    // Note: function may be moved by gc, in alloc
+    fn = (function_t *)val_2_intptr(fv);
+    scope->super = fn->super;
+
+    frame = (frame_t *)(env->sb + fp);
+    frame->fp = env->fp;
+    frame->pc = (intptr_t) pc;
+    frame->scope = (intptr_t) env->scope;
+
+    env->fp = fp;
+    env->sp = fp;
+    env->scope = scope;
+
+    return function_code(fn);
+}
+
+/*
+ * Call in return position: the frame of caller is reused by callee,
+ * the callee returns to the caller of caller directly.
+ * The scope of caller is reused too, if it is big enough, it is not
+ * referred by others: closure captures variables into its own scope.
+ */
+const uint8_t *env_frame_tail(env_t *env, const uint8_t *pc, val_t *fv, int ac, val_t *av)
+{
+    function_t *fn = (function_t *)val_2_intptr(fv);
+    scope_t *scope = env->scope;
+    int vn, an, d, vc;
+
+    // not in function, or empty function
+    if (env->fp == env->ss || function_is_empty(fn)) {
+        return env_frame_setup(env, pc, fv, ac, av);
+    }
+
+    if (env->fp < function_stack_high(fn)) {
+        env->error = ERR_StackOverflow;
+        return pc;
     }
 
-    if (!env_is_valid_ptr(env, fn)) {
-        // GC happend? super should be update
-        fn = (function_t *)val_2_intptr(fv); // fv had update, by gc
+    vn = function_varc(fn);
+    an = function_argc(fn);
+    d = ac - an;
+    vc = vn + (d > 0 ? d : 0);
+    if (vc <= scope->num) {
+        env_scope_fill(scope->var_buf, vn, an, ac, av);
+        scope->num = vc;
+        scope->nao = vn;
+        scope->super = fn->super;
+    } else {
+        if (NULL == (scope = env_scope_new(env, NULL, vn, an, ac, av))) {
+            // error had be set in
+            return pc;
+        }
+        // Note: function may be moved by gc, in alloc
+        fn = (function_t *)val_2_intptr(fv);
         scope->super = fn->super;
     }
 
-    //skip arguments & function
-    env->sp += ac + 1;
-    fp = env->sp - FRAME_SIZE;
-    if (fp < 0 || fp < function_stack_high(fn)) {
+    // release the stack of caller, and keep the frame
+    env->sp = env->fp;
+    env->scope = scope;
+
+    return function_code(fn);
+}
+
+/*
+ * Continuation of native function: the frame is built in place of the
+ * arguments & function, scope of caller is kept. The native loop keeps
+ * its state in stack above the frame, and return to caller by restore.
+ */
+int env_frame_native(env_t *env, const uint8_t *pc, int ac, int high)
+{
+    frame_t *frame;
+    int fp;
+
+    fp = env->sp + ac + 1 - FRAME_SIZE;
+    if (fp < high) {
         env->error = ERR_StackOverflow;
-        return NULL;
+        return -1;
     }
 
-    //printf ("############  resave sp: %d, fp: %d\n", env->sp, env->fp);
     frame = (frame_t *)(env->sb + fp);
     frame->fp = env->fp;
-    frame->sp = env->sp;
     frame->pc = (intptr_t) pc;
     frame->scope = (intptr_t) env->scope;
 
     env->fp = fp;
     env->sp = fp;
-    env->scope = scope;
 
-    return function_code(fn);
+    return 0;
 }
 
 void env_frame_restore(env_t *env, const uint8_t **pc, scope_t **scope)
@@ -434,7 +599,7 @@ void env_frame_restore(env_t *env, const uint8_t **pc, scope_t **scope)
     if (env->fp != env->ss) {
         frame_t *frame = (frame_t *)(env->sb + env->fp);
 
-        env->sp = frame->sp;
+        env->sp = env->fp + FRAME_SIZE;
         env->fp = frame->fp;
         *pc = (uint8_t *) frame->pc;
         *scope = (scope_t *) frame->scope;
@@ -545,14 +710,90 @@ static array_t *heap_dup_array(heap_t *heap, array_t *a)
 
     //printf("%s: free %d\n", __func__, heap->free);
     memcpy(dup, a, sizeof(array_t));
-    memcpy(vals, array_values(a), sizeof(val_t) * array_length(a));
+    memcpy(vals, array_values(a), sizeof(val_t) * array_value_num(a));
     dup->elems = vals;
+    dup->elem_bgn = 0;
+    dup->elem_end = array_value_num(a);
 
     ADDR_VALUE(a) = dup;
 
     return dup;
 }
 
+static buffer_t *heap_dup_buffer(heap_t *heap, buffer_t *b)
+{
+    buffer_t *dup;
+
+    dup = heap_alloc(heap, buffer_mem_space(b));
+
+    // bytes is copied, if it is not a slice
+    memcpy(dup, b, buffer_mem_space(b));
+    if (!buffer_is_slice(b)) {
+        dup->base = dup;
+    }
+
+    ADDR_VALUE(b) = dup;
+
+    return dup;
+}
+
+static map_t *heap_dup_map(heap_t *heap, map_t *m)
+{
+    map_t *dup;
+    val_t *entries;
+
+    dup = heap_alloc(heap, map_mem_space(m));
+    entries = (val_t *)(dup + 1);
+
+    // index is rebuilt in scan, after keys are copied
+    memcpy(dup, m, sizeof(map_t));
+    memcpy(entries, m->entries, sizeof(val_t) * m->entry_end * map_entry_width(m));
+    dup->entries = entries;
+
+    ADDR_VALUE(m) = dup;
+
+    return dup;
+}
+
+static generator_t *heap_dup_generator(heap_t *heap, generator_t *g)
+{
+    generator_t *dup;
+
+    dup = heap_alloc(heap, generator_mem_space(g));
+
+    memcpy(dup, g, sizeof(generator_t) + sizeof(val_t) * g->stack_num);
+
+    ADDR_VALUE(g) = dup;
+
+    return dup;
+}
+
+static future_t *heap_dup_future(heap_t *heap, future_t *f)
+{
+    future_t *dup;
+
+    dup = heap_alloc(heap, future_mem_space(f));
+
+    memcpy(dup, f, sizeof(future_t));
+
+    ADDR_VALUE(f) = dup;
+
+    return dup;
+}
+
+static handle_table_t *heap_dup_handle_table(heap_t *heap, handle_table_t *t)
+{
+    handle_table_t *dup;
+
+    dup = heap_alloc(heap, handle_table_mem_space(t));
+
+    memcpy(dup, t, sizeof(handle_table_t) + sizeof(handle_slot_t) * t->end);
+
+    ADDR_VALUE(t) = dup;
+
+    return dup;
+}
+
 static intptr_t heap_dup_string(heap_t *heap, intptr_t str)
 {
     int size = string_mem_space(str);
@@ -629,6 +870,68 @@ static inline array_t *env_heap_copy_array(heap_t *heap, array_t *a)
     return heap_dup_array(heap, a);
 }
 
+static inline buffer_t *env_heap_copy_buffer(heap_t *heap, buffer_t *b)
+{
+    if (!b || heap_is_owned(heap, b)) {
+        return b;
+    }
+
+    if (MAGIC_BYTE(b) != MAGIC_BUFFER) {
+        return ADDR_VALUE(b);
+    }
+
+    return heap_dup_buffer(heap, b);
+}
+
+static inline map_t *env_heap_copy_map(heap_t *heap, map_t *m)
+{
+    if (!m || heap_is_owned(heap, m)) {
+        return m;
+    }
+
+    if (MAGIC_BYTE(m) != MAGIC_MAP) {
+        return ADDR_VALUE(m);
+    }
+
+    return heap_dup_map(heap, m);
+}
+
+static inline generator_t *env_heap_copy_generator(heap_t *heap, generator_t *g)
+{
+    if (!g || heap_is_owned(heap, g)) {
+        return g;
+    }
+
+    if (MAGIC_BYTE(g) != MAGIC_GENERATOR) {
+        return ADDR_VALUE(g);
+    }
+
+    return heap_dup_generator(heap, g);
+}
+
+static inline future_t *env_heap_copy_future(heap_t *heap, future_t *f)
+{
+    if (!f || heap_is_owned(heap, f)) {
+        return f;
+    }
+
+    if (MAGIC_BYTE(f) != MAGIC_FUTURE) {
+        return ADDR_VALUE(f);
+    }
+
+    return heap_dup_future(heap, f);
+}
+
+// generator or future, the magic is overwritten if it had be copied
+static inline intptr_t env_heap_copy_coroutine(heap_t *heap, intptr_t c)
+{
+    if (MAGIC_BYTE(c) == MAGIC_FUTURE) {
+        return (intptr_t) env_heap_copy_future(heap, (future_t *)c);
+    } else {
+        return (intptr_t) env_heap_copy_generator(heap, (generator_t *)c);
+    }
+}
+
 static intptr_t env_heap_copy_string(heap_t *heap, intptr_t str)
 {
     if (!str || heap_is_owned(heap, (void*)str)) {
@@ -649,7 +952,7 @@ static intptr_t env_heap_copy_string(heap_t *heap, intptr_t str)
 
 static intptr_t env_heap_copy_function(heap_t *heap, intptr_t func)
 {
-    if (!func || heap_is_owned(heap, (void *)func)) {
+    if (!func || MAGIC_BYTE(func) == MAGIC_FUNCTION_STATIC || heap_is_owned(heap, (void *)func)) {
         //printf("[fn is nil or owned: %lx]", func);
         return (intptr_t) func;
     }
@@ -689,6 +992,18 @@ static void env_heap_copy_vals(heap_t *heap, int vc, val_t *vp)
         } else
         if (val_is_array(v)) {
             val_set_array(v, (intptr_t)env_heap_copy_array(heap, (array_t *)val_2_intptr(v)));
+        } else
+        if (val_is_cell(v)) {
+            val_set_cell(v, (intptr_t)env_heap_copy_scope(heap, (scope_t *)val_2_intptr(v)));
+        } else
+        if (val_is_buffer(v)) {
+            val_set_buffer(v, (intptr_t)env_heap_copy_buffer(heap, (buffer_t *)val_2_intptr(v)));
+        } else
+        if (val_is_map(v)) {
+            val_set_map(v, (intptr_t)env_heap_copy_map(heap, (map_t *)val_2_intptr(v)));
+        } else
+        if (val_is_coroutine(v)) {
+            val_set_coroutine(v, env_heap_copy_coroutine(heap, val_2_intptr(v)));
         }
         i++;
     }
@@ -698,7 +1013,7 @@ static void env_heap_gc_init(env_t *env)
 {
     heap_t  *heap = env_heap_get_free(env);
     val_t   *sb;
-    int fp, sp, ss;
+    int fp, sp, ss, i;
 
     heap_reset(heap);
 
@@ -712,6 +1027,24 @@ static void env_heap_gc_init(env_t *env)
     env->scope = env_heap_copy_scope(heap, env->scope);
     //printf("\n");
 
+    env_heap_copy_vals(heap, 1, &env->except);
+
+    env->ready = env_heap_copy_generator(heap, env->ready);
+    env->ready_tail = env_heap_copy_generator(heap, env->ready_tail);
+
+    // only referenced by env, copied once
+    if (env->handles) {
+        env->handles = heap_dup_handle_table(heap, env->handles);
+    }
+
+    for (i = 0; i < env->exe.func_num; i++) {
+        function_t *func = env->exe.func_static + i;
+
+        if (func->magic == MAGIC_FUNCTION_STATIC) {
+            func->super = env_heap_copy_scope(heap, func->super);
+        }
+    }
+
     fp = env->fp, sp = env->sp, ss = env->ss;
     sb = env->sb;
     while (1) {
@@ -726,8 +1059,8 @@ static void env_heap_gc_init(env_t *env)
             //printf("\n");
             env_heap_copy_vals(heap, fp - sp, sb + sp);
 
+            sp = fp + FRAME_SIZE;
             fp = frame->fp;
-            sp = frame->sp;
         }
     }
 }
@@ -782,7 +1115,62 @@ static void env_heap_gc_scan(env_t *env)
             array_t *array= (array_t*) (base + scan);
 
             scan += array_mem_space(array);
-            env_heap_copy_vals(heap, array_length(array), array_values(array));
+            if (!array_is_number(array)) {
+                env_heap_copy_vals(heap, array_value_num(array), array_values(array));
+            }
+
+            break;
+            }
+        case MAGIC_BUFFER: {
+            buffer_t *buffer = (buffer_t *) (base + scan);
+
+            scan += buffer_mem_space(buffer);
+            if (buffer_is_slice(buffer)) {
+                buffer->base = env_heap_copy_buffer(heap, buffer->base);
+            }
+
+            break;
+            }
+        case MAGIC_MAP: {
+            map_t *map = (map_t *) (base + scan);
+
+            scan += map_mem_space(map);
+            env_heap_copy_vals(heap, map->entry_end * map_entry_width(map), map->entries);
+            // Note: keys hashed by address are moved
+            map_index_rebuild(map);
+
+            break;
+            }
+        case MAGIC_GENERATOR: {
+            generator_t *g = (generator_t *) (base + scan);
+
+            scan += generator_mem_space(g);
+            g->scope = env_heap_copy_scope(heap, g->scope);
+            g->future = env_heap_copy_future(heap, g->future);
+            g->await = env_heap_copy_future(heap, g->await);
+            g->next = env_heap_copy_generator(heap, g->next);
+            env_heap_copy_vals(heap, g->stack_num, generator_stack(g));
+
+            break;
+            }
+        case MAGIC_HANDLE: {
+            handle_table_t *t = (handle_table_t *) (base + scan);
+            handle_slot_t *slots = handle_slots(t);
+            int i;
+
+            scan += handle_table_mem_space(t);
+            for (i = 0; i < t->end; i++) {
+                env_heap_copy_vals(heap, 1, &slots[i].value);
+            }
+
+            break;
+            }
+        case MAGIC_FUTURE: {
+            future_t *f = (future_t *) (base + scan);
+
+            scan += future_mem_space(f);
+            f->waiter = env_heap_copy_generator(heap, f->waiter);
+            env_heap_copy_vals(heap, 1, &f->value);
 
             break;
             }
@@ -827,8 +1215,11 @@ int env_native_find(env_t *env, intptr_t sym_id)
 {
     int i;
 
+    // Note: symbal may be added by other, before the native
     for (i = 0; i < env->native_num; i++) {
-        if (sym_id == (intptr_t) env->native_ent[i].name) {
+        const char *name = env->native_ent[i].name;
+
+        if (sym_id == (intptr_t) name || !strcmp((const char *) sym_id, name)) {
             return i;
         }
     }
@@ -862,12 +1253,147 @@ int env_reference_set(env_t *env, val_t *ref, int num)
     return -1;
 }
 
+static int env_handle_table_grow(env_t *env)
+{
+    handle_table_t *t = env->handles, *dup;
+    int size = t ? t->size * 2 : HANDLE_TABLE_MIN;
+
+    if (size > HANDLE_TABLE_MAX) {
+        if (t->size == HANDLE_TABLE_MAX) {
+            return -1;
+        }
+        size = HANDLE_TABLE_MAX;
+    }
+
+    dup = env_heap_alloc(env, SIZE_ALIGN(sizeof(handle_table_t) + sizeof(handle_slot_t) * size));
+    if (!dup) {
+        return -1;
+    }
+
+    // Note: table may be moved by gc, in alloc
+    t = env->handles;
+    dup->magic = MAGIC_HANDLE;
+    dup->age = 0;
+    dup->reserved = 0;
+    dup->size = size;
+    if (t) {
+        dup->end = t->end;
+        dup->free = t->free;
+        memcpy(handle_slots(dup), handle_slots(t), sizeof(handle_slot_t) * t->end);
+    } else {
+        dup->end = 0;
+        dup->free = -1;
+    }
+    env->handles = dup;
+
+    return 0;
+}
+
+static handle_slot_t *env_handle_slot(env_t *env, handle_t h)
+{
+    handle_table_t *t = env->handles;
+    int i = (int)(h & 0xFFFF) - 1;
+    handle_slot_t *slot;
+
+    if (!t || i < 0 || i >= t->end) {
+        return NULL;
+    }
+
+    slot = handle_slots(t) + i;
+    if (!slot->used || slot->generation != (h >> 16)) {
+        return NULL;
+    }
+
+    return slot;
+}
+
+/*
+ * v should be kept by gc, as the arguments of native, the table may grow
+ * before it is read.
+ */
+handle_t env_handle_new(env_t *env, val_t *v)
+{
+    handle_table_t *t = env->handles;
+    handle_slot_t *slot;
+    int i;
+
+    if (!t || (t->free < 0 && t->end == t->size)) {
+        if (env_handle_table_grow(env)) {
+            return 0;
+        }
+        t = env->handles;
+    }
+
+    if (t->free >= 0) {
+        i = t->free;
+        slot = handle_slots(t) + i;
+        t->free = slot->next;
+    } else {
+        i = t->end++;
+        slot = handle_slots(t) + i;
+        slot->generation = 0;
+    }
+    slot->value = *v;
+    slot->used = 1;
+    slot->next = -1;
+
+    return ((handle_t) slot->generation << 16) | (i + 1);
+}
+
+val_t *env_handle_get(env_t *env, handle_t h)
+{
+    handle_slot_t *slot = env_handle_slot(env, h);
+
+    return slot ? &slot->value : NULL;
+}
+
+int env_handle_release(env_t *env, handle_t h)
+{
+    handle_slot_t *slot = env_handle_slot(env, h);
+
+    if (!slot) {
+        return -1;
+    }
+
+    val_set_undefined(&slot->value);
+    slot->used = 0;
+    if (slot->generation == HANDLE_GENERATION_MAX) {
+        // not reused, or the stale handle would be valid again
+        return 0;
+    }
+    slot->generation++;
+    slot->next = env->handles->free;
+    env->handles->free = slot - handle_slots(env->handles);
+
+    return 0;
+}
+
 int env_callback_set(env_t *env, void (*cb)(void))
 {
     env->gc_callback = cb;
     return 0;
 }
 
+/*
+ * Stop the execution at the next backward jump or call, with the error
+ * ERR_Interrupted. It only set an atomic flag, could be called in signal
+ * handler or other thread. The flag is taken by the interrupted run, or
+ * kept for the next execution, if it is set when nothing is running.
+ */
+void env_interrupt(env_t *env)
+{
+    atomic_store_explicit(&env->interrupt, 1, memory_order_relaxed);
+}
+
+/*
+ * Drop the interrupt not taken, e.g. deadline expired after the run
+ * finished. Call it when the deadline is disarmed.
+ */
+void env_interrupt_clear(env_t *env)
+{
+    atomic_store_explicit(&env->interrupt, 0, memory_order_relaxed);
+}
+
 void env_symbal_foreach(env_t *env, int (*cb)(const char *, void *), void *param)
 {
     int i;
@@ -47,10 +47,23 @@ typedef struct scope_t {
 } scope_t;
 
 struct native_t;
+struct generator_t;
+struct handle_table_t;
+
+typedef uint32_t handle_t;              // see env_handle_new
+
+typedef struct prop_cache_t {
+    const uint8_t *pc;                  // instruction own the entry
+    val_t    key;
+    intptr_t symbal;
+    int      index;                     // index of property in object
+} prop_cache_t;
 
 typedef struct env_t {
     int16_t error;
     int16_t main_var_num;
+    uint8_t quicken;                    // code is writable, instruction can be quickened
+    uint8_t nest;                       // interp_run nested by native callback
 
     int fp;
     int ss;
@@ -59,6 +72,16 @@ typedef struct env_t {
 
     scope_t *scope;                     // Root scope
 
+    val_t except;                       // Value thrown, see BC_THROW
+
+    atomic_int interrupt;               // set by env_interrupt, from signal or thread
+    int budget;                         // backward jumps & calls to run, 0: no limit
+    int budget_slice;                   // budget of each execution, see interp_budget_set
+    const uint8_t *resume;              // pc of the paused execution, see interp_resume
+
+    struct generator_t *ready;          // async frames to run, the future awaited settled
+    struct generator_t *ready_tail;
+
     heap_t *heap;                       // inused heap ptr: top or bot
     heap_t heap_top;
     heap_t heap_bot;
@@ -74,12 +97,15 @@ typedef struct env_t {
     intptr_t *symbal_tbl;
     char     *symbal_buf;
     val_t    *ref_ent;                  // External reference entry
+    struct handle_table_t *handles;     // Values held by host, by handle
     const struct native_t *native_ent;  // Native function entry
 
     intptr_t *main_var_map;
 
     void (*gc_callback)(void);
 
+    prop_cache_t prop_cache[DEF_PROP_CACHE_SIZE];
+
     executable_t exe;
 } env_t;
 
@@ -98,13 +124,28 @@ int env_init(env_t *env, void * mem_ptr, int mem_size,
 
 int env_deinit(env_t *env);
 int env_reference_set(env_t *env, val_t *ent, int num);
+
+/*
+ * Value held by host, by handle, which is root of gc as the references.
+ * Handle released is stale, and refused by get & release.
+ * env_handle_new return 0 if not enough memory, pointer of env_handle_get
+ * is valid until the next allocation of heap.
+ * Up to 65535 handles are held at once. Slot of handle is reused 65535
+ * times, then retired, so a stale handle is never taken as a new one.
+ */
+handle_t env_handle_new(env_t *env, val_t *v);
+val_t *env_handle_get(env_t *env, handle_t h);
+int env_handle_release(env_t *env, handle_t h);
 int env_callback_set(env_t *env, void (*cb)(void));
+void env_interrupt(env_t *env);
+void env_interrupt_clear(env_t *env);
 int env_native_set(env_t *env, const native_t *ent, int num);
 
 void *env_heap_alloc(env_t *env, int size);
 void env_heap_gc(env_t *env, int level);
 
 scope_t *env_scope_create(env_t *env, scope_t *super, uint8_t *entry, int ac, val_t *av);
+scope_t *env_scope_alloc(env_t *env, scope_t *super, int num);
 int env_scope_get(env_t *env, int id, val_t **v);
 int env_scope_set(env_t *env, int id, val_t *v);
 
@@ -126,6 +167,8 @@ int env_number_find_add(env_t *env, double);
 int env_native_find(env_t *env, intptr_t sym_id);
 
 const uint8_t *env_frame_setup(env_t *env, const uint8_t *pc, val_t *fv, int ac, val_t *av);
+const uint8_t *env_frame_tail(env_t *env, const uint8_t *pc, val_t *fv, int ac, val_t *av);
+int env_frame_native(env_t *env, const uint8_t *pc, int ac, int high);
 const uint8_t *env_func_entry_setup(env_t *env, uint8_t *entry, int ac, val_t *av);
 void env_frame_restore(env_t *env, const uint8_t **pc, scope_t **scope);
 void env_native_call(env_t *env, val_t *fv, int ac, val_t *av);
@@ -182,6 +225,30 @@ static inline val_t *env_get_var(env_t *env, uint8_t id, uint8_t generation) {
     }
 }
 
+/*
+ * Boxed variable is a scope of one variable, shared by closures
+ */
+static inline val_t *env_get_cell(env_t *env, uint8_t id, uint8_t generation) {
+    val_t *v = env_get_var(env, id, generation);
+
+    if (v && val_is_cell(v)) {
+        return ((scope_t *)val_2_intptr(v))->var_buf;
+    } else {
+        return NULL;
+    }
+}
+
+// Variable be referenced, may be boxed
+static inline val_t *env_get_ref(env_t *env, uint8_t id, uint8_t generation) {
+    val_t *v = env_get_var(env, id, generation);
+
+    if (v && val_is_cell(v)) {
+        return ((scope_t *)val_2_intptr(v))->var_buf;
+    } else {
+        return v;
+    }
+}
+
 static inline void env_push_var(env_t *env, uint8_t id, uint8_t generation) {
     val_t *v = env_get_var(env, id, generation);
 
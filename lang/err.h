@@ -32,6 +32,7 @@ SOFTWARE.
 #define ERR_StaticNumberOverrun 202
 #define ERR_StackOverflow       203
 #define ERR_ResourceOutLimit    204
+#define ERR_Interrupted         205
 
 #define ERR_InvalidToken        300
 #define ERR_InvalidSyntax       301
@@ -45,6 +46,7 @@ SOFTWARE.
 #define ERR_NotDefinedProp      404
 #define ERR_HasNoneElement      405
 #define ERR_HasNoneProperty     406
+#define ERR_Exception           407
 
 #endif /* __LANG_ERR_INC__ */
 
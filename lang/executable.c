@@ -62,9 +62,15 @@ int executable_init(executable_t *exe, void *mem_ptr, int mem_size,
     exe->func_map = (uint8_t **) (mem_ptr + mem_offset);
     mem_offset += sizeof(uint8_t **) * func_max;
 
+    // static function object buffer init
+    mem_offset = SIZE_ALIGN(mem_offset);
+    exe->func_static = (function_t *) (mem_ptr + mem_offset);
+    mem_offset += sizeof(function_t) * func_max;
+
     if (mem_offset > mem_size) {
         return -1;
     } else {
+        memset(exe->func_static, 0, sizeof(function_t) * func_max);
         return mem_offset;
     }
 }
@@ -109,6 +115,36 @@ int executable_string_find_add(executable_t *exe, intptr_t s)
     }
 }
 
+/*
+ * Search the handler table, for the instruction at offset of code.
+ * return: offset of handler, or -1 if it is not guarded
+ */
+int executable_func_handler(const uint8_t *entry, int offset, int *depth)
+{
+    const uint8_t *code = executable_func_get_code(entry);
+    const uint8_t *end = code + executable_func_get_code_size(entry);
+    const uint8_t *h;
+    int n;
+
+    if (!executable_func_has_handler(entry)) {
+        return -1;
+    }
+
+    n = end[-2] * 0x100 + end[-1];
+    h = end - 2 - n * FUNC_HANDLER_SIZE;
+    for (; h < end - 2; h += FUNC_HANDLER_SIZE) {
+        int bgn = h[0] * 0x100 + h[1];
+        int fin = h[2] * 0x100 + h[3];
+
+        if (offset >= bgn && offset < fin) {
+            *depth = h[6] * 0x100 + h[7];
+            return h[4] * 0x100 + h[5];
+        }
+    }
+
+    return -1;
+}
+
 static inline
 void image_write(image_info_t *ef, int offset, void *buf, int size) {
     memcpy(ef->base + offset, buf, size);
@@ -243,7 +279,7 @@ int image_fill_data(image_info_t *img, unsigned int nc, double *nv, unsigned int
     return 0;
 }
 
-int image_fill_code(image_info_t *img, unsigned int entry, uint8_t vc, uint8_t ac, uint16_t stack_need, int closure, uint8_t *code, unsigned int size)
+int image_fill_code(image_info_t *img, unsigned int entry, uint8_t vc, uint8_t ac, uint16_t stack_need, int flags, uint8_t *code, unsigned int size)
 {
     unsigned int offset, end;
 
@@ -259,7 +295,7 @@ int image_fill_code(image_info_t *img, unsigned int entry, uint8_t vc, uint8_t a
 
     image_write_uint32(img, img->fn_ent + entry * 4, offset);
 
-    executable_func_set_head(img->base + offset, vc, ac, size, stack_need, closure);
+    executable_func_set_head(img->base + offset, vc, ac, size, stack_need, flags);
     offset += FUNC_HEAD_SIZE;
 
     image_write(img, offset, code, size);
@@ -33,6 +33,22 @@ SOFTWARE.
 
 #define FUNC_HEAD_SIZE 8
 
+#define FUNC_FL_CLOSURE     1
+#define FUNC_FL_HANDLER     2   // handler table follow the code
+
+/*
+ * Handler table of try statement, is placed at the end of code, and
+ * counted in the code size:
+ *
+ *   | code | handler 0 | handler 1 | ... | handler n-1 | n |
+ *
+ * Each handler is 4 u16 in big endian: begin, end, handler and depth.
+ * The code in [begin, end) is guarded, on error the stack is restored
+ * to the depth (in frame), and jump to the handler with the error value
+ * pushed. The inner one is placed before the outer one.
+ */
+#define FUNC_HANDLER_SIZE   8
+
 #define EXEC_FL_BE     1
 #define EXEC_FL_64     2
 
@@ -53,6 +69,7 @@ typedef struct executable_t {
     double   *number_map;
     intptr_t *string_map;
     uint8_t **func_map;
+    struct function_t *func_static;     // function object of func_map entry
 
     uint32_t  main_code_end;
     uint32_t  main_code_max;
@@ -85,15 +102,15 @@ int executable_init(executable_t *exe, void *memory, int size,
                     int main_code_max, int func_code_max);
 
 static inline
-int executable_func_set_head(void *buf, uint8_t vc, uint8_t ac, uint32_t code_size, uint16_t stack_size, int closure) {
+int executable_func_set_head(void *buf, uint8_t vc, uint8_t ac, uint32_t code_size, uint16_t stack_size, int flags) {
     uint8_t *head = (uint8_t *)buf;
     int mark = 0;
 
-    if (stack_size & 0x8000) {
+    if ((stack_size & 0x8000) || (code_size & 0x80000000)) {
         return -1;
     }
 
-    if (closure) {
+    if (flags & FUNC_FL_CLOSURE) {
         mark = 0x80;
     }
 
@@ -103,7 +120,7 @@ int executable_func_set_head(void *buf, uint8_t vc, uint8_t ac, uint32_t code_si
     head[2] = (stack_size >> 8) | mark;
     head[3] = stack_size;
 
-    head[4] = code_size >> 24;
+    head[4] = (code_size >> 24) | (flags & FUNC_FL_HANDLER ? 0x80 : 0);
     head[5] = code_size >> 16;
     head[6] = code_size >> 8;
     head[7] = code_size;
@@ -126,7 +143,7 @@ int executable_func_get_head(void *buf, uint8_t *vc, uint8_t *ac, uint32_t *code
     *stack_size = size;
     *closure = mark;
 
-    size = (head[4] * 0x1000000 + head[5] * 0x10000 + head[6] * 0x100 + head[7]);
+    size = ((head[4] & 0x7F) * 0x1000000 + head[5] * 0x10000 + head[6] * 0x100 + head[7]);
     *code_size = size;
 
     return 0;
@@ -149,7 +166,7 @@ uint16_t executable_func_get_stack_high(const uint8_t *entry) {
 
 static inline
 uint32_t executable_func_get_code_size(const uint8_t *entry) {
-    return (entry[4] * 0x1000000 + entry[5] * 0x10000 + entry[6] * 0x100 + entry[7]);
+    return ((entry[4] & 0x7F) * 0x1000000 + entry[5] * 0x10000 + entry[6] * 0x100 + entry[7]);
 }
 
 static inline
@@ -162,13 +179,20 @@ int executable_func_is_closure(const uint8_t *entry) {
     return (entry[2] & 0x80) == 0x80;
 }
 
+static inline
+int executable_func_has_handler(const uint8_t *entry) {
+    return (entry[4] & 0x80) == 0x80;
+}
+
+int executable_func_handler(const uint8_t *entry, int offset, int *depth);
+
 int executable_number_find_add(executable_t *exe, double n);
 int executable_string_find_add(executable_t *exe, intptr_t s);
 
 int image_init(image_info_t *img, void *mem_ptr, int mem_size, int byte_order, int nc, int sc, int fc);
 int image_load(image_info_t *img, uint8_t *input, int size);
 int image_fill_data(image_info_t *img, unsigned int nc, double *nv, unsigned int sc, intptr_t *sv);
-int image_fill_code(image_info_t *img, unsigned int entry, uint8_t vc, uint8_t ac, uint16_t stack_need, int closure, uint8_t *code, unsigned int size);
+int image_fill_code(image_info_t *img, unsigned int entry, uint8_t vc, uint8_t ac, uint16_t stack_need, int flags, uint8_t *code, unsigned int size);
 double *image_number_entry(image_info_t *img);
 double image_get_number(image_info_t *img, int index);
 const char *image_get_string(image_info_t *img, int index);
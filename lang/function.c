@@ -24,15 +24,43 @@ SOFTWARE.
 
 #include "function.h"
 
+static void function_init(function_t *fn, uint8_t magic, uint8_t *entry, scope_t *super)
+{
+    fn->magic = magic;
+    fn->age   = 0;
+    fn->varc  = executable_func_get_var_cnt(entry);
+    fn->argc  = executable_func_get_arg_cnt(entry);
+    fn->stack_high = executable_func_get_stack_high(entry);
+    fn->empty = executable_func_get_code_size(entry) == 0;
+    fn->reserved = 0;
+    fn->entry = entry;
+    fn->super = super;
+}
+
 intptr_t function_create(env_t *env, uint8_t *entry)
 {
     function_t *fn = (function_t *) env_heap_alloc(env, sizeof(function_t));
 
     if (fn) {
-        fn->magic = MAGIC_FUNCTION;
-        fn->age   = 0;
-        fn->entry = entry;
-        fn->super = env->scope;
+        function_init(fn, MAGIC_FUNCTION, entry, env->scope);
+    }
+    return (intptr_t) fn;
+}
+
+/*
+ * Function captured nothing has only one object for each entry,
+ * it is not in heap, and never be collected.
+ * The super scope is always the root scope, set it again, because
+ * root scope may be moved by gc.
+ */
+intptr_t function_static(env_t *env, unsigned int id, scope_t *super)
+{
+    function_t *fn = env->exe.func_static + id;
+
+    if (fn->magic != MAGIC_FUNCTION_STATIC) {
+        function_init(fn, MAGIC_FUNCTION_STATIC, env->exe.func_map[id], super);
+    } else {
+        fn->super = super;
     }
     return (intptr_t) fn;
 }
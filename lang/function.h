@@ -33,11 +33,20 @@ SOFTWARE.
 #include "interp.h"
 
 #define MAGIC_FUNCTION  (MAGIC_BASE + 5)
+#define MAGIC_FUNCTION_STATIC (MAGIC_BASE + 13)
 
+/*
+ * Head of function entry is decoded when function created,
+ * call does not touch the entry until code.
+ */
 typedef struct function_t {
     uint8_t magic;
     uint8_t age;
-    uint8_t reserved[2];
+    uint8_t varc;
+    uint8_t argc;
+    uint16_t stack_high;
+    uint8_t empty;              // no code in function
+    uint8_t reserved;
     uint8_t *entry;
     scope_t *super;
 } function_t;
@@ -45,6 +54,7 @@ typedef struct function_t {
 typedef val_t (*function_native_t) (env_t *env, int ac, val_t *av);
 
 intptr_t  function_create(env_t *env, uint8_t *code);
+intptr_t  function_static(env_t *env, unsigned int id, scope_t *super);
 int function_destroy(intptr_t func);
 
 static inline
@@ -55,22 +65,27 @@ int function_mem_space(function_t *f) {
 
 static inline
 uint8_t function_varc(function_t *fn) {
-    return executable_func_get_var_cnt(fn->entry);
+    return fn->varc;
 }
 
 static inline
-uint8_t function_size(function_t *fn) {
+uint32_t function_size(function_t *fn) {
     return executable_func_get_code_size(fn->entry);
 }
 
 static inline
 uint8_t function_argc(function_t *fn) {
-    return executable_func_get_arg_cnt(fn->entry);
+    return fn->argc;
 }
 
 static inline
 uint16_t function_stack_high(function_t *fn) {
-    return executable_func_get_stack_high(fn->entry);
+    return fn->stack_high;
+}
+
+static inline
+int function_is_empty(function_t *fn) {
+    return fn->empty;
 }
 
 static inline
@@ -0,0 +1,101 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "err.h"
+#include "future.h"
+#include "generator.h"
+
+future_t *future_alloc(env_t *env)
+{
+    future_t *f;
+
+    f = env_heap_alloc(env, sizeof(future_t));
+    if (f) {
+        f->magic = MAGIC_FUTURE;
+        f->age = 0;
+        f->state = FUTURE_PENDING;
+        f->reserved = 0;
+        f->error = 0;
+        val_set_undefined(&f->value);
+        f->waiter = NULL;
+    } else {
+        env_set_error(env, ERR_NotEnoughMemory);
+    }
+
+    return f;
+}
+
+/*
+ * Pending future for native to return, the host keep it in reference of
+ * env, and settle it later by interp_future_resolve or interp_future_reject.
+ */
+val_t future_create(env_t *env)
+{
+    future_t *f = future_alloc(env);
+
+    return f ? val_mk_future(f) : val_mk_undefined();
+}
+
+/*
+ * Settle the pending future, and move the frames await it to the ready
+ * queue of env, in the order they waited.
+ * error: 0 for resolved, or error of rejected
+ * value: result of resolved, or thrown by rejected (ERR_Exception)
+ */
+void future_settle(env_t *env, future_t *f, int error, val_t *value)
+{
+    generator_t *g = f->waiter;
+
+    f->state = error ? FUTURE_REJECTED : FUTURE_RESOLVED;
+    f->error = error;
+    if (value) {
+        f->value = *value;
+    }
+    f->waiter = NULL;
+
+    if (g) {
+        if (env->ready_tail) {
+            env->ready_tail->next = g;
+        } else {
+            env->ready = g;
+        }
+        while (g->next) {
+            g = g->next;
+        }
+        env->ready_tail = g;
+    }
+}
+
+// The frame of async function wait for the pending future
+void future_wait(future_t *f, generator_t *g)
+{
+    generator_t **link = &f->waiter;
+
+    while (*link) {
+        link = &(*link)->next;
+    }
+    *link = g;
+    g->next = NULL;
+    g->await = f;
+}
@@ -0,0 +1,75 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#ifndef __LANG_FUTURE_INC__
+#define __LANG_FUTURE_INC__
+
+#include "config.h"
+#include "val.h"
+#include "env.h"
+
+#define MAGIC_FUTURE        (MAGIC_BASE + 21)
+
+#define FUTURE_PENDING      0
+#define FUTURE_RESOLVED     1
+#define FUTURE_REJECTED     2
+
+struct generator_t;
+
+/*
+ * Result of native not ready yet, or of async function. The frames await
+ * it are linked from waiter, by generator->next, and moved to the ready
+ * queue of env when it is settled, see future_settle.
+ */
+typedef struct future_t {
+    uint8_t magic;
+    uint8_t age;
+    uint8_t state;
+    uint8_t reserved;
+    int     error;              // of the rejected
+    val_t   value;              // of the resolved, or thrown by the rejected
+    struct generator_t *waiter;
+} future_t;
+
+static inline int future_mem_space(future_t *f) {
+    (void) f;
+    return SIZE_ALIGN(sizeof(future_t));
+}
+
+static inline int val_is_future(val_t *v) {
+    return val_is_coroutine(v) && *((uint8_t *)val_2_intptr(v)) == MAGIC_FUTURE;
+}
+
+static inline val_t val_mk_future(future_t *f) {
+    return val_mk_coroutine(f);
+}
+
+future_t *future_alloc(env_t *env);
+val_t future_create(env_t *env);
+void future_settle(env_t *env, future_t *f, int error, val_t *value);
+void future_wait(future_t *f, struct generator_t *g);
+
+#endif /* __LANG_FUTURE_INC__ */
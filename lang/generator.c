@@ -0,0 +1,74 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "err.h"
+#include "generator.h"
+
+generator_t *generator_alloc(env_t *env, int stack_size)
+{
+    generator_t *g;
+
+    g = env_heap_alloc(env, sizeof(generator_t) + sizeof(val_t) * stack_size);
+    if (g) {
+        g->magic = MAGIC_GENERATOR;
+        g->age = 0;
+        g->state = GENERATOR_SUSPENDED;
+        g->reserved = 0;
+        g->stack_size = stack_size;
+        g->stack_num = 0;
+        g->pc = NULL;
+        g->exit = NULL;
+        g->scope = NULL;
+        g->future = NULL;
+        g->await = NULL;
+        g->next = NULL;
+    } else {
+        env_set_error(env, ERR_NotEnoughMemory);
+    }
+
+    return g;
+}
+
+/*
+ * Generator is resumed by interpreter, in a frame of its own, see
+ * interp_generator_resume. The native is called with invalid self only.
+ */
+val_t generator_next(env_t *env, int ac, val_t *av)
+{
+    (void) ac;
+    (void) av;
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+val_t generator_done(env_t *env, int ac, val_t *av)
+{
+    if (ac > 0 && val_is_generator(av)) {
+        return val_mk_boolean(((generator_t *)val_2_intptr(av))->state == GENERATOR_DONE);
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
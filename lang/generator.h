@@ -0,0 +1,84 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#ifndef __LANG_GENERATOR_INC__
+#define __LANG_GENERATOR_INC__
+
+#include "config.h"
+#include "val.h"
+#include "env.h"
+#include "future.h"
+
+#define MAGIC_GENERATOR     (MAGIC_BASE + 19)
+
+#define GENERATOR_SUSPENDED 0   // created or yielded, could be resumed
+#define GENERATOR_RUNNING   1
+#define GENERATOR_DONE      2
+
+/*
+ * Frame of generator function detached from the stack: the scope, and the
+ * values above the frame, which the generator itself is not counted in.
+ * Space of values is the stack high of function, allocated once.
+ * Frame of async function is detached the same way, when it await a future
+ * pending, and never seen by script: the future of result is returned.
+ */
+typedef struct generator_t {
+    uint8_t magic;
+    uint8_t age;
+    uint8_t state;
+    uint8_t reserved;
+    uint16_t stack_size;        // values can be held
+    uint16_t stack_num;         // values held, from the bottom
+    const uint8_t *pc;          // where to go on
+    const uint8_t *exit;        // where the for-in loop go, when it is done
+    scope_t *scope;
+    future_t *future;           // result of async function, NULL for generator
+    future_t *await;            // future the async function waiting for
+    struct generator_t *next;   // next waiter of future, or in the ready queue
+} generator_t;
+
+static inline val_t *generator_stack(generator_t *g) {
+    return (val_t *)(g + 1);
+}
+
+static inline int generator_mem_space(generator_t *g) {
+    return SIZE_ALIGN(sizeof(generator_t) + sizeof(val_t) * g->stack_size);
+}
+
+static inline int val_is_generator(val_t *v) {
+    return val_is_coroutine(v) && *((uint8_t *)val_2_intptr(v)) == MAGIC_GENERATOR;
+}
+
+static inline void val_set_generator(val_t *p, generator_t *g) {
+    val_set_coroutine(p, (intptr_t) g);
+}
+
+generator_t *generator_alloc(env_t *env, int stack_size);
+
+val_t generator_next(env_t *env, int ac, val_t *av);
+val_t generator_done(env_t *env, int ac, val_t *av);
+
+#endif /* __LANG_GENERATOR_INC__ */
@@ -33,6 +33,9 @@ SOFTWARE.
 #include "string.h"
 #include "function.h"
 #include "array.h"
+#include "map.h"
+#include "generator.h"
+#include "future.h"
 #include "object.h"
 
 static val_t undefined = TAG_UNDEFINED;
@@ -208,52 +211,80 @@ static inline void interp_teq(env_t *env) {
     val_set_boolean(res, interp_test_equal(a, b));
 }
 
-static inline void interp_tne(env_t *env) {
+static inline void interp_tin(env_t *env) {
     val_t *b = env_stack_pop(env);
     val_t *a = b + 1;
     val_t *res = a;
 
-    val_set_boolean(res, !interp_test_equal(a, b));
+    val_set_boolean(res, object_has(env, b, a));
 }
 
-static inline void interp_tgt(env_t *env) {
+static inline void interp_tne(env_t *env) {
     val_t *b = env_stack_pop(env);
     val_t *a = b + 1;
     val_t *res = a;
 
+    val_set_boolean(res, !interp_test_equal(a, b));
+}
+
+static inline int interp_test_gt(val_t *a, val_t *b) {
     if (val_is_number(a)) {
-        if (val_is_number(b)) {
-            val_set_boolean(res, val_2_double(a) - val_2_double(b) > 0);
-            return;
-        }
+        return val_is_number(b) && val_2_double(a) - val_2_double(b) > 0;
     } else
     if (val_is_string(a)) {
-        if (val_is_string(b)) {
-            val_set_boolean(res, string_compare(a, b) > 0);
-            return;
-        }
+        return val_is_string(b) && string_compare(a, b) > 0;
+    } else {
+        return 0;
     }
-    val_set_boolean(res, 0);
 }
 
-static inline void interp_tge(env_t *env) {
-    val_t *b = env_stack_pop(env);
-    val_t *a = b + 1;
-    val_t *res = a;
+static inline int interp_test_ge(val_t *a, val_t *b) {
+    if (val_is_number(a)) {
+        return val_is_number(b) && val_2_double(a) - val_2_double(b) >= 0;
+    } else
+    if (val_is_string(a)) {
+        return val_is_string(b) && string_compare(a, b) >= 0;
+    } else {
+        return 0;
+    }
+}
 
+static inline int interp_test_lt(val_t *a, val_t *b) {
     if (val_is_number(a)) {
-        if (val_is_number(b)) {
-            val_set_boolean(res, val_2_double(a) - val_2_double(b) >= 0);
-            return;
-        }
+        return val_is_number(b) && val_2_double(a) - val_2_double(b) < 0;
     } else
     if (val_is_string(a)) {
-        if (val_is_string(b)) {
-            val_set_boolean(res, string_compare(a, b) >= 0);
-            return;
-        }
+        return val_is_string(b) && string_compare(a, b) < 0;
+    } else {
+        return 0;
+    }
+}
+
+static inline int interp_test_le(val_t *a, val_t *b) {
+    if (val_is_number(a)) {
+        return val_is_number(b) && val_2_double(a) - val_2_double(b) <= 0;
+    } else
+    if (val_is_string(a)) {
+        return val_is_string(b) && string_compare(a, b) <= 0;
+    } else {
+        return 0;
     }
-    val_set_boolean(res, 0);
+}
+
+static inline void interp_tgt(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+    val_t *res = a;
+
+    val_set_boolean(res, interp_test_gt(a, b));
+}
+
+static inline void interp_tge(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+    val_t *res = a;
+
+    val_set_boolean(res, interp_test_ge(a, b));
 }
 
 static inline void interp_tlt(env_t *env) {
@@ -261,19 +292,7 @@ static inline void interp_tlt(env_t *env) {
     val_t *a = b + 1;
     val_t *res = a;
 
-    if (val_is_number(a)) {
-        if (val_is_number(b)) {
-            val_set_boolean(res, val_2_double(a) - val_2_double(b) < 0);
-            return;
-        }
-    } else
-    if (val_is_string(a)) {
-        if (val_is_string(b)) {
-            val_set_boolean(res, string_compare(a, b) < 0);
-            return;
-        }
-    }
-    val_set_boolean(res, 0);
+    val_set_boolean(res, interp_test_lt(a, b));
 }
 
 static inline void interp_tle(env_t *env) {
@@ -281,19 +300,401 @@ static inline void interp_tle(env_t *env) {
     val_t *a = b + 1;
     val_t *res = a;
 
-    if (val_is_number(a)) {
-        if (val_is_number(b)) {
-            val_set_boolean(res, val_2_double(a) - val_2_double(b) <= 0);
-            return;
+    val_set_boolean(res, interp_test_le(a, b));
+}
+
+/*
+ * Compare and pop the operands, for the compare and jump instructions
+ */
+static inline int interp_pop_teq(env_t *env) {
+    val_t *b = env_stack_release(env, 2) - 2;
+
+    return interp_test_equal(b + 1, b);
+}
+
+static inline int interp_pop_tne(env_t *env) {
+    val_t *b = env_stack_release(env, 2) - 2;
+
+    return !interp_test_equal(b + 1, b);
+}
+
+static inline int interp_pop_tgt(env_t *env) {
+    val_t *b = env_stack_release(env, 2) - 2;
+
+    return interp_test_gt(b + 1, b);
+}
+
+static inline int interp_pop_tge(env_t *env) {
+    val_t *b = env_stack_release(env, 2) - 2;
+
+    return interp_test_ge(b + 1, b);
+}
+
+static inline int interp_pop_tlt(env_t *env) {
+    val_t *b = env_stack_release(env, 2) - 2;
+
+    return interp_test_lt(b + 1, b);
+}
+
+static inline int interp_pop_tle(env_t *env) {
+    val_t *b = env_stack_release(env, 2) - 2;
+
+    return interp_test_le(b + 1, b);
+}
+
+/*
+ * Step of for loop, see compile_stmt_for.
+ * Push the value of this round and return 1, or 0 if loop finished.
+ */
+static inline int interp_for_range(env_t *env) {
+    val_t *limit = env_stack_peek(env);
+    val_t *counter = limit + 1;
+
+    if (val_is_number(counter) && val_is_number(limit)) {
+        double n = val_2_double(counter);
+
+        if (n < val_2_double(limit)) {
+            val_set_number(counter, n + 1);
+            val_set_number(env_stack_push(env), n);
+            return 1;
+        }
+    } else {
+        env_set_error(env, ERR_InvalidInput);
+    }
+    return 0;
+}
+
+/*
+ * Generator function is started by BC_GEN_START, at the head of code: the
+ * frame is detached into the generator, and returned to caller.
+ */
+static const uint8_t *interp_generator_start(env_t *env, const uint8_t *pc)
+{
+    const uint8_t *entry = pc - 1 - FUNC_HEAD_SIZE;
+    generator_t *g;
+
+    if (NULL == (g = generator_alloc(env, executable_func_get_stack_high(entry)))) {
+        return pc;
+    }
+    g->pc = pc;
+    g->scope = env->scope;
+
+    env_frame_restore(env, &pc, &env->scope);
+    val_set_generator(env_stack_push(env), g);
+
+    return pc;
+}
+
+/*
+ * Generator is resumed in a frame built in place of the arguments, as the
+ * native loop (env_frame_native). The generator is placed at the bottom of
+ * the frame stack, followed by the values saved, see interp_generator_yield.
+ * ac:   -1 for for-in loop, the state of loop is kept
+ * exit: where the for-in loop go, when it is done, or NULL for next()
+ */
+static const uint8_t *interp_generator_resume(env_t *env, generator_t *g, int ac, const uint8_t *pc, const uint8_t *exit)
+{
+    val_t *stack;
+    int i;
+
+    if (g->state != GENERATOR_SUSPENDED) {
+        if (g->state == GENERATOR_RUNNING) {
+            env_set_error(env, ERR_InvalidCallor);
+        } else
+        if (exit) {
+            return exit;
+        } else {
+            env->sp += ac + 1; // release arguments & function
+            env_push_undefined(env);
+        }
+        return pc;
+    }
+
+    // Note: stack high of function count the generator in
+    if (env_frame_native(env, pc, ac, g->stack_size)) {
+        return pc;
+    }
+
+    val_set_generator(env_stack_push(env), g);
+    stack = generator_stack(g);
+    for (i = 0; i < g->stack_num; i++) {
+        *env_stack_push(env) = stack[i];
+    }
+    env->scope = g->scope;
+
+    g->stack_num = 0;
+    g->state = GENERATOR_RUNNING;
+    g->exit = exit;
+
+    return g->pc;
+}
+
+static inline generator_t *interp_generator_self(env_t *env) {
+    return (generator_t *)val_2_intptr(env->sb + env->fp - 1);
+}
+
+static inline void interp_generator_finish(generator_t *g) {
+    g->state = GENERATOR_DONE;
+    g->scope = NULL;
+    g->stack_num = 0;
+}
+
+// The frame is detached: stack above the generator and scope are saved
+static void interp_generator_detach(env_t *env, generator_t *g, const uint8_t *pc)
+{
+    val_t *bottom = env->sb + env->fp - 1;
+    val_t *stack = generator_stack(g);
+    int i, n = bottom - (env->sb + env->sp);
+
+    for (i = 0; i < n; i++) {
+        stack[i] = bottom[-1 - i];
+    }
+    g->stack_num = n;
+    g->pc = pc;
+    g->scope = env->scope;
+    g->state = GENERATOR_SUSPENDED;
+}
+
+static const uint8_t *interp_generator_yield(env_t *env, const uint8_t *pc)
+{
+    val_t res = *env_stack_pop(env);
+
+    interp_generator_detach(env, interp_generator_self(env), pc);
+
+    env_frame_restore(env, &pc, &env->scope);
+    *env_stack_push(env) = res;
+
+    return pc;
+}
+
+/*
+ * Generator is finished, or the async function: its future is resolved,
+ * and returned to the one called or resumed it.
+ */
+static const uint8_t *interp_generator_return(env_t *env, const uint8_t *pc)
+{
+    val_t res = *env_stack_pop(env);
+    generator_t *g = interp_generator_self(env);
+    const uint8_t *exit = g->exit;
+    future_t *f = g->future;
+
+    interp_generator_finish(g);
+    if (f) {
+        future_settle(env, f, 0, &res);
+    }
+
+    env_frame_restore(env, &pc, &env->scope);
+    if (f) {
+        *env_stack_push(env) = val_mk_future(f);
+        return pc;
+    }
+    if (exit) {
+        return exit;
+    }
+    *env_stack_push(env) = res;
+
+    return pc;
+}
+
+/*
+ * Async function is started by BC_ASYNC, at the head of code: the body is
+ * run at once, with the generator at the bottom of the frame stack, as the
+ * resumed one. It is detached only if a future pending is awaited.
+ */
+static const uint8_t *interp_async_start(env_t *env, const uint8_t *pc)
+{
+    const uint8_t *entry = pc - 1 - FUNC_HEAD_SIZE;
+    generator_t *g;
+    future_t *f;
+
+    if (NULL == (g = generator_alloc(env, executable_func_get_stack_high(entry)))) {
+        return pc;
+    }
+    g->state = GENERATOR_RUNNING;
+    val_set_generator(env_stack_push(env), g);
+
+    // Note: generator may be moved by gc, in alloc
+    if (NULL != (f = future_alloc(env))) {
+        interp_generator_self(env)->future = f;
+    }
+
+    return pc;
+}
+
+// Push the result of future settled, or raise the error of the rejected
+static void interp_async_result(env_t *env, future_t *f)
+{
+    if (f->state == FUTURE_RESOLVED) {
+        *env_stack_push(env) = f->value;
+    } else {
+        if (f->error == ERR_Exception) {
+            env->except = f->value;
+        }
+        env_set_error(env, f->error);
+    }
+}
+
+/*
+ * Value is the result, if it's not a future pending. Or the frame is
+ * detached, to wait for the future, and the future of result is returned
+ * to the one called or resumed it. see interp_async_run.
+ */
+static const uint8_t *interp_async_await(env_t *env, const uint8_t *pc)
+{
+    val_t *v = env_stack_peek(env);
+    generator_t *g;
+    future_t *f;
+
+    if (!val_is_future(v)) {
+        return pc;
+    }
+
+    f = (future_t *)val_2_intptr(env_stack_pop(env));
+    if (f->state != FUTURE_PENDING) {
+        interp_async_result(env, f);
+        return pc;
+    }
+
+    g = interp_generator_self(env);
+    interp_generator_detach(env, g, pc);
+    future_wait(f, g);
+
+    env_frame_restore(env, &pc, &env->scope);
+    *env_stack_push(env) = val_mk_future(g->future);
+
+    return pc;
+}
+
+/*
+ * Error raised by async function is the result, it is rejected and the
+ * caller go on with the future, see interp_unwind.
+ */
+static const uint8_t *interp_async_reject(env_t *env)
+{
+    generator_t *g = interp_generator_self(env);
+    future_t *f = g->future;
+    const uint8_t *pc;
+
+    interp_generator_finish(g);
+    future_settle(env, f, env->error, &env->except);
+    val_set_undefined(&env->except);
+    env->error = 0;
+
+    env_frame_restore(env, &pc, &env->scope);
+    *env_stack_push(env) = val_mk_future(f);
+
+    return pc;
+}
+
+/*
+ * Step of for-in loop, return the address to go on: the next instruction
+ * if the value of round pushed, or the exit of loop.
+ */
+static inline const uint8_t *interp_for_each(env_t *env, const uint8_t *pc, int exit) {
+    val_t *index = env_stack_peek(env);
+    val_t *self = index + 1;
+
+    if (val_is_array(self)) {
+        array_t *a = (array_t *)val_2_intptr(self);
+        int i = val_2_integer(index);
+
+        // Note: array may be changed in the loop, check it every round
+        if (!array_is_sparse(a)) {
+            if (i < array_value_num(a)) {
+                val_set_number(index, i + 1);
+                *env_stack_push(env) = array_values(a)[i];
+                return pc;
+            }
+        } else
+        if (i < array_length(a)) {
+            val_t *v = array_sparse_ref(a, i);
+
+            val_set_number(index, i + 1);
+            if (v) {
+                *env_stack_push(env) = *v;
+            } else {
+                val_set_undefined(env_stack_push(env));
+            }
+            return pc;
         }
     } else
-    if (val_is_string(a)) {
-        if (val_is_string(b)) {
-            val_set_boolean(res, string_compare(a, b) <= 0);
-            return;
+    if (val_is_generator(self)) {
+        // value of round is pushed by yield
+        return interp_generator_resume(env, (generator_t *)val_2_intptr(self), -1, pc, pc + exit);
+    } else {
+        env_set_error(env, ERR_HasNoneElement);
+    }
+    return pc + exit;
+}
+
+/*
+ * Switch, see compile_stmt_switch. pc point to the parameters,
+ * return the address of case matched, or the default one.
+ */
+static inline const uint8_t *interp_switch_jmp(const uint8_t *entries, int entry) {
+    const uint8_t *pc = entries + entry * 3;
+    int index = (int8_t) pc[1];
+
+    index = (index << 8) | pc[2];
+    return pc + 3 + index;
+}
+
+static const uint8_t *interp_switch_table(env_t *env, const uint8_t *pc) {
+    val_t *v = env_stack_pop(env);
+    int lo = (pc[0] << 8) | pc[1];
+    int n  = (pc[2] << 8) | pc[3];
+    int entry = 0;
+
+    if (val_is_number(v)) {
+        double d = val_2_double(v) - env->exe.number_map[lo];
+
+        if (d >= 0 && d < n && d == (int) d) {
+            entry = 1 + (int) d;
+        }
+    }
+
+    return interp_switch_jmp(pc + 4, entry);
+}
+
+static const uint8_t *interp_switch_search(env_t *env, const uint8_t *pc, int is_str) {
+    val_t *v = env_stack_pop(env);
+    int n = (pc[0] << 8) | pc[1];
+    const uint8_t *ids = pc + 2;
+    const char *str = NULL;
+    double num = 0;
+    int lo = 0, hi = n - 1, entry = 0;
+
+    if (is_str ? !(str = val_2_cstring(v)) : !val_is_number(v)) {
+        return interp_switch_jmp(ids + n * 2, 0);
+    }
+    if (!is_str) {
+        num = val_2_double(v);
+    }
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int id  = (ids[mid * 2] << 8) | ids[mid * 2 + 1];
+        int cmp;
+
+        if (is_str) {
+            cmp = strcmp((const char *)env->exe.string_map[id], str);
+        } else {
+            double d = env->exe.number_map[id];
+            cmp = d < num ? -1 : d > num ? 1 : 0;
+        }
+
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else
+        if (cmp > 0) {
+            hi = mid - 1;
+        } else {
+            entry = 1 + mid;
+            break;
         }
     }
-    val_set_boolean(res, 0);
+
+    return interp_switch_jmp(ids + n * 2, entry);
 }
 
 static inline void interp_assign(env_t *env) {
@@ -305,7 +706,7 @@ static inline void interp_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft) {
             *res = *lft = *rht;
             env_stack_pop(env);
@@ -324,7 +725,7 @@ static inline void interp_add_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft) {
             if (val_is_number(lft)) {
                 number_add(env, lft, rht, lft);
@@ -353,7 +754,7 @@ static inline void interp_sub_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_sub(env, lft, rht, lft);
 
@@ -374,7 +775,7 @@ static inline void interp_mul_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_mul(env, lft, rht, lft);
 
@@ -395,7 +796,7 @@ static inline void interp_div_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_div(env, lft, rht, lft);
 
@@ -416,7 +817,7 @@ static inline void interp_mod_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_mod(env, lft, rht, lft);
 
@@ -437,7 +838,7 @@ static inline void interp_and_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_and(env, lft, rht, lft);
 
@@ -458,7 +859,7 @@ static inline void interp_or_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_or(env, lft, rht, lft);
 
@@ -479,7 +880,7 @@ static inline void interp_xor_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_xor(env, lft, rht, lft);
 
@@ -500,7 +901,7 @@ static inline void interp_lshift_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_lshift(env, lft, rht, lft);
 
@@ -521,7 +922,7 @@ static inline void interp_rshift_assign(env_t *env) {
         uint8_t id, generation;
 
         val_2_reference(lft, &id, &generation);
-        lft = env_get_var(env, id, generation);
+        lft = env_get_ref(env, id, generation);
         if (lft && val_is_number(lft)) {
             number_rshift(env, lft, rht, lft);
 
@@ -533,65 +934,518 @@ static inline void interp_rshift_assign(env_t *env) {
     env_set_error(env, ERR_InvalidLeftValue);
 }
 
-static inline const uint8_t *interp_call(env_t *env, int ac, const uint8_t *pc) {
-    val_t *fn = env_stack_peek(env);
-    val_t *av = fn + 1;
+/*
+ * Number specialised instructions.
+ * The compiler emit them only when both operands are proved to be number,
+ * so the type checking is skipped here. The result keep the same with the
+ * generic one, include the NaN of zero divisor.
+ */
+static inline void interp_mul_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
 
-    if (val_is_script(fn)) {
-        return env_frame_setup(env, pc, fn, ac, av);
-    } else
-    if (val_is_native(fn)) {
-        env_native_call(env, fn, ac, av);
-    } else {
-        env_set_error(env, ERR_InvalidCallor);
-    }
-    return pc;
+    val_set_number(a, val_2_double(a) * val_2_double(b));
 }
 
-static inline void interp_array(env_t *env, int n) {
-    val_t *av = env_stack_peek(env);
-    intptr_t array = array_create(env, n, av);
+static inline void interp_div_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
 
-    if (array) {
-        val_set_array(env_stack_release(env, n - 1), array);
+    if (0 != val_2_double(b)) {
+        val_set_number(a, val_2_double(a) / val_2_double(b));
     } else {
-        val_set_undefined(env_stack_release(env, n - 1));
+        val_set_nan(a);
     }
 }
 
-static inline void interp_dict(env_t *env, int n) {
-    val_t *av = env_stack_peek(env);
-    intptr_t dict = object_create(env, n, av);
+static inline void interp_mod_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
 
-    if (dict) {
-        val_set_dictionary(env_stack_release(env, n - 1), dict);
+    if (0 != val_2_integer(b)) {
+        val_set_number(a, val_2_integer(a) % val_2_integer(b));
     } else {
-        val_set_undefined(env_stack_release(env, n - 1));
+        val_set_nan(a);
     }
 }
 
-static inline void interp_prop_self(env_t *env) {
-    val_t *key = env_stack_peek(env);
-    val_t *self = key + 1;
-    val_t *prop = key;
+static inline void interp_add_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
 
-    object_prop_get(env, self, key, prop);
-    // no pop
+    val_set_number(a, val_2_double(a) + val_2_double(b));
 }
 
-static inline void interp_prop_get(env_t *env) {
-    val_t *key = env_stack_peek(env); // keep the "key" in stack, defence GC
-    val_t *obj = key + 1;
-    val_t *res = obj;
+static inline void interp_sub_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
 
-    object_prop_get(env, obj, key, res);
-    env_stack_pop(env);
+    val_set_number(a, val_2_double(a) - val_2_double(b));
 }
 
-static inline void interp_elem_self(env_t *env) {
-    val_t *key = env_stack_peek(env); // keey the "key" in stack
-    val_t *obj = key + 1;
-    val_t *res = key;
+static inline void interp_lshift_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_number(a, val_2_integer(a) << val_2_integer(b));
+}
+
+static inline void interp_rshift_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_number(a, val_2_integer(a) >> val_2_integer(b));
+}
+
+static inline void interp_and_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_number(a, val_2_integer(a) & val_2_integer(b));
+}
+
+static inline void interp_or_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_number(a, val_2_integer(a) | val_2_integer(b));
+}
+
+static inline void interp_xor_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_number(a, val_2_integer(a) ^ val_2_integer(b));
+}
+
+static inline void interp_teq_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_boolean(a, *a == *b);
+}
+
+static inline void interp_tne_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_boolean(a, *a != *b);
+}
+
+static inline void interp_tgt_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_boolean(a, val_2_double(a) - val_2_double(b) > 0);
+}
+
+static inline void interp_tge_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_boolean(a, val_2_double(a) - val_2_double(b) >= 0);
+}
+
+static inline void interp_tlt_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_boolean(a, val_2_double(a) - val_2_double(b) < 0);
+}
+
+static inline void interp_tle_nn(env_t *env) {
+    val_t *b = env_stack_pop(env);
+    val_t *a = b + 1;
+
+    val_set_boolean(a, val_2_double(a) - val_2_double(b) <= 0);
+}
+
+static inline void interp_add_assign_nn(env_t *env) {
+    val_t *rht = env_stack_pop(env);
+    val_t *res = rht + 1;
+    uint8_t id, generation;
+    val_t *lft;
+
+    val_2_reference(res, &id, &generation);
+    if (NULL != (lft = env_get_ref(env, id, generation))) {
+        val_set_number(lft, val_2_double(lft) + val_2_double(rht));
+        *res = *lft;
+    } else {
+        env_set_error(env, ERR_InvalidLeftValue);
+    }
+}
+
+static inline void interp_sub_assign_nn(env_t *env) {
+    val_t *rht = env_stack_pop(env);
+    val_t *res = rht + 1;
+    uint8_t id, generation;
+    val_t *lft;
+
+    val_2_reference(res, &id, &generation);
+    if (NULL != (lft = env_get_ref(env, id, generation))) {
+        val_set_number(lft, val_2_double(lft) - val_2_double(rht));
+        *res = *lft;
+    } else {
+        env_set_error(env, ERR_InvalidLeftValue);
+    }
+}
+
+static inline void interp_store_var(env_t *env, val_t *lft) {
+    if (lft) {
+        *lft = *env_stack_peek(env);
+    } else {
+        env_set_error(env, ERR_InvalidLeftValue);
+    }
+}
+
+static inline void interp_store_var_pop(env_t *env, val_t *lft) {
+    if (lft) {
+        *lft = *env_stack_pop(env);
+    } else {
+        env_set_error(env, ERR_InvalidLeftValue);
+    }
+}
+
+static inline void interp_add_store_var(env_t *env, val_t *lft) {
+    val_t *rht = env_stack_peek(env);
+
+    if (lft) {
+        if (val_is_number(lft)) {
+            number_add(env, lft, rht, lft);
+        } else
+        if (val_is_string(lft)){
+            string_add(env, lft, rht, lft);
+        } else {
+            val_set_nan(lft);
+        }
+        env_stack_pop(env);
+    } else {
+        env_set_error(env, ERR_InvalidLeftValue);
+    }
+}
+
+static inline void interp_sub_store_var(env_t *env, val_t *lft) {
+    val_t *rht = env_stack_peek(env);
+
+    if (lft && val_is_number(lft)) {
+        number_sub(env, lft, rht, lft);
+        env_stack_pop(env);
+    } else {
+        env_set_error(env, ERR_InvalidLeftValue);
+    }
+}
+
+static inline void interp_add_store_var_nn(env_t *env, val_t *lft) {
+    val_t *rht = env_stack_pop(env);
+
+    if (lft) {
+        val_set_number(lft, val_2_double(lft) + val_2_double(rht));
+    } else {
+        env_set_error(env, ERR_InvalidLeftValue);
+    }
+}
+
+static inline void interp_sub_store_var_nn(env_t *env, val_t *lft) {
+    val_t *rht = env_stack_pop(env);
+
+    if (lft) {
+        val_set_number(lft, val_2_double(lft) - val_2_double(rht));
+    } else {
+        env_set_error(env, ERR_InvalidLeftValue);
+    }
+}
+
+static inline void interp_push_cell(env_t *env, val_t *v) {
+    if (v) {
+        *(env_stack_push(env)) = *v;
+    } else {
+        env_set_error(env, ERR_SysError);
+    }
+}
+
+static inline void interp_box_var(env_t *env, uint8_t id) {
+    scope_t *cell = env_scope_alloc(env, NULL, 1);
+
+    // Note: scope may be moved by gc, in alloc
+    if (cell) {
+        val_t *v = env->scope->var_buf + id;
+
+        cell->var_buf[0] = *v;
+        val_set_cell(v, (intptr_t) cell);
+    }
+}
+
+/*
+ * Foreach, map, filter & reduce are looped by interpreter, instead of
+ * reentrant of interp_run in native for each element. A native frame is
+ * built for the loop, with state in stack:
+ *   [index, max, callback, container, result, kind]
+ * and the callback return to BC_FOREACH_NEXT to step the loop.
+ */
+enum {
+    ITERATE_NONE = 0,
+    ITERATE_FOREACH,
+    ITERATE_MAP,
+    ITERATE_FILTER,
+    ITERATE_REDUCE,
+};
+
+#define ITERATE_STATE_SIZE  6
+#define ITERATE_STACK_HIGH  (ITERATE_STATE_SIZE + 4)
+
+static const uint8_t *interp_iterate(env_t *env, int kind, int ac, const uint8_t *pc);
+
+static inline int interp_iterate_kind(val_t *fn) {
+    intptr_t native = val_2_intptr(fn);
+
+    if (native == (intptr_t) array_foreach || native == (intptr_t) object_foreach || native == (intptr_t) map_foreach) {
+        return ITERATE_FOREACH;
+    } else
+    if (native == (intptr_t) array_map) {
+        return ITERATE_MAP;
+    } else
+    if (native == (intptr_t) array_filter) {
+        return ITERATE_FILTER;
+    } else
+    if (native == (intptr_t) array_reduce) {
+        return ITERATE_REDUCE;
+    } else {
+        return ITERATE_NONE;
+    }
+}
+
+static inline const uint8_t *interp_call(env_t *env, int ac, const uint8_t *pc) {
+    val_t *fn = env_stack_peek(env);
+    val_t *av = fn + 1;
+
+    if (val_is_script(fn)) {
+        return env_frame_setup(env, pc, fn, ac, av);
+    } else
+    if (val_is_native(fn)) {
+        int kind = interp_iterate_kind(fn);
+
+        if (kind) {
+            return interp_iterate(env, kind, ac, pc);
+        }
+        if (val_2_intptr(fn) == (intptr_t) generator_next && ac > 0 && val_is_generator(av)) {
+            return interp_generator_resume(env, (generator_t *)val_2_intptr(av), ac, pc, NULL);
+        }
+        env_native_call(env, fn, ac, av);
+    } else {
+        env_set_error(env, ERR_InvalidCallor);
+    }
+    return pc;
+}
+
+static const uint8_t interp_iterate_resume = BC_FOREACH_NEXT;
+
+static const uint8_t *interp_iterate_next(env_t *env)
+{
+    val_t *state = env_stack_peek(env);
+    val_t *self = state + 3;
+    val_t key, *value = NULL;
+    int i = val_2_integer(state);
+
+    val_set_undefined(&key);
+    if (i < val_2_integer(state + 1) && !env->error) {
+        if (val_is_array(self)) {
+            // Note: holes of sparse array are skipped, array may turn to sparse in callback
+            i = array_next((array_t *)val_2_intptr(self), i);
+            if (i >= 0 && i < val_2_integer(state + 1)) {
+                val_set_number(&key, i);
+                value = array_elem_ref((array_t *)val_2_intptr(self), i);
+            }
+        } else
+        if (val_is_map(self)) {
+            map_t *m = (map_t *)val_2_intptr(self);
+            int width = map_entry_width(m);
+
+            while (i < (int)m->entry_end && m->entries[i * width] == MAP_KEY_DELETED) {
+                i++;
+            }
+            if (i < (int)m->entry_end && i < val_2_integer(state + 1)) {
+                key = m->entries[i * width];
+                value = m->entries + i * width + width - 1;
+            }
+        } else {
+            object_t *o = (object_t *)val_2_intptr(self);
+
+            if (i < o->prop_num) {
+                key = val_mk_static_string(o->keys[i]);
+                value = o->vals + i;
+            }
+        }
+    }
+
+    if (value) {
+        int ac = 2;
+
+        val_set_number(state, i + 1);
+
+        env_push_call_argument(env, &key);
+        env_push_call_argument(env, value);
+        if (val_2_integer(state + 5) == ITERATE_REDUCE) {
+            env_push_call_argument(env, state + 4);
+            ac = 3;
+        }
+        env_push_call_function(env, state + 2);
+
+        return interp_call(env, ac, &interp_iterate_resume);
+    } else {
+        const uint8_t *pc;
+        val_t res = state[4];
+
+        env_frame_restore(env, &pc, &env->scope);
+        *env_stack_push(env) = res;
+
+        return pc;
+    }
+}
+
+static inline void interp_iterate_collect(env_t *env, val_t *res) {
+    val_t *state = env_stack_peek(env);
+    int kind = val_2_integer(state + 5);
+
+    // Note: result is popped, and copied before set, which may alloc
+    if (kind == ITERATE_MAP) {
+        val_t key = val_mk_number(val_2_integer(state) - 1), v = *res;
+
+        array_elem_set(env, state + 4, &key, &v);
+    } else
+    if (kind == ITERATE_FILTER) {
+        val_t *v = array_elem_ref((array_t *)val_2_intptr(state + 3), val_2_integer(state) - 1);
+
+        if (v && val_is_true(res)) {
+            val_t key = val_mk_number(array_length((array_t *)val_2_intptr(state + 4))), elem = *v;
+
+            array_elem_set(env, state + 4, &key, &elem);
+        }
+    } else
+    if (kind == ITERATE_REDUCE) {
+        state[4] = *res;
+    }
+}
+
+static const uint8_t *interp_iterate(env_t *env, int kind, int ac, const uint8_t *pc)
+{
+    val_t *fn = env_stack_peek(env);
+    val_t *av = fn + 1;
+    val_t self, callback, result, max;
+    int start = 0, n;
+
+    if (ac < 2 || !val_is_function(av + 1) || !(val_is_array(av) || (kind == ITERATE_FOREACH && (val_is_dictionary(av) || val_is_map(av))))) {
+        // let native handle it
+        env_native_call(env, fn, ac, av);
+        return pc;
+    }
+
+    if (val_is_array(av)) {
+        n = array_length((array_t *)val_2_intptr(av));
+    } else
+    if (val_is_map(av)) {
+        n = ((map_t *)val_2_intptr(av))->entry_end;
+    } else {
+        n = ((object_t *)val_2_intptr(av))->prop_num;
+    }
+
+    if (kind == ITERATE_MAP || kind == ITERATE_FILTER) {
+        array_t *r = kind == ITERATE_MAP ? array_alloc_mapped(env, av) : array_alloc(env, array_elem_num((array_t *)val_2_intptr(av)));
+
+        if (!r) {
+            return pc;
+        }
+        val_set_array(&result, (intptr_t) r);
+    } else
+    if (kind == ITERATE_REDUCE) {
+        array_t *a = (array_t *)val_2_intptr(av);
+        int first = array_next(a, 0);
+
+        if (ac > 2) {
+            result = av[2];
+        } else
+        if (first >= 0) {
+            result = *array_elem_ref(a, first);
+            start = first + 1;
+        } else {
+            val_set_undefined(&result);
+            start = n;
+        }
+    } else {
+        val_set_undefined(&result);
+    }
+
+    // Note: arguments may be moved by gc in alloc, and overwritten by frame
+    self = av[0];
+    callback = av[1];
+    val_set_number(&max, n);
+    if (env_frame_native(env, pc, ac, ITERATE_STACK_HIGH)) {
+        return pc;
+    }
+
+    val_set_number(env_stack_push(env), kind);
+    *env_stack_push(env) = result;
+    *env_stack_push(env) = self;
+    *env_stack_push(env) = callback;
+    *env_stack_push(env) = max;
+    val_set_number(env_stack_push(env), start);
+
+    return interp_iterate_next(env);
+}
+
+static inline const uint8_t *interp_tail_call(env_t *env, int ac, const uint8_t *pc) {
+    val_t *fn = env_stack_peek(env);
+
+    if (val_is_script(fn)) {
+        return env_frame_tail(env, pc, fn, ac, fn + 1);
+    } else {
+        return interp_call(env, ac, pc);
+    }
+}
+
+static inline void interp_array(env_t *env, int n) {
+    val_t *av = env_stack_peek(env);
+    intptr_t array = array_create(env, n, av);
+
+    if (array) {
+        val_set_array(env_stack_release(env, n - 1), array);
+    } else {
+        val_set_undefined(env_stack_release(env, n - 1));
+    }
+}
+
+static inline void interp_dict(env_t *env, int n) {
+    val_t *av = env_stack_peek(env);
+    intptr_t dict = object_create(env, n, av);
+
+    if (dict) {
+        val_set_dictionary(env_stack_release(env, n - 1), dict);
+    } else {
+        val_set_undefined(env_stack_release(env, n - 1));
+    }
+}
+
+static inline void interp_prop_self(env_t *env) {
+    val_t *key = env_stack_peek(env);
+    val_t *self = key + 1;
+    val_t *prop = key;
+
+    object_prop_get(env, self, key, prop);
+    // no pop
+}
+
+static inline void interp_prop_get(env_t *env) {
+    val_t *key = env_stack_peek(env); // keep the "key" in stack, defence GC
+    val_t *obj = key + 1;
+    val_t *res = obj;
+
+    object_prop_get(env, obj, key, res);
+    env_stack_pop(env);
+}
+
+static inline void interp_elem_self(env_t *env) {
+    val_t *key = env_stack_peek(env); // keey the "key" in stack
+    val_t *obj = key + 1;
+    val_t *res = key;
 
     object_elem_get(env, obj, key, res);
 }
@@ -767,83 +1621,298 @@ static inline void interp_elem_or_set(env_t *env) {
     env_stack_release(env, 2);
 }
 
-static inline void interp_prop_xor_set(env_t *env) {
-    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
-    val_t *key = val + 1;
-    val_t *obj = key + 1;
-    val_t *res = obj;
+static inline void interp_prop_xor_set(env_t *env) {
+    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
+    val_t *key = val + 1;
+    val_t *obj = key + 1;
+    val_t *res = obj;
+
+    object_prop_xor_set(env, obj, key, val, res);
+    env_stack_release(env, 2);
+}
+
+static inline void interp_elem_xor_set(env_t *env) {
+    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
+    val_t *key = val + 1;
+    val_t *obj = key + 1;
+    val_t *res = obj;
+
+    object_elem_xor_set(env, obj, key, val, res);
+    env_stack_release(env, 2);
+}
+
+static inline void interp_prop_lshift_set(env_t *env) {
+    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
+    val_t *key = val + 1;
+    val_t *obj = key + 1;
+    val_t *res = obj;
+
+    object_prop_lshift_set(env, obj, key, val, res);
+    env_stack_release(env, 2);
+}
+
+static inline void interp_elem_lshift_set(env_t *env) {
+    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
+    val_t *key = val + 1;
+    val_t *obj = key + 1;
+    val_t *res = obj;
+
+    object_elem_lshift_set(env, obj, key, val, res);
+    env_stack_release(env, 2);
+}
+
+static inline void interp_prop_rshift_set(env_t *env) {
+    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
+    val_t *key = val + 1;
+    val_t *obj = key + 1;
+    val_t *res = obj;
+
+    object_prop_rshift_set(env, obj, key, val, res);
+    env_stack_release(env, 2);
+}
+
+static inline void interp_elem_rshift_set(env_t *env) {
+    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
+    val_t *key = val + 1;
+    val_t *obj = key + 1;
+    val_t *res = obj;
+
+    object_elem_rshift_set(env, obj, key, val, res);
+    env_stack_release(env, 2);
+}
+
+static inline scope_t *interp_root_scope(env_t *env)
+{
+    scope_t *root = env->scope;
+
+    while (root->super) {
+        root = root->super;
+    }
+    return root;
+}
+
+/*
+ * Function captured nothing, the static function object is pushed,
+ * nothing is allocated.
+ */
+static inline
+void interp_push_function(env_t *env, unsigned int id)
+{
+    if (id >= env->exe.func_num) {
+        env_set_error(env, ERR_SysError);
+        return;
+    }
+
+    env_push_script(env, function_static(env, id, interp_root_scope(env)));
+}
+
+/*
+ * Create closure, captured variables are copied to its upvalue scope,
+ * the super of upvalue scope is the root scope.
+ * Return the address of next instruction.
+ */
+static const uint8_t *interp_push_closure(env_t *env, unsigned int id, const uint8_t *pc)
+{
+    scope_t *upv;
+    function_t *fn;
+    intptr_t f;
+    int i, n = *pc++;
+
+    if (id >= env->exe.func_num) {
+        env_set_error(env, ERR_SysError);
+        return pc + n * 2;
+    }
+
+    if (0 == (f = function_create(env, env->exe.func_map[id]))) {
+        env_set_error(env, ERR_SysError);
+        return pc + n * 2;
+    }
+    env_push_script(env, f);
+
+    // Note: function in stack & scope may be moved by gc, in alloc
+    if (NULL == (upv = env_scope_alloc(env, NULL, n))) {
+        return pc;
+    }
+    upv->super = interp_root_scope(env);
+
+    for (i = 0; i < n; i++, pc += 2) {
+        val_t *v = env_get_var(env, pc[0], pc[1]);
+
+        if (!v) {
+            env_set_error(env, ERR_SysError);
+            return pc;
+        }
+        upv->var_buf[i] = *v;
+    }
+
+    fn = (function_t *) val_2_intptr(env_stack_peek(env));
+    fn->super = upv;
+
+    return pc;
+}
+
+/*
+ * Runtime quickening
+ * Generic instruction is rewritten in place, once it observe the operands
+ * it can be specialised. The specialised one check its guard, and rewrite
+ * itself back to the generic one if failed.
+ */
+static inline void interp_quicken(env_t *env, const uint8_t *pc, uint8_t code) {
+    if (env->quicken) {
+        *((uint8_t *)pc) = code;
+    }
+}
+
+static inline void interp_quicken_number(env_t *env, const uint8_t *pc, uint8_t code) {
+    val_t *b = env_stack_peek(env);
+
+    if (val_is_number(b) && val_is_number(b + 1)) {
+        interp_quicken(env, pc, code);
+    }
+}
+
+static inline void interp_add_num(env_t *env, const uint8_t *pc) {
+    val_t *b = env_stack_peek(env);
+    val_t *a = b + 1;
+
+    if (val_is_number(a) && val_is_number(b)) {
+        val_set_number(a, val_2_double(a) + val_2_double(b));
+        env_stack_pop(env);
+    } else {
+        interp_quicken(env, pc, BC_ADD);
+        interp_add(env);
+    }
+}
+
+static inline void interp_sub_num(env_t *env, const uint8_t *pc) {
+    val_t *b = env_stack_peek(env);
+    val_t *a = b + 1;
+
+    if (val_is_number(a) && val_is_number(b)) {
+        val_set_number(a, val_2_double(a) - val_2_double(b));
+        env_stack_pop(env);
+    } else {
+        interp_quicken(env, pc, BC_SUB);
+        interp_sub(env);
+    }
+}
+
+static inline void interp_elem_get_generic(env_t *env, const uint8_t *pc) {
+    val_t *key = env_stack_peek(env);
+
+    if (val_is_number(key) && val_is_array(key + 1)) {
+        interp_quicken(env, pc, BC_ELEM_ARRAY);
+    }
+    interp_elem_get(env);
+}
+
+static inline void interp_elem_get_array(env_t *env, const uint8_t *pc) {
+    val_t *key = env_stack_peek(env);
+    val_t *obj = key + 1;
+
+    if (val_is_number(key) && val_is_array(obj)) {
+        val_t *elem = array_elem_ref((array_t *)val_2_intptr(obj), val_2_integer(key));
+
+        if (elem) {
+            *obj = *elem;
+        } else {
+            val_set_undefined(obj);
+        }
+        env_stack_pop(env);
+    } else {
+        interp_quicken(env, pc, BC_ELEM);
+        interp_elem_get(env);
+    }
+}
+
+static inline prop_cache_t *interp_prop_cache(env_t *env, const uint8_t *pc) {
+    return env->prop_cache + (((intptr_t)pc) & (DEF_PROP_CACHE_SIZE - 1));
+}
+
+/*
+ * Get owned property of dictionary, and record it in cache.
+ * The key of computed string is not cached, its address may be reused.
+ */
+static inline int interp_prop_cache_fill(env_t *env, const uint8_t *pc, val_t *obj, val_t *key, val_t *res) {
+    prop_cache_t *cache;
+    intptr_t symbal;
+    int index;
+
+    if (!env->quicken || val_is_owned_string(key)) {
+        return 0;
+    }
 
-    object_prop_xor_set(env, obj, key, val, res);
-    env_stack_release(env, 2);
-}
+    if (0 > (index = object_prop_index(env, obj, key, &symbal))) {
+        return 0;
+    }
 
-static inline void interp_elem_xor_set(env_t *env) {
-    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
-    val_t *key = val + 1;
-    val_t *obj = key + 1;
-    val_t *res = obj;
+    cache = interp_prop_cache(env, pc);
+    cache->pc = pc;
+    cache->key = *key;
+    cache->symbal = symbal;
+    cache->index = index;
 
-    object_elem_xor_set(env, obj, key, val, res);
-    env_stack_release(env, 2);
+    *res = ((object_t *)val_2_intptr(obj))->vals[index];
+    return 1;
 }
 
-static inline void interp_prop_lshift_set(env_t *env) {
-    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
-    val_t *key = val + 1;
-    val_t *obj = key + 1;
-    val_t *res = obj;
+static inline val_t *interp_prop_cache_lookup(env_t *env, const uint8_t *pc, val_t *obj, val_t *key) {
+    prop_cache_t *cache = interp_prop_cache(env, pc);
 
-    object_prop_lshift_set(env, obj, key, val, res);
-    env_stack_release(env, 2);
+    if (cache->pc == pc && cache->key == *key && val_is_dictionary(obj)) {
+        return object_prop_at(obj, cache->index, cache->symbal);
+    } else {
+        return NULL;
+    }
 }
 
-static inline void interp_elem_lshift_set(env_t *env) {
-    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
-    val_t *key = val + 1;
+static inline void interp_prop_get_generic(env_t *env, const uint8_t *pc) {
+    val_t *key = env_stack_peek(env);
     val_t *obj = key + 1;
-    val_t *res = obj;
 
-    object_elem_lshift_set(env, obj, key, val, res);
-    env_stack_release(env, 2);
+    if (interp_prop_cache_fill(env, pc, obj, key, obj)) {
+        interp_quicken(env, pc, BC_PROP_CACHE);
+        env_stack_pop(env);
+    } else {
+        interp_prop_get(env);
+    }
 }
 
-static inline void interp_prop_rshift_set(env_t *env) {
-    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
-    val_t *key = val + 1;
+static inline void interp_prop_self_generic(env_t *env, const uint8_t *pc) {
+    val_t *key = env_stack_peek(env);
     val_t *obj = key + 1;
-    val_t *res = obj;
 
-    object_prop_rshift_set(env, obj, key, val, res);
-    env_stack_release(env, 2);
+    if (interp_prop_cache_fill(env, pc, obj, key, key)) {
+        interp_quicken(env, pc, BC_PROP_METH_CACHE);
+    } else {
+        interp_prop_self(env);
+    }
 }
 
-static inline void interp_elem_rshift_set(env_t *env) {
-    val_t *val = env_stack_peek(env); // keep the "key" in stack, defence GC
-    val_t *key = val + 1;
+static inline void interp_prop_get_cached(env_t *env, const uint8_t *pc) {
+    val_t *key = env_stack_peek(env);
     val_t *obj = key + 1;
-    val_t *res = obj;
+    val_t *prop = interp_prop_cache_lookup(env, pc, obj, key);
 
-    object_elem_rshift_set(env, obj, key, val, res);
-    env_stack_release(env, 2);
+    if (prop) {
+        *obj = *prop;
+        env_stack_pop(env);
+    } else {
+        interp_quicken(env, pc, BC_PROP);
+        interp_prop_get_generic(env, pc);
+    }
 }
 
-static inline
-void interp_push_function(env_t *env, unsigned int id)
-{
-    uint8_t *entry;
-    intptr_t fn;
-
-    if (id >= env->exe.func_num) {
-        env_set_error(env, ERR_SysError);
-        return;
-    }
+static inline void interp_prop_self_cached(env_t *env, const uint8_t *pc) {
+    val_t *key = env_stack_peek(env);
+    val_t *obj = key + 1;
+    val_t *prop = interp_prop_cache_lookup(env, pc, obj, key);
 
-    entry = env->exe.func_map[id];
-    fn = function_create(env, entry);
-    if (0 == fn) {
-        env_set_error(env, ERR_SysError);
+    if (prop) {
+        *key = *prop;
     } else {
-        env_push_script(env, fn);
+        interp_quicken(env, pc, BC_PROP_METH);
+        interp_prop_self_generic(env, pc);
     }
 }
 
@@ -866,10 +1935,132 @@ static inline void interp_show(const uint8_t *pc, int sp) {
 }
 #endif
 
+/*
+ * Errors could be caught by try statement, except the fatal ones and
+ * the interrupt.
+ */
+static inline int interp_error_catchable(int error) {
+    return error == ERR_NotEnoughMemory || error == ERR_StackOverflow ||
+           error == ERR_ResourceOutLimit || error > ERR_InvalidByteCode;
+}
+
+// entry of function, which the instruction before pc belong to
+static const uint8_t *interp_func_entry(env_t *env, const uint8_t *pc)
+{
+    executable_t *exe = &env->exe;
+    int i;
+
+    for (i = 0; i < exe->func_num; i++) {
+        const uint8_t *entry = exe->func_map[i];
+        const uint8_t *code = executable_func_get_code(entry);
+
+        if (pc > code && pc <= code + executable_func_get_code_size(entry)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Search the handler of error, from the instruction raised it, to the
+ * callers: in the handler table of each function. The frames passed are
+ * released, and the stack is restored to the depth of handler, then the
+ * error value (thrown value, or the error code) is pushed.
+ * Nothing is done for try statement, until the error raised.
+ *
+ * Unwind stop at the callback of native (interp_execute_call), the error
+ * is returned to native, and raised again by the native call.
+ *
+ * return: address of handler, or NULL if not caught.
+ */
+static const uint8_t *interp_unwind(env_t *env, const uint8_t *pc)
+{
+    if (!interp_error_catchable(env->error)) {
+        return NULL;
+    }
+
+    while (pc) {
+        const uint8_t *entry = interp_func_entry(env, pc);
+
+        if (entry) {
+            const uint8_t *code = executable_func_get_code(entry);
+            int handler, depth;
+
+            handler = executable_func_handler(entry, pc - 1 - code, &depth);
+            if (handler >= 0) {
+                env->sp = env->fp - depth;
+                if (env->error == ERR_Exception) {
+                    *env_stack_push(env) = env->except;
+                    val_set_undefined(&env->except);
+                } else {
+                    val_set_number(env_stack_push(env), env->error);
+                }
+                env->error = 0;
+
+                return code + handler;
+            }
+
+            // generator raised the error is finished, if it was started
+            if (code[0] == BC_GEN_START && pc > code + 1) {
+                interp_generator_finish(interp_generator_self(env));
+            } else
+            if (code[0] == BC_ASYNC && pc > code + 1) {
+                return interp_async_reject(env);
+            }
+        } else
+        if (pc != &interp_iterate_resume) {
+            return NULL;
+        }
+
+        if (env->fp == env->ss) {
+            return NULL;
+        }
+        env_frame_restore(env, &pc, &env->scope);
+    }
+
+    return NULL;
+}
+
+/*
+ * Poll the interrupt and spend the budget, at backward jump and call only,
+ * straight-line code pays nothing. The run nested by native callback
+ * (interp_execute_call) could not be paused, it's paused at the next check
+ * after return.
+ * return: 1 if the budget run out, and the run should be paused
+ */
+static inline int interp_poll(env_t *env)
+{
+    if (atomic_load_explicit(&env->interrupt, memory_order_relaxed) &&
+        atomic_exchange_explicit(&env->interrupt, 0, memory_order_relaxed)) {
+        env_set_error(env, ERR_Interrupted);
+        return 0;
+    }
+
+    if (env->budget > 0 && --env->budget == 0) {
+        if (!env->nest) {
+            return 1;
+        }
+        env->budget = 1;
+    }
+    return 0;
+}
+
+#define INTERP_JUMP(index)  \
+    do {                                                                \
+        pc += (index);                                                  \
+        if ((index) < 0 && interp_poll(env)) goto DO_YIELD;             \
+    } while (0)
+
+#define INTERP_CALL_CHECK() \
+    do {                                                                \
+        if (!env->error && interp_poll(env)) goto DO_YIELD;             \
+    } while (0)
+
 static int interp_run(env_t *env, const uint8_t *pc)
 {
     int     index;
 
+DO_RUN:
     while(!env->error) {
         uint8_t code;
 
@@ -894,52 +2085,118 @@ static int interp_run(env_t *env, const uint8_t *pc)
                             break;
 
         /* Jump instruction */
-        case BC_SJMP:       index = (int8_t) (*pc++); pc += index;
+        case BC_SJMP:       index = (int8_t) (*pc++); INTERP_JUMP(index);
                             break;
 
-        case BC_JMP:        index = (int8_t) (*pc++); index = (index << 8) | (*pc++); pc += index;
+        case BC_JMP:        index = (int8_t) (*pc++); index = (index << 8) | (*pc++); INTERP_JUMP(index);
                             break;
 
         case BC_SJMP_T:     index = (int8_t) (*pc++);
                             if (val_is_true(env_stack_peek(env))) {
-                                pc += index;
+                                INTERP_JUMP(index);
                             }
                             break;
 
         case BC_SJMP_F:     index = (int8_t) (*pc++);
                             if (!val_is_true(env_stack_peek(env))) {
-                                pc += index;
+                                INTERP_JUMP(index);
                             }
                             break;
 
         case BC_JMP_T:      index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
                             if (val_is_true(env_stack_peek(env))) {
-                                pc += index;
+                                INTERP_JUMP(index);
                             }
                             break;
         case BC_JMP_F:      index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
                             if (!val_is_true(env_stack_peek(env))) {
-                                pc += index;
+                                INTERP_JUMP(index);
                             }
                             break;
         case BC_POP_SJMP_T: index = (int8_t) (*pc++);
                             if (val_is_true(env_stack_pop(env))) {
-                                pc += index;
+                                INTERP_JUMP(index);
                             }
                             break;
         case BC_POP_SJMP_F: index = (int8_t) (*pc++);
                             if (!val_is_true(env_stack_pop(env))) {
-                                pc += index;
+                                INTERP_JUMP(index);
                             }
                             break;
         case BC_POP_JMP_T:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
                             if (val_is_true(env_stack_pop(env))) {
-                                pc += index;
+                                INTERP_JUMP(index);
                             }
                             break;
         case BC_POP_JMP_F:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
                             if (!val_is_true(env_stack_pop(env))) {
-                                pc += index;
+                                INTERP_JUMP(index);
+                            }
+                            break;
+
+        case BC_TEQ_SJMP_F: index = (int8_t) (*pc++);
+                            if (!interp_pop_teq(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+        case BC_TEQ_JMP_F:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
+                            if (!interp_pop_teq(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+
+        case BC_TNE_SJMP_F: index = (int8_t) (*pc++);
+                            if (!interp_pop_tne(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+        case BC_TNE_JMP_F:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
+                            if (!interp_pop_tne(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+
+        case BC_TGT_SJMP_F: index = (int8_t) (*pc++);
+                            if (!interp_pop_tgt(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+        case BC_TGT_JMP_F:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
+                            if (!interp_pop_tgt(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+
+        case BC_TGE_SJMP_F: index = (int8_t) (*pc++);
+                            if (!interp_pop_tge(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+        case BC_TGE_JMP_F:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
+                            if (!interp_pop_tge(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+
+        case BC_TLT_SJMP_F: index = (int8_t) (*pc++);
+                            if (!interp_pop_tlt(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+        case BC_TLT_JMP_F:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
+                            if (!interp_pop_tlt(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+
+        case BC_TLE_SJMP_F: index = (int8_t) (*pc++);
+                            if (!interp_pop_tle(env)) {
+                                INTERP_JUMP(index);
+                            }
+                            break;
+        case BC_TLE_JMP_F:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
+                            if (!interp_pop_tle(env)) {
+                                INTERP_JUMP(index);
                             }
                             break;
 
@@ -981,8 +2238,10 @@ static int interp_run(env_t *env, const uint8_t *pc)
         case BC_MUL:        interp_mul(env); break;
         case BC_DIV:        interp_div(env); break;
         case BC_MOD:        interp_mod(env); break;
-        case BC_ADD:        interp_add(env); break;
-        case BC_SUB:        interp_sub(env); break;
+        case BC_ADD:        interp_quicken_number(env, pc - 1, BC_ADD_NUM);
+                            interp_add(env); break;
+        case BC_SUB:        interp_quicken_number(env, pc - 1, BC_SUB_NUM);
+                            interp_sub(env); break;
 
         case BC_AAND:       interp_and(env); break;
         case BC_AOR:        interp_or(env);  break;
@@ -998,11 +2257,11 @@ static int interp_run(env_t *env, const uint8_t *pc)
         case BC_TLT:        interp_tlt(env); break;
         case BC_TLE:        interp_tle(env); break;
 
-        case BC_TIN:        env_set_error(env, ERR_InvalidByteCode); break;
+        case BC_TIN:        interp_tin(env); break;
 
-        case BC_PROP:       interp_prop_get(env);  break;
-        case BC_PROP_METH:  interp_prop_self(env); break;
-        case BC_ELEM:       interp_elem_get(env);  break;
+        case BC_PROP:       interp_prop_get_generic(env, pc - 1);  break;
+        case BC_PROP_METH:  interp_prop_self_generic(env, pc - 1); break;
+        case BC_ELEM:       interp_elem_get_generic(env, pc - 1);  break;
         case BC_ELEM_METH:  interp_elem_self(env); break;
 
         case BC_ASSIGN:     interp_assign(env); break;
@@ -1043,19 +2302,133 @@ static int interp_run(env_t *env, const uint8_t *pc)
 
         case BC_FUNC_CALL:  index = *pc++;
                             pc = interp_call(env, index, pc);
+                            INTERP_CALL_CHECK();
+                            break;
+
+        case BC_TAIL_CALL:  index = *pc++;
+                            pc = interp_tail_call(env, index, pc);
+                            INTERP_CALL_CHECK();
+                            break;
+
+        case BC_CALL0:      pc = interp_call(env, 0, pc); INTERP_CALL_CHECK(); break;
+        case BC_CALL1:      pc = interp_call(env, 1, pc); INTERP_CALL_CHECK(); break;
+        case BC_CALL2:      pc = interp_call(env, 2, pc); INTERP_CALL_CHECK(); break;
+        case BC_CALL3:      pc = interp_call(env, 3, pc); INTERP_CALL_CHECK(); break;
+
+        case BC_FOREACH_NEXT: interp_iterate_collect(env, env_stack_pop(env));
+                            pc = interp_iterate_next(env);
+                            INTERP_CALL_CHECK();
+                            break;
+
+        case BC_FOR_RANGE_SJMP: index = (int8_t) (*pc++);
+                            if (!interp_for_range(env)) {
+                                pc += index;
+                            }
+                            break;
+        case BC_FOR_RANGE_JMP:  index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
+                            if (!interp_for_range(env)) {
+                                pc += index;
+                            }
+                            break;
+
+        case BC_FOR_EACH_SJMP:  index = (int8_t) (*pc++);
+                            pc = interp_for_each(env, pc, index);
+                            break;
+        case BC_FOR_EACH_JMP:   index = (int8_t) (*pc++); index = (index << 8) | (*pc++);
+                            pc = interp_for_each(env, pc, index);
                             break;
 
+        case BC_SWITCH_TABLE:   pc = interp_switch_table(env, pc); break;
+        case BC_SWITCH_NUM:     pc = interp_switch_search(env, pc, 0); break;
+        case BC_SWITCH_STR:     pc = interp_switch_search(env, pc, 1); break;
+
         case BC_ARRAY:      index = (*pc++); index = (index << 8) | (*pc++);
                             interp_array(env, index); break;
 
         case BC_DICT:       index = (*pc++); index = (index << 8) | (*pc++);
                             interp_dict(env, index); break;
 
+        case BC_MUL_NN:     interp_mul_nn(env); break;
+        case BC_DIV_NN:     interp_div_nn(env); break;
+        case BC_MOD_NN:     interp_mod_nn(env); break;
+        case BC_ADD_NN:     interp_add_nn(env); break;
+        case BC_SUB_NN:     interp_sub_nn(env); break;
+        case BC_LSHIFT_NN:  interp_lshift_nn(env); break;
+        case BC_RSHIFT_NN:  interp_rshift_nn(env); break;
+        case BC_AAND_NN:    interp_and_nn(env); break;
+        case BC_AOR_NN:     interp_or_nn(env); break;
+        case BC_AXOR_NN:    interp_xor_nn(env); break;
+
+        case BC_TEQ_NN:     interp_teq_nn(env); break;
+        case BC_TNE_NN:     interp_tne_nn(env); break;
+        case BC_TGT_NN:     interp_tgt_nn(env); break;
+        case BC_TGE_NN:     interp_tge_nn(env); break;
+        case BC_TLT_NN:     interp_tlt_nn(env); break;
+        case BC_TLE_NN:     interp_tle_nn(env); break;
+
+        case BC_ADD_ASSIGN_NN: interp_add_assign_nn(env); break;
+        case BC_SUB_ASSIGN_NN: interp_sub_assign_nn(env); break;
+
+        case BC_STORE_VAR:  index = (*pc++); interp_store_var(env, env_get_var(env, index, *pc++));
+                            break;
+        case BC_STORE_VAR_POP:      index = (*pc++); interp_store_var_pop(env, env_get_var(env, index, *pc++));
+                                    break;
+        case BC_ADD_STORE_VAR:      index = (*pc++); interp_add_store_var(env, env_get_var(env, index, *pc++));
+                                    break;
+        case BC_SUB_STORE_VAR:      index = (*pc++); interp_sub_store_var(env, env_get_var(env, index, *pc++));
+                                    break;
+        case BC_ADD_STORE_VAR_NN:   index = (*pc++); interp_add_store_var_nn(env, env_get_var(env, index, *pc++));
+                                    break;
+        case BC_SUB_STORE_VAR_NN:   index = (*pc++); interp_sub_store_var_nn(env, env_get_var(env, index, *pc++));
+                                    break;
+
+        case BC_PUSH_CLOSURE:       index = (*pc++); index = (index << 8) | (*pc++);
+                                    pc = interp_push_closure(env, index, pc);
+                                    break;
+        case BC_BOX_VAR:            interp_box_var(env, *pc++);
+                                    break;
+        case BC_PUSH_CELL:          index = (*pc++); interp_push_cell(env, env_get_cell(env, index, *pc++));
+                                    break;
+        case BC_STORE_CELL:         index = (*pc++); interp_store_var(env, env_get_cell(env, index, *pc++));
+                                    break;
+        case BC_STORE_CELL_POP:     index = (*pc++); interp_store_var_pop(env, env_get_cell(env, index, *pc++));
+                                    break;
+        case BC_ADD_STORE_CELL:     index = (*pc++); interp_add_store_var(env, env_get_cell(env, index, *pc++));
+                                    break;
+        case BC_SUB_STORE_CELL:     index = (*pc++); interp_sub_store_var(env, env_get_cell(env, index, *pc++));
+                                    break;
+
+        case BC_ADD_NUM:    interp_add_num(env, pc - 1); break;
+        case BC_SUB_NUM:    interp_sub_num(env, pc - 1); break;
+        case BC_ELEM_ARRAY: interp_elem_get_array(env, pc - 1); break;
+        case BC_PROP_CACHE: interp_prop_get_cached(env, pc - 1); break;
+        case BC_PROP_METH_CACHE: interp_prop_self_cached(env, pc - 1); break;
+
+        case BC_THROW:      env->except = *env_stack_pop(env);
+                            env_set_error(env, ERR_Exception);
+                            break;
+
+        case BC_GEN_START:  pc = interp_generator_start(env, pc); break;
+        case BC_YIELD:      pc = interp_generator_yield(env, pc); break;
+        case BC_GEN_RET:    pc = interp_generator_return(env, pc); break;
+        case BC_ASYNC:      pc = interp_async_start(env, pc); break;
+        case BC_AWAIT:      pc = interp_async_await(env, pc); break;
+
         default:            env_set_error(env, ERR_InvalidByteCode);
         }
     }
+
+    // go on from the handler, if the error is caught
+    if (NULL != (pc = interp_unwind(env, pc))) {
+        goto DO_RUN;
+    }
 DO_END:
     return -env->error;
+
+DO_YIELD:
+    // pc, sp, fp and scope are kept in env, see interp_resume
+    env->resume = pc;
+    return INTERP_YIELD;
 }
 
 static void parse_callback(void *u, parse_event_t *e)
@@ -1113,13 +2486,19 @@ int interp_env_init_interpreter(env_t *env, void *mem_ptr, int mem_size, void *h
 int interp_env_init_image(env_t *env, void *mem_ptr, int mem_size, void *heap_ptr, int heap_size, val_t *stack_ptr, int stack_size, image_info_t *image)
 {
     unsigned int i;
-    int exe_mem_size, exe_str_max, exe_fn_max;
+    int exe_mem_size, exe_str_max, exe_fn_max, exe_code_size;
     executable_t *exe;
 
     if (!image || image->byte_order != SYS_BYTE_ORDER) {
         return -1;
     }
 
+    // space to copy code of image, then it could be quickened
+    exe_code_size = 0;
+    for (i = 0; i < image->fn_cnt; i++) {
+        exe_code_size += FUNC_HEAD_SIZE + executable_func_get_code_size(image_get_function(image, i));
+    }
+
     exe_mem_size = mem_size - heap_size - stack_size * sizeof(val_t);
     if (env_exe_memery_calc(exe_mem_size, NULL, &exe_str_max, &exe_fn_max, NULL)) {
         return -ERR_NotEnoughMemory;
@@ -1132,7 +2511,11 @@ int interp_env_init_image(env_t *env, void *mem_ptr, int mem_size, void *heap_pt
         exe_fn_max = image->fn_cnt;
     }
 
+    // Run the code of image in place, if not enough memory to copy it
     if (0 != env_init(env, mem_ptr, mem_size,
+                    heap_ptr, heap_size, stack_ptr, stack_size,
+                    0, exe_str_max, exe_fn_max, 0, exe_code_size, 0) &&
+        0 != env_init(env, mem_ptr, mem_size,
                     heap_ptr, heap_size, stack_ptr, stack_size,
                     0, exe_str_max, exe_fn_max, 0, 0, 0)) {
         return -1;
@@ -1149,8 +2532,19 @@ int interp_env_init_image(env_t *env, void *mem_ptr, int mem_size, void *heap_pt
 
     exe->func_num = image->fn_cnt;
     for (i = 0; i < image->fn_cnt; i++) {
-        exe->func_map[i] = (uint8_t *)image_get_function(image, i);
+        const uint8_t *entry = image_get_function(image, i);
+
+        if (exe->func_code_max) {
+            int size = FUNC_HEAD_SIZE + executable_func_get_code_size(entry);
+
+            memcpy(exe->func_code + exe->func_code_end, entry, size);
+            exe->func_map[i] = exe->func_code + exe->func_code_end;
+            exe->func_code_end += size;
+        } else {
+            exe->func_map[i] = (uint8_t *)entry;
+        }
     }
+    env->quicken = exe->func_code_max > 0;
 
     return 0;
 }
@@ -1160,10 +2554,18 @@ val_t interp_execute_call(env_t *env, int ac)
     uint8_t stop = BC_STOP;
     const uint8_t *pc;
 
+    // error raised by the last callback, release the arguments & function
+    if (env->error) {
+        env->sp += ac + 1;
+        return val_mk_undefined();
+    }
+
     pc = interp_call(env, ac, &stop);
     if (pc != &stop) {
         // call a script function
+        env->nest++;
         interp_run(env, pc);
+        env->nest--;
     }
 
     if (env->error) {
@@ -1173,15 +2575,129 @@ val_t interp_execute_call(env_t *env, int ac)
     }
 }
 
-int interp_execute_image(env_t *env, val_t **v)
+// release the frames of execution, back to main
+static void interp_release_frames(env_t *env)
 {
+    const uint8_t *pc;
 
-    if (!env || !v) {
+    while (env->fp != env->ss) {
+        env_frame_restore(env, &pc, &env->scope);
+    }
+    env->sp = env->fp;
+}
+
+/*
+ * Resume the async frames in the ready queue one by one, in a frame built
+ * on the stack top, as called by native. Each of them run until it is
+ * finished, or wait for another future pending.
+ */
+static int interp_async_run(env_t *env)
+{
+    uint8_t stop = BC_STOP;
+    int fp = env->fp, sp = env->sp;
+
+    while (env->ready && !env->error) {
+        generator_t *g = env->ready;
+        future_t *f = g->await;
+        const uint8_t *pc;
+
+        env->ready = g->next;
+        if (!env->ready) {
+            env->ready_tail = NULL;
+        }
+        g->next = NULL;
+        g->await = NULL;
+
+        // in place of function, the future of result is left
+        env_push_undefined(env);
+        pc = interp_generator_resume(env, g, 0, &stop, NULL);
+        if (pc != &stop) {
+            interp_async_result(env, f);
+        }
+
+        env->nest++;
+        interp_run(env, pc);
+        env->nest--;
+
+        if (env->error) {
+            // the frames not unwound are released
+            while (env->fp != fp) {
+                env_frame_restore(env, &pc, &env->scope);
+            }
+            env->sp = sp;
+        } else {
+            env->sp++;
+        }
+    }
+
+    if (env->error == ERR_Interrupted && !env->nest) {
+        // stop clean, as interp_execute_main
+        val_set_undefined(&env->except);
+        env->error = 0;
+        return -ERR_Interrupted;
+    }
+
+    return -env->error;
+}
+
+static int interp_future_settle(env_t *env, val_t *future, int error, val_t *value)
+{
+    future_t *f;
+
+    if (!env || !future || !val_is_future(future)) {
+        return -ERR_InvalidInput;
+    }
+
+    f = (future_t *)val_2_intptr(future);
+    if (f->state != FUTURE_PENDING) {
+        return -ERR_InvalidInput;
+    }
+    future_settle(env, f, error, value);
+
+    return interp_async_run(env);
+}
+
+int interp_future_resolve(env_t *env, val_t *future, val_t *value)
+{
+    return interp_future_settle(env, future, 0, value);
+}
+
+int interp_future_reject(env_t *env, val_t *future, int error)
+{
+    if (error <= 0) {
         return -ERR_InvalidInput;
     }
 
-    if (0 != interp_run(env, env_main_entry_setup(env, 0, NULL))) {
-        return -env->error;
+    return interp_future_settle(env, future, error, NULL);
+}
+
+/*
+ * Run the main code, or go on with the paused one if pc is given, with
+ * the budget of slice.
+ * return: 0 if finished, INTERP_YIELD if paused or -error
+ */
+static int interp_execute_main(env_t *env, const uint8_t *pc, val_t **v)
+{
+    int ret;
+
+    if (!pc) {
+        if (env->resume) {
+            // the paused execution is abandoned
+            interp_release_frames(env);
+        }
+        pc = env_main_entry_setup(env, 0, NULL);
+    }
+
+    env->budget = env->budget_slice;
+    env->resume = NULL;
+    if (0 != (ret = interp_run(env, pc))) {
+        if (ret == -ERR_Interrupted) {
+            // stop clean, env is reusable for the next execution
+            interp_release_frames(env);
+            val_set_undefined(&env->except);
+            env->error = 0;
+        }
+        return ret;
     }
 
     if (env->fp > env->sp) {
@@ -1193,12 +2709,41 @@ int interp_execute_image(env_t *env, val_t **v)
     return 0;
 }
 
+int interp_execute_image(env_t *env, val_t **v)
+{
+
+    if (!env || !v) {
+        return -ERR_InvalidInput;
+    }
+
+    return interp_execute_main(env, NULL, v);
+}
+
+int interp_resume(env_t *env, val_t **v)
+{
+    int ret;
+
+    if (!env || !v || !env->resume) {
+        return -ERR_InvalidInput;
+    }
+
+    // finished as interp_execute_string does
+    ret = interp_execute_main(env, env->resume, v);
+    return ret ? ret : 1;
+}
+
+void interp_budget_set(env_t *env, int slice)
+{
+    env->budget_slice = slice > 0 ? slice : 0;
+}
+
 int interp_execute_string(env_t *env, const char *input, val_t **v)
 {
     stmt_t *stmt;
     heap_t *heap = env_heap_get_free((env_t*)env);
     parser_t psr;
     compile_t cpl;
+    int ret;
 
     if (!env || !input || !v) {
         return -1;
@@ -1215,21 +2760,15 @@ int interp_execute_string(env_t *env, const char *input, val_t **v)
 
     compile_init(&cpl, env, heap_free_addr(&psr.heap), heap_free_size(&psr.heap));
     if (0 == compile_multi_stmt(&cpl, stmt) && 0 == compile_update(&cpl)) {
-        if (0 != interp_run(env, env_main_entry_setup(env, 0, NULL))) {
+        if (0 != (ret = interp_execute_main(env, NULL, v))) {
             //printf("execute error: %d\n", env->error);
-            return -env->error;
+            return ret;
         }
     } else {
         //printf("cmpile error: %d\n", cpl.error);
         return -cpl.error;
     }
 
-    if (env->fp > env->sp) {
-        *v = env_stack_pop(env);
-    } else {
-        *v = &undefined;
-    }
-
     return 1;
 }
 
@@ -1239,6 +2778,7 @@ int interp_execute_interactive(env_t *env, const char *input, char *(*input_more
     parser_t psr;
     compile_t cpl;
     heap_t *heap = env_heap_get_free((env_t*)env);
+    int ret;
 
     if (!env || !input || !v) {
         return -1;
@@ -1254,19 +2794,13 @@ int interp_execute_interactive(env_t *env, const char *input, char *(*input_more
 
     compile_init(&cpl, env, heap_free_addr(&psr.heap), heap_free_size(&psr.heap));
     if (0 == compile_one_stmt(&cpl, stmt) && 0 == compile_update(&cpl)) {
-        if (0 != interp_run(env, env_main_entry_setup(env, 0, NULL))) {
-            return -env->error;
+        if (0 != (ret = interp_execute_main(env, NULL, v))) {
+            return ret;
         }
     } else {
         return -cpl.error;
     }
 
-    if (env->fp > env->sp) {
-        *v = env_stack_pop(env);
-    } else {
-        *v = &undefined;
-    }
-
     return 1;
 }
 
@@ -35,11 +35,35 @@ int interp_env_init_interactive(env_t *env, void *mem_ptr, int mem_size, void *h
 int interp_env_init_interpreter(env_t *env, void *mem_ptr, int mem_size, void *heap_ptr, int heap_size, val_t *stack_ptr, int stack_size);
 int interp_env_init_image(env_t *env, void *mem_ptr, int mem_size, void *heap_ptr, int heap_size, val_t *stack_ptr, int stack_size, image_info_t *image);
 
+/*
+ * Execution is paused when the budget of slice run out, and return
+ * INTERP_YIELD. It could be continued by interp_resume, or abandoned
+ * by a new execution.
+ * Finished execution of source and interp_resume return 1 with the result
+ * in *v, 0 if no statement in source; interp_execute_image return 0.
+ * So check INTERP_YIELD before take a positive return as result.
+ */
+#define INTERP_YIELD    2
+
 int interp_execute_interactive(env_t *env, const char *input, char *(*input_more)(void), val_t **v);
 int interp_execute_string(env_t *env, const char *input, val_t **result);
 int interp_execute_image(env_t *env, val_t **result);
+int interp_resume(env_t *env, val_t **result);
+
+// slice: backward jumps and calls of each execution, 0 for no limit
+void interp_budget_set(env_t *env, int slice);
 
 val_t interp_execute_call(env_t *env, int ac);
 
+/*
+ * Future returned by native (future_create) is settled by host, the async
+ * frames await it are resumed and run, until they finish or wait again.
+ * The host keep the future pending by handle, see env_handle_new, or in
+ * reference of env.
+ * return: 0, or -error raised and not caught
+ */
+int interp_future_resolve(env_t *env, val_t *future, val_t *value);
+int interp_future_reject(env_t *env, val_t *future, int error);
+
 #endif /* __LANG_INTERP_INC__ */
 
@@ -71,6 +71,7 @@ static int lex_chk_token_type(const char *str, int len)
     case 3:
         if (0 == strcmp("def", str)) return TOK_DEF;
         if (0 == strcmp("var", str)) return TOK_VAR;
+        if (0 == strcmp("for", str)) return TOK_FOR;
         if (0 == strcmp("NaN", str)) return TOK_NAN;
         if (0 == strcmp("try", str)) return TOK_TRY;
     case 4:
@@ -78,14 +79,20 @@ static int lex_chk_token_type(const char *str, int len)
         if (0 == strcmp("elif", str)) return TOK_ELIF;
         if (0 == strcmp("true", str)) return TOK_TRUE;
         if (0 == strcmp("null", str)) return TOK_NULL;
+        if (0 == strcmp("case", str)) return TOK_CASE;
     case 5:
         if (0 == strcmp("false", str)) return TOK_FALSE;
         if (0 == strcmp("while", str)) return TOK_WHILE;
         if (0 == strcmp("break", str)) return TOK_BREAK;
         if (0 == strcmp("catch", str)) return TOK_CATCH;
         if (0 == strcmp("throw", str)) return TOK_THROW;
+        if (0 == strcmp("yield", str)) return TOK_YIELD;
+        if (0 == strcmp("await", str)) return TOK_AWAIT;
     case 6:
         if (0 == strcmp("return", str)) return TOK_RET;
+        if (0 == strcmp("switch", str)) return TOK_SWITCH;
+    case 7:
+        if (0 == strcmp("default", str)) return TOK_DEFAULT;
     case 8:
         if (0 == strcmp("continue", str)) return TOK_CONTINUE;
     case 9:
@@ -229,6 +236,10 @@ TOKEN_LOCATE:
                 lex_get_next_ch(lex);
                 tok = TOK_LOGICOR;
             } else
+            if (tok == '.' && CURR_CH == '.') {
+                lex_get_next_ch(lex);
+                tok = TOK_RANGE;
+            } else
             if (tok == '>' && CURR_CH == '>') {
                 lex_get_next_ch(lex);
                 if (CURR_CH == '=') {
@@ -58,6 +58,8 @@ enum LEX_TOKEN_TYPE{
     TOK_LOGICAND,           // &&
     TOK_LOGICOR,            // ||
 
+    TOK_RANGE,              // ..
+
     /* Key words */
     TOK_UND,
     TOK_NAN,
@@ -67,6 +69,7 @@ enum LEX_TOKEN_TYPE{
 
     TOK_IN,
     TOK_IF,
+    TOK_FOR,
     TOK_VAR,
     TOK_DEF,
     TOK_RET,
@@ -77,7 +80,12 @@ enum LEX_TOKEN_TYPE{
     TOK_BREAK,
     TOK_CATCH,
     TOK_THROW,
-    TOK_CONTINUE
+    TOK_YIELD,
+    TOK_AWAIT,
+    TOK_CONTINUE,
+    TOK_SWITCH,
+    TOK_CASE,
+    TOK_DEFAULT
 };
 
 typedef struct lexer_t {
@@ -0,0 +1,403 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "err.h"
+#include "string.h"
+#include "array.h"
+#include "interp.h"
+#include "map.h"
+
+#define MAP_SIZE_MAX        (1 << 24)
+
+static map_t *map_alloc(env_t *env, int kind, int size)
+{
+    int index_size = DEF_ELEM_SIZE;
+    map_t *m;
+
+    if (size > MAP_SIZE_MAX) {
+        env_set_error(env, ERR_ResourceOutLimit);
+        return NULL;
+    }
+    while (index_size < size * 2) {
+        index_size *= 2;
+    }
+
+    m = env_heap_alloc(env, sizeof(map_t) + map_data_space(kind, size, index_size));
+    if (m) {
+        m->magic = MAGIC_MAP;
+        m->age = 0;
+        m->kind = kind;
+        m->reserved = 0;
+        m->entry_size = size;
+        m->entry_end = 0;
+        m->count = 0;
+        m->index_size = index_size;
+        m->entries = (val_t *)(m + 1);
+        memset(map_index(m), 0, sizeof(uint32_t) * index_size);
+    } else {
+        env_set_error(env, ERR_NotEnoughMemory);
+    }
+
+    return m;
+}
+
+// Number is hashed by value, string by content, others by identity
+static uint32_t map_hash(val_t *k)
+{
+    uint64_t x;
+
+    if (val_is_number(k)) {
+        double d = val_2_double(k);
+
+        // 0 and -0 are the same key
+        d = d == 0 ? 0 : d;
+        x = double_2_val(d);
+    } else
+    if (val_is_string(k)) {
+        const uint8_t *s = (const uint8_t *)val_2_cstring(k);
+
+        x = 14695981039346656037ULL;
+        while (*s) {
+            x ^= *s++;
+            x *= 1099511628211ULL;
+        }
+    } else {
+        x = *k;
+    }
+
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+
+    return (uint32_t) x;
+}
+
+static inline int map_key_equal(val_t *a, val_t *b) {
+    if (*a == *b) {
+        return 1;
+    } else
+    if (val_is_number(a) && val_is_number(b)) {
+        return val_2_double(a) == val_2_double(b);
+    } else
+    if (val_is_string(a) && val_is_string(b)) {
+        return !strcmp(val_2_cstring(a), val_2_cstring(b));
+    } else {
+        return 0;
+    }
+}
+
+// Return position of entry, -1 if not found
+int map_find(map_t *m, val_t *key)
+{
+    uint32_t *index = map_index(m);
+    uint32_t mask = m->index_size - 1;
+    uint32_t h = map_hash(key) & mask;
+    int width = map_entry_width(m);
+
+    while (index[h]) {
+        int pos = index[h] - 1;
+
+        if (map_key_equal(m->entries + pos * width, key)) {
+            return pos;
+        }
+        h = (h + 1) & mask;
+    }
+
+    return -1;
+}
+
+static void map_index_insert(map_t *m, int pos)
+{
+    uint32_t *index = map_index(m);
+    uint32_t mask = m->index_size - 1;
+    uint32_t h = map_hash(m->entries + pos * map_entry_width(m)) & mask;
+
+    while (index[h]) {
+        h = (h + 1) & mask;
+    }
+    index[h] = pos + 1;
+}
+
+void map_index_rebuild(map_t *m)
+{
+    int i, width = map_entry_width(m);
+
+    memset(map_index(m), 0, sizeof(uint32_t) * m->index_size);
+    for (i = 0; i < (int)m->entry_end; i++) {
+        if (m->entries[i * width] != MAP_KEY_DELETED) {
+            map_index_insert(m, i);
+        }
+    }
+}
+
+// Drop deleted entries, alive entries keep their order
+static void map_compact(map_t *m, val_t *entries)
+{
+    int i, n = 0, width = map_entry_width(m);
+
+    for (i = 0; i < (int)m->entry_end; i++) {
+        val_t *e = m->entries + i * width;
+
+        if (*e != MAP_KEY_DELETED) {
+            memmove(entries + n * width, e, sizeof(val_t) * width);
+            n++;
+        }
+    }
+    m->entries = entries;
+    m->entry_end = n;
+}
+
+static map_t *map_space_extend(env_t *env, val_t *self)
+{
+    map_t *m = (map_t *)val_2_intptr(self);
+    val_t *entries;
+    int size, index_size;
+
+    if (m->entry_end < m->entry_size) {
+        return m;
+    }
+
+    if (m->count * 2 < m->entry_size) {
+        // enough space is taken by deleted entries
+        map_compact(m, m->entries);
+        map_index_rebuild(m);
+        return m;
+    }
+
+    size = m->entry_size * 2;
+    index_size = m->index_size * 2;
+    if (size > MAP_SIZE_MAX) {
+        env_set_error(env, ERR_ResourceOutLimit);
+        return NULL;
+    }
+
+    entries = env_heap_alloc(env, map_data_space(m->kind, size, index_size));
+    if (!entries) {
+        env_set_error(env, ERR_NotEnoughMemory);
+        return NULL;
+    }
+
+    // Note: map may be moved by gc, in alloc
+    m = (map_t *)val_2_intptr(self);
+    map_compact(m, entries);
+    m->entry_size = size;
+    m->index_size = index_size;
+    map_index_rebuild(m);
+
+    return m;
+}
+
+// value is ignored by set
+static int map_put(env_t *env, val_t *self, val_t *key, val_t *value)
+{
+    map_t *m = (map_t *)val_2_intptr(self);
+    int pos = map_find(m, key);
+
+    if (pos < 0) {
+        m = map_space_extend(env, self);
+        if (!m) {
+            return -1;
+        }
+
+        pos = m->entry_end++;
+        m->count++;
+        m->entries[pos * map_entry_width(m)] = *key;
+        map_index_insert(m, pos);
+    }
+
+    if (!map_is_set(m)) {
+        m->entries[pos * 2 + 1] = *value;
+    }
+
+    return 0;
+}
+
+static val_t map_create_from(env_t *env, int kind, int ac, val_t *av)
+{
+    int i, n = ac > 0 && val_is_array(av) ? array_length((array_t *)val_2_intptr(av)) : 0;
+    map_t *m = map_alloc(env, kind, n < DEF_ELEM_SIZE ? DEF_ELEM_SIZE : n);
+    val_t *res;
+
+    if (!m) {
+        return val_mk_undefined();
+    }
+    // Note: result is kept in stack, for gc
+    res = env_stack_push(env);
+    val_set_map(res, (intptr_t) m);
+
+    // Note: space is enough, no gc in put
+    for (i = 0; i < n && !env->error; i++) {
+        val_t *e = array_elem_ref((array_t *)val_2_intptr(av), i);
+
+        if (!e) {
+            continue;
+        }
+        if (kind == MAP_KIND_SET) {
+            map_put(env, res, e, NULL);
+        } else
+        if (val_is_array(e) && array_length((array_t *)val_2_intptr(e)) > 1) {
+            array_t *pair = (array_t *)val_2_intptr(e);
+            val_t *k = array_elem_ref(pair, 0), *v = array_elem_ref(pair, 1);
+
+            if (k && v) {
+                map_put(env, res, k, v);
+            }
+        } else {
+            env_set_error(env, ERR_InvalidInput);
+        }
+    }
+
+    return *env_stack_pop(env);
+}
+
+val_t map_create(env_t *env, int ac, val_t *av)
+{
+    return map_create_from(env, MAP_KIND_MAP, ac, av);
+}
+
+val_t set_create(env_t *env, int ac, val_t *av)
+{
+    return map_create_from(env, MAP_KIND_SET, ac, av);
+}
+
+static inline map_t *map_self(val_t *av, int kind) {
+    map_t *m = (map_t *)val_2_intptr(av);
+
+    return val_is_map(av) && m->kind == kind ? m : NULL;
+}
+
+val_t map_get(env_t *env, int ac, val_t *av)
+{
+    map_t *m = ac > 1 ? map_self(av, MAP_KIND_MAP) : NULL;
+
+    if (m) {
+        int pos = map_find(m, av + 1);
+
+        return pos < 0 ? val_mk_undefined() : m->entries[pos * 2 + 1];
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+val_t map_set(env_t *env, int ac, val_t *av)
+{
+    if (ac > 2 && map_self(av, MAP_KIND_MAP)) {
+        map_put(env, av, av + 1, av + 2);
+        return *av;
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+val_t map_add(env_t *env, int ac, val_t *av)
+{
+    if (ac > 1 && map_self(av, MAP_KIND_SET)) {
+        map_put(env, av, av + 1, NULL);
+        return *av;
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+val_t map_has(env_t *env, int ac, val_t *av)
+{
+    if (ac > 1 && val_is_map(av)) {
+        return val_mk_boolean(map_find((map_t *)val_2_intptr(av), av + 1) >= 0);
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+val_t map_delete(env_t *env, int ac, val_t *av)
+{
+    if (ac > 1 && val_is_map(av)) {
+        map_t *m = (map_t *)val_2_intptr(av);
+        int pos = map_find(m, av + 1);
+
+        if (pos < 0) {
+            return val_mk_boolean(0);
+        }
+
+        // Note: entry is kept in index, until it be rebuilt
+        m->entries[pos * map_entry_width(m)] = MAP_KEY_DELETED;
+        if (!map_is_set(m)) {
+            val_set_undefined(m->entries + pos * 2 + 1);
+        }
+        m->count--;
+
+        return val_mk_boolean(1);
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+val_t map_size(env_t *env, int ac, val_t *av)
+{
+    if (ac > 0 && val_is_map(av)) {
+        return val_mk_number(((map_t *)val_2_intptr(av))->count);
+    }
+
+    env_set_error(env, ERR_InvalidInput);
+    return val_mk_undefined();
+}
+
+/*
+ * Entries are visited in insert order, callback is called with (value, key),
+ * and (key, key) for set.
+ * foreach is looped by interpreter when called from script.
+ */
+val_t map_foreach(env_t *env, int ac, val_t *av)
+{
+    if (ac > 1 && val_is_map(av) && val_is_function(av + 1)) {
+        int i;
+
+        for (i = 0; !env->error; i++) {
+            // Note: map may be moved by gc, in callback
+            map_t *m = (map_t *)val_2_intptr(av);
+            int width = map_entry_width(m);
+            val_t *e;
+
+            if (i >= (int)m->entry_end) {
+                break;
+            }
+            e = m->entries + i * width;
+            if (*e == MAP_KEY_DELETED) {
+                continue;
+            }
+
+            env_push_call_argument(env, e);
+            env_push_call_argument(env, e + width - 1);
+            env_push_call_function(env, av + 1);
+
+            interp_execute_call(env, 2);
+        }
+    }
+
+    return val_mk_undefined();
+}
@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef __LANG_MAP_INC__
+#define __LANG_MAP_INC__
+
+#include "config.h"
+#include "val.h"
+#include "env.h"
+
+#define MAGIC_MAP           (MAGIC_BASE + 17)
+
+#define MAP_KIND_MAP        0   // entry is pair of (key, value)
+#define MAP_KIND_SET        1   // entry is key only
+
+// Key of deleted entry, never equal to any value
+#define MAP_KEY_DELETED     MAKE_TAG(1, 0xF)
+
+/*
+ * Entries are kept in insert order, the hash index follow them.
+ * Index slot hold the position of entry + 1, 0 for empty.
+ * Index is rebuilt when entries are moved by gc, keys of object are hashed
+ * by address.
+ */
+typedef struct map_t {
+    uint8_t magic;
+    uint8_t age;
+    uint8_t kind;
+    uint8_t reserved;
+    uint32_t entry_size;        // entries can be held
+    uint32_t entry_end;         // entries used, deleted entries included
+    uint32_t count;             // entries alive
+    uint32_t index_size;        // slots of index, power of 2
+    val_t *entries;
+} map_t;
+
+static inline int map_is_set(map_t *m) {
+    return m->kind == MAP_KIND_SET;
+}
+
+static inline int map_entry_width(map_t *m) {
+    return map_is_set(m) ? 1 : 2;
+}
+
+static inline uint32_t *map_index(map_t *m) {
+    return (uint32_t *)(m->entries + m->entry_size * map_entry_width(m));
+}
+
+static inline int map_data_space(int kind, int entry_size, int index_size) {
+    return sizeof(val_t) * entry_size * (kind == MAP_KIND_SET ? 1 : 2) + sizeof(uint32_t) * index_size;
+}
+
+static inline int map_mem_space(map_t *m) {
+    return SIZE_ALIGN(sizeof(map_t) + map_data_space(m->kind, m->entry_size, m->index_size));
+}
+
+void map_index_rebuild(map_t *m);
+int  map_find(map_t *m, val_t *key);
+
+val_t map_create(env_t *env, int ac, val_t *av);
+val_t set_create(env_t *env, int ac, val_t *av);
+
+val_t map_get(env_t *env, int ac, val_t *av);
+val_t map_set(env_t *env, int ac, val_t *av);
+val_t map_add(env_t *env, int ac, val_t *av);
+val_t map_has(env_t *env, int ac, val_t *av);
+val_t map_delete(env_t *env, int ac, val_t *av);
+val_t map_size(env_t *env, int ac, val_t *av);
+val_t map_foreach(env_t *env, int ac, val_t *av);
+
+#endif /* __LANG_MAP_INC__ */
@@ -26,10 +26,18 @@ SOFTWARE.
 #include "number.h"
 #include "string.h"
 #include "array.h"
+#include "buffer.h"
+#include "map.h"
+#include "generator.h"
+#include "future.h"
 #include "object.h"
 
 static object_t object_proto;
 static object_t array_proto;
+static object_t buffer_proto;
+static object_t map_proto;
+static object_t set_proto;
+static object_t generator_proto;
 static object_t undefined_proto;
 static object_t nan_proto;
 static object_t boolean_proto;
@@ -42,8 +50,25 @@ static val_t object_prop_vals[3];
 static intptr_t string_prop_keys[1] = {(intptr_t)"indexOf"};
 static val_t string_prop_vals[1];
 
-static intptr_t array_prop_keys[5]  = {(intptr_t)"push", (intptr_t)"pop", (intptr_t)"shift", (intptr_t)"unshift", (intptr_t)"foreach"};
-static val_t array_prop_vals[5];
+static intptr_t array_prop_keys[13] = {(intptr_t)"push", (intptr_t)"pop", (intptr_t)"shift", (intptr_t)"unshift", (intptr_t)"foreach",
+                                       (intptr_t)"map", (intptr_t)"filter", (intptr_t)"reduce", (intptr_t)"slice",
+                                       (intptr_t)"concat", (intptr_t)"indexOf", (intptr_t)"join", (intptr_t)"sort"};
+static val_t array_prop_vals[13];
+
+static intptr_t buffer_prop_keys[6] = {(intptr_t)"slice", (intptr_t)"readInt", (intptr_t)"readUInt", (intptr_t)"readFloat",
+                                       (intptr_t)"writeInt", (intptr_t)"writeFloat"};
+static val_t buffer_prop_vals[6];
+
+static intptr_t map_prop_keys[6] = {(intptr_t)"get", (intptr_t)"set", (intptr_t)"has", (intptr_t)"delete",
+                                    (intptr_t)"size", (intptr_t)"foreach"};
+static val_t map_prop_vals[6];
+
+static intptr_t set_prop_keys[5] = {(intptr_t)"add", (intptr_t)"has", (intptr_t)"delete", (intptr_t)"size",
+                                    (intptr_t)"foreach"};
+static val_t set_prop_vals[5];
+
+static intptr_t generator_prop_keys[2] = {(intptr_t)"next", (intptr_t)"done"};
+static val_t generator_prop_vals[2];
 
 
 static val_t *object_add_prop(env_t *env, object_t *obj, intptr_t symbal) {
@@ -110,8 +135,13 @@ static val_t *object_find_prop_owned(object_t *obj, intptr_t symbal) {
 static inline void object_static_register(env_t *env, object_t *o) {
     int i;
 
+    // Note: key is replaced by the symbal, name may be shared by protos
     for (i = 0; i < o->prop_num; i++) {
-        env_symbal_add_static(env, (const char *)o->keys[i]);
+        intptr_t sym = env_symbal_add_static(env, (const char *)o->keys[i]);
+
+        if (sym) {
+            o->keys[i] = sym;
+        }
     }
 }
 
@@ -119,6 +149,15 @@ static inline object_t *_object_proto_get(val_t *obj) {
     if (val_is_array(obj)) {
         return &array_proto;
     } else
+    if (val_is_buffer(obj)) {
+        return &buffer_proto;
+    } else
+    if (val_is_map(obj)) {
+        return map_is_set((map_t *)val_2_intptr(obj)) ? &set_proto : &map_proto;
+    } else
+    if (val_is_generator(obj)) {
+        return &generator_proto;
+    } else
     if (val_is_number(obj)) {
         return &number_proto;
     } else
@@ -149,6 +188,10 @@ static val_t object_length(env_t *env, int ac, val_t *av)
             array_t *a = (array_t *)val_2_intptr(av);
             return val_mk_number(array_length(a));
         } else
+        if (val_is_buffer(av)) {
+            buffer_t *b = (buffer_t *)val_2_intptr(av);
+            return val_mk_number(buffer_length(b));
+        } else
         if (val_is_inline_string(av)) {
             return val_mk_number(string_inline_len(av));
         } else
@@ -190,19 +233,38 @@ static val_t object_to_string(env_t *env, int ac, val_t *obj)
     } else
     if (val_is_array(obj)) {
         return val_mk_static_string((intptr_t)"Array");
+    } else
+    if (val_is_buffer(obj)) {
+        return val_mk_static_string((intptr_t)"Buffer");
+    } else
+    if (val_is_map(obj)) {
+        return val_mk_static_string((intptr_t)(map_is_set((map_t *)val_2_intptr(obj)) ? "Set" : "Map"));
+    } else
+    if (val_is_generator(obj)) {
+        return val_mk_static_string((intptr_t)"Generator");
+    } else
+    if (val_is_future(obj)) {
+        return val_mk_static_string((intptr_t)"Future");
     } else {
         return val_mk_static_string((intptr_t)"Object");
     }
 }
 
-static val_t object_foreach(env_t *env, int ac, val_t *av)
+val_t object_foreach(env_t *env, int ac, val_t *av)
 {
     if (ac > 1 && val_is_dictionary(av) && val_is_function(av + 1)) {
         object_t *o = (object_t *)val_2_intptr(av);
         int i, max = o->prop_num;
 
         for (i = 0; i < max && !env->error; i++) {
-            val_t key = val_mk_static_string(o->keys[i]);
+            val_t key;
+
+            // Note: object may be moved by gc, in callback
+            o = (object_t *)val_2_intptr(av);
+            if (i >= o->prop_num) {
+                break;
+            }
+            key = val_mk_static_string(o->keys[i]);
 
             env_push_call_argument(env, &key);
             env_push_call_argument(env, o->vals + i);
@@ -243,6 +305,33 @@ void object_prop_get(env_t *env, val_t *self, val_t *key, val_t *prop)
     }
 }
 
+/*
+ * Find the owned property of dictionary, for property cache of interpreter.
+ * Return index of the property, or -1 if not found.
+ */
+int object_prop_index(env_t *env, val_t *self, val_t *key, intptr_t *symbal)
+{
+    const char *name = val_2_cstring(key);
+    object_t *obj;
+    int i;
+
+    if (!name || !val_is_dictionary(self)) {
+        return -1;
+    }
+
+    obj = (object_t *) val_2_intptr(self);
+    if (0 == (*symbal = env_symbal_get(env, name))) {
+        return -1;
+    }
+
+    for (i = 0; i < obj->prop_num; i++) {
+        if (obj->keys[i] == *symbal) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 void object_elem_get(env_t *env, val_t *obj, val_t *key, val_t *elem)
 {
     if (val_is_number(key)) {
@@ -251,6 +340,9 @@ void object_elem_get(env_t *env, val_t *obj, val_t *key, val_t *elem)
         } else
         if (val_is_array(obj)) {
             array_elem_get(env, obj, key, elem);
+        } else
+        if (val_is_buffer(obj)) {
+            buffer_elem_get(env, obj, key, elem);
         } else {
             env_set_error(env, ERR_HasNoneElement);
         }
@@ -259,6 +351,32 @@ void object_elem_get(env_t *env, val_t *obj, val_t *key, val_t *elem)
     }
 }
 
+/*
+ * Operator "in": property of dictionary, key of map & set, value of array,
+ * sub string of string.
+ * Absent name is not added to symbal table.
+ */
+int object_has(env_t *env, val_t *obj, val_t *key)
+{
+    if (val_is_dictionary(obj)) {
+        const char *name = val_2_cstring(key);
+        intptr_t sym_id = name ? env_symbal_get(env, name) : 0;
+
+        return sym_id && object_find_prop((object_t *)val_2_intptr(obj), sym_id);
+    } else
+    if (val_is_array(obj)) {
+        return array_has((array_t *)val_2_intptr(obj), key);
+    } else
+    if (val_is_map(obj)) {
+        return map_find((map_t *)val_2_intptr(obj), key) >= 0;
+    } else
+    if (val_is_string(obj)) {
+        return string_has(obj, key);
+    } else {
+        return 0;
+    }
+}
+
 void object_prop_set(env_t *env, val_t *self, val_t *key, val_t *val)
 {
     const char *name = val_2_cstring(key);
@@ -295,6 +413,9 @@ void object_elem_set(env_t *env, val_t *self, val_t *key, val_t *val)
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_set(env, self, key, val);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_set(env, self, key, val);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -589,6 +710,9 @@ void object_elem_add_set(env_t *env, val_t *self, val_t *key, val_t *val, val_t
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_add_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_add);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -602,6 +726,9 @@ void object_elem_sub_set(env_t *env, val_t *self, val_t *key, val_t *val, val_t
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_sub_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_sub);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -615,6 +742,9 @@ void object_elem_mul_set(env_t *env, val_t *self, val_t *key, val_t *val, val_t
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_mul_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_mul);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -628,6 +758,9 @@ void object_elem_div_set(env_t *env, val_t *self, val_t *key, val_t *val, val_t
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_div_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_div);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -641,6 +774,9 @@ void object_elem_mod_set(env_t *env, val_t *self, val_t *key, val_t *val, val_t
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_mod_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_mod);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -654,6 +790,9 @@ void object_elem_and_set(env_t *env, val_t *self, val_t *key, val_t *val, val_t
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_and_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_and);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -667,6 +806,9 @@ void object_elem_or_set(env_t *env, val_t *self, val_t *key, val_t *val, val_t *
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_or_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_or);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -680,6 +822,9 @@ void object_elem_xor_set(env_t *env, val_t *self, val_t *key, val_t *val, val_t
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_xor_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_xor);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -693,6 +838,9 @@ void object_elem_lshift_set(env_t *env, val_t *self, val_t *key, val_t *val, val
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_lshift_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_lshift);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -706,6 +854,9 @@ void object_elem_rshift_set(env_t *env, val_t *self, val_t *key, val_t *val, val
     if (val_is_number(key)) {
         if (val_is_array(self)) {
             array_elem_rshift_set(env, self, key, val, res);
+        } else
+        if (val_is_buffer(self)) {
+            buffer_elem_op_set(env, self, key, val, res, number_rshift);
         } else {
             env_set_error(env, ERR_InvalidSementic);
         }
@@ -771,6 +922,10 @@ int objects_env_init(env_t *env)
     object_t *String    = &string_proto;
     object_t *Number    = &number_proto;
     object_t *Array     = &array_proto;
+    object_t *Buffer    = &buffer_proto;
+    object_t *Map       = &map_proto;
+    object_t *Set       = &set_proto;
+    object_t *Generator = &generator_proto;
     object_t *Undefined = &undefined_proto;
     object_t *NaN       = &nan_proto;
     object_t *Boolean   = &boolean_proto;
@@ -798,13 +953,68 @@ int objects_env_init(env_t *env)
     array_prop_vals[2] = val_mk_native((intptr_t) array_shift);
     array_prop_vals[3] = val_mk_native((intptr_t) array_unshift);
     array_prop_vals[4] = val_mk_native((intptr_t) array_foreach);
+    array_prop_vals[5] = val_mk_native((intptr_t) array_map);
+    array_prop_vals[6] = val_mk_native((intptr_t) array_filter);
+    array_prop_vals[7] = val_mk_native((intptr_t) array_reduce);
+    array_prop_vals[8] = val_mk_native((intptr_t) array_slice);
+    array_prop_vals[9] = val_mk_native((intptr_t) array_concat);
+    array_prop_vals[10] = val_mk_native((intptr_t) array_index_of);
+    array_prop_vals[11] = val_mk_native((intptr_t) array_join);
+    array_prop_vals[12] = val_mk_native((intptr_t) array_sort);
     Array->magic = MAGIC_OBJECT_STATIC;
     Array->proto = Object;
-    Array->prop_num = 5;
+    Array->prop_num = 13;
     Array->keys = array_prop_keys;
     Array->vals = array_prop_vals;
     object_static_register(env, &array_proto);
 
+    buffer_prop_vals[0] = val_mk_native((intptr_t) buffer_slice);
+    buffer_prop_vals[1] = val_mk_native((intptr_t) buffer_read_int);
+    buffer_prop_vals[2] = val_mk_native((intptr_t) buffer_read_uint);
+    buffer_prop_vals[3] = val_mk_native((intptr_t) buffer_read_float);
+    buffer_prop_vals[4] = val_mk_native((intptr_t) buffer_write_int);
+    buffer_prop_vals[5] = val_mk_native((intptr_t) buffer_write_float);
+    Buffer->magic = MAGIC_OBJECT_STATIC;
+    Buffer->proto = Object;
+    Buffer->prop_num = 6;
+    Buffer->keys = buffer_prop_keys;
+    Buffer->vals = buffer_prop_vals;
+    object_static_register(env, &buffer_proto);
+
+    map_prop_vals[0] = val_mk_native((intptr_t) map_get);
+    map_prop_vals[1] = val_mk_native((intptr_t) map_set);
+    map_prop_vals[2] = val_mk_native((intptr_t) map_has);
+    map_prop_vals[3] = val_mk_native((intptr_t) map_delete);
+    map_prop_vals[4] = val_mk_native((intptr_t) map_size);
+    map_prop_vals[5] = val_mk_native((intptr_t) map_foreach);
+    Map->magic = MAGIC_OBJECT_STATIC;
+    Map->proto = Object;
+    Map->prop_num = 6;
+    Map->keys = map_prop_keys;
+    Map->vals = map_prop_vals;
+    object_static_register(env, &map_proto);
+
+    set_prop_vals[0] = val_mk_native((intptr_t) map_add);
+    set_prop_vals[1] = val_mk_native((intptr_t) map_has);
+    set_prop_vals[2] = val_mk_native((intptr_t) map_delete);
+    set_prop_vals[3] = val_mk_native((intptr_t) map_size);
+    set_prop_vals[4] = val_mk_native((intptr_t) map_foreach);
+    Set->magic = MAGIC_OBJECT_STATIC;
+    Set->proto = Object;
+    Set->prop_num = 5;
+    Set->keys = set_prop_keys;
+    Set->vals = set_prop_vals;
+    object_static_register(env, &set_proto);
+
+    generator_prop_vals[0] = val_mk_native((intptr_t) generator_next);
+    generator_prop_vals[1] = val_mk_native((intptr_t) generator_done);
+    Generator->magic = MAGIC_OBJECT_STATIC;
+    Generator->proto = Object;
+    Generator->prop_num = 2;
+    Generator->keys = generator_prop_keys;
+    Generator->vals = generator_prop_vals;
+    object_static_register(env, &generator_proto);
+
     Number->magic = MAGIC_OBJECT_STATIC;
     Number->proto = Object;
     Number->prop_num = 0;
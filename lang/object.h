@@ -50,8 +50,12 @@ extern val_t *object_string_ptr;
 
 int objects_env_init(env_t *env);
 
+val_t object_foreach(env_t *env, int ac, val_t *av);
+
 void object_prop_get(env_t *env, val_t *obj, val_t *key, val_t *prop);
+int  object_prop_index(env_t *env, val_t *obj, val_t *key, intptr_t *symbal);
 void object_elem_get(env_t *env, val_t *obj, val_t *key, val_t *prop);
+int  object_has(env_t *env, val_t *obj, val_t *key);
 
 void object_prop_set(env_t *env, val_t *obj, val_t *key, val_t *prop);
 void object_elem_set(env_t *env, val_t *obj, val_t *key, val_t *prop);
@@ -90,6 +94,16 @@ static inline int object_mem_space(object_t *o) {
     return SIZE_ALIGN(sizeof(object_t) + (sizeof(intptr_t) + sizeof(val_t)) * o->prop_size);
 };
 
+static inline val_t *object_prop_at(val_t *self, int index, intptr_t symbal) {
+    object_t *obj = (object_t *) val_2_intptr(self);
+
+    if (index < obj->prop_num && obj->keys[index] == symbal) {
+        return obj->vals + index;
+    } else {
+        return NULL;
+    }
+}
+
 intptr_t object_create(env_t *env, int n, val_t *av);
 
 #endif /* __LANG_OBJECT_INC__ */
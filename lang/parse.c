@@ -239,6 +239,10 @@ static expr_t *parse_expr_unary(parser_t *psr)
         parse_match(psr, tok);
         expr = parse_expr_form_unary(psr, tok == '-' ? EXPR_NEG : EXPR_NOT,
                                      parse_expr_unary(psr));
+    } else
+    if (tok == TOK_AWAIT) {
+        parse_match(psr, tok);
+        expr = parse_expr_form_unary(psr, EXPR_AWAIT, parse_expr_unary(psr));
     } else {
         expr = parse_expr_primary(psr);
     }
@@ -898,6 +902,170 @@ static stmt_t *parse_stmt_while(parser_t *psr)
     return s;
 }
 
+/*
+ * for name in iterable { ... }
+ * for name in start..end { ... }
+ *
+ * The name and iterable are kept as the operands of EXPR_TIN, and the
+ * range is presented as EXPR_RANGE.
+ */
+static stmt_t *parse_stmt_for(parser_t *psr)
+{
+    expr_t *name = NULL;
+    expr_t *iter = NULL;
+    stmt_t *block = NULL;
+    stmt_t *s;
+    token_t token;
+    int paren;
+
+    parse_match(psr, TOK_FOR);
+    paren = parse_match(psr, '(');
+
+    if (parse_token(psr, &token) != TOK_ID) {
+        parse_fail(psr, ERR_InvalidToken);
+        return NULL;
+    }
+    if (!(name = parse_expr_alloc_str(psr, EXPR_ID, token.text))) {
+        parse_fail(psr, ERR_NotEnoughMemory);
+        return NULL;
+    }
+    parse_match(psr, TOK_ID);
+
+    if (!parse_match(psr, TOK_IN)) {
+        parse_fail(psr, ERR_InvalidToken);
+        return NULL;
+    }
+
+    if (!(iter = parse_expr_ternary(psr))) {
+        return NULL;
+    }
+    if (parse_match(psr, TOK_RANGE)) {
+        if (!(iter = parse_expr_form_binary(psr, EXPR_RANGE, iter, parse_expr_ternary(psr)))) {
+            return NULL;
+        }
+    }
+
+    if (paren && !parse_match(psr, ')')) {
+        parse_fail(psr, ERR_InvalidToken);
+        return NULL;
+    }
+
+    if (!(iter = parse_expr_form_binary(psr, EXPR_TIN, name, iter))) {
+        return NULL;
+    }
+
+    if (!(block = parse_stmt_block(psr))) {
+        return NULL;
+    }
+
+    s = parse_stmt_alloc_2(psr, STMT_FOR, iter, block);
+    if (!s) {
+        parse_fail(psr, ERR_NotEnoughMemory);
+    }
+
+    return s;
+}
+
+/*
+ * switch expr {
+ * case 1, 2: ...
+ * case 3: ...
+ * default: ...
+ * }
+ *
+ * The cases are linked as the block of STMT_SWITCH, value of each case is
+ * the expr of STMT_CASE, NULL for default.
+ */
+static stmt_t *parse_stmt_case(parser_t *psr)
+{
+    expr_t *value = NULL;
+    stmt_t *block = NULL, *last, *curr;
+    stmt_t *s;
+    int tok;
+
+    if (parse_match(psr, TOK_CASE)) {
+        if (!(value = parse_expr(psr))) {
+            return NULL;
+        }
+    } else
+    if (!parse_match(psr, TOK_DEFAULT)) {
+        parse_fail(psr, ERR_InvalidToken);
+        return NULL;
+    }
+
+    if (!parse_match(psr, ':')) {
+        parse_fail(psr, ERR_InvalidToken);
+        return NULL;
+    }
+
+    while (1) {
+        while (parse_match(psr, ';')); // eat empty stmt
+
+        tok = parse_token(psr, NULL);
+        if (tok == TOK_CASE || tok == TOK_DEFAULT || tok == '}') {
+            break;
+        }
+
+        if (!(curr = parse_stmt(psr))) {
+            return NULL;
+        }
+
+        if (block) {
+            last = last->next = curr;
+        } else {
+            block = last = curr;
+        }
+    }
+
+    s = parse_stmt_alloc_2(psr, STMT_CASE, value, block);
+    if (!s) {
+        parse_fail(psr, ERR_NotEnoughMemory);
+    }
+
+    return s;
+}
+
+static stmt_t *parse_stmt_switch(parser_t *psr)
+{
+    expr_t *expr = NULL;
+    stmt_t *cases = NULL, *last = NULL, *curr;
+    stmt_t *s;
+
+    parse_match(psr, TOK_SWITCH);
+
+    if (!(expr = parse_expr(psr))) {
+        return NULL;
+    }
+
+    parse_post(psr, PARSE_ENTER_BLOCK);
+    if (!parse_match(psr, '{')) {
+        parse_fail(psr, ERR_InvalidToken);
+        return NULL;
+    }
+
+    while (!parse_match(psr, '}')) {
+        while (parse_match(psr, ';'));
+
+        if (!(curr = parse_stmt_case(psr))) {
+            return NULL;
+        }
+
+        if (cases) {
+            last = last->next = curr;
+        } else {
+            cases = last = curr;
+        }
+    }
+    parse_post(psr, PARSE_LEAVE_BLOCK);
+
+    s = parse_stmt_alloc_2(psr, STMT_SWITCH, expr, cases);
+    if (!s) {
+        parse_fail(psr, ERR_NotEnoughMemory);
+    }
+
+    return s;
+}
+
 static stmt_t *parse_stmt_throw(parser_t *psr)
 {
     expr_t *expr = NULL;
@@ -918,6 +1086,26 @@ static stmt_t *parse_stmt_throw(parser_t *psr)
     return s;
 }
 
+static stmt_t *parse_stmt_yield(parser_t *psr)
+{
+    expr_t *expr = NULL;
+    stmt_t *s;
+
+    parse_match(psr, TOK_YIELD);
+
+    if (!parse_match(psr, ';')) {
+        if (NULL == (expr = parse_expr(psr))) {
+            return NULL;
+        }
+        parse_match(psr, ';');
+    }
+
+    if (!(s = parse_stmt_alloc_1(psr, STMT_YIELD, expr))) {
+        parse_fail(psr, ERR_NotEnoughMemory);
+    }
+    return s;
+}
+
 static stmt_t *parse_stmt_break(parser_t *psr)
 {
     stmt_t *s;
@@ -982,8 +1170,11 @@ stmt_t *parse_stmt(parser_t *psr)
         case TOK_VAR:       parse_post(psr, PARSE_SIMPLE); return parse_stmt_var(psr);
         case TOK_RET:       parse_post(psr, PARSE_SIMPLE); return parse_stmt_ret(psr);
         case TOK_WHILE:     parse_post(psr, PARSE_COMPOSE); return parse_stmt_while(psr);
+        case TOK_FOR:       parse_post(psr, PARSE_COMPOSE); return parse_stmt_for(psr);
+        case TOK_SWITCH:    parse_post(psr, PARSE_COMPOSE); return parse_stmt_switch(psr);
         case TOK_BREAK:     parse_post(psr, PARSE_SIMPLE); return parse_stmt_break(psr);
         case TOK_THROW:     parse_post(psr, PARSE_SIMPLE); return parse_stmt_throw(psr);
+        case TOK_YIELD:     parse_post(psr, PARSE_SIMPLE); return parse_stmt_yield(psr);
         case TOK_CONTINUE:  parse_post(psr, PARSE_SIMPLE); return parse_stmt_continue(psr);
         default:            parse_post(psr, PARSE_SIMPLE); return parse_stmt_expr(psr);
     }
@@ -37,6 +37,14 @@ int string_compare(val_t *a, val_t *b)
     }
 }
 
+int string_has(val_t *s, val_t *sub)
+{
+    const char *s1 = val_2_cstring(s);
+    const char *s2 = val_2_cstring(sub);
+
+    return s1 && s2 && strstr(s1, s2);
+}
+
 void string_at(env_t *env, val_t *a, val_t *b, val_t *res)
 {
     const char *s = val_2_cstring(a);
@@ -34,6 +34,7 @@ SOFTWARE.
 #define MAGIC_STRING    (MAGIC_BASE + 3)
 
 int string_compare(val_t *a, val_t *b);
+int string_has(val_t *s, val_t *sub);
 
 void string_add(env_t *env, val_t *a, val_t *b, val_t *res);
 void string_at(env_t *env, val_t *a, val_t *b, val_t *res);
@@ -76,9 +76,16 @@ typedef union {
 #define TAG_DICT            MAKE_TAG(1, 9)
 #define TAG_ARRAY           MAKE_TAG(1, 0xA)
 #define TAG_BUFFER          MAKE_TAG(1, 0xB)
+#define TAG_CELL            MAKE_TAG(1, 0xC) // boxed variable, shared with closures
+#define TAG_MAP             MAKE_TAG(1, 0xD) // map & set, hashed by key
 
 #define TAG_REFERENCE       MAKE_TAG(1, 0xE)
 
+// Generator & future, told apart by magic of the object, see generator.h and
+// future.h. Shares the tag with the mask: pointer of them is never null, the
+// null one is the deleted key of map, see MAP_KEY_DELETED
+#define TAG_COROUTINE       MAKE_TAG(1, 0xF)
+
 #define TAG_MASK            MAKE_TAG(1, 0xF)
 #define VAR_MASK            (~MAKE_TAG(1, 0xF))
 
@@ -174,10 +181,26 @@ static inline int val_is_reference(val_t *v) {
     return (*v & TAG_MASK) == TAG_REFERENCE;
 }
 
+static inline int val_is_cell(val_t *v) {
+    return (*v & TAG_MASK) == TAG_CELL;
+}
+
 static inline int val_is_array(val_t *v) {
     return (*v & TAG_MASK) == TAG_ARRAY;
 }
 
+static inline int val_is_buffer(val_t *v) {
+    return (*v & TAG_MASK) == TAG_BUFFER;
+}
+
+static inline int val_is_map(val_t *v) {
+    return (*v & TAG_MASK) == TAG_MAP;
+}
+
+static inline int val_is_coroutine(val_t *v) {
+    return (*v & TAG_MASK) == TAG_COROUTINE && (*v & VAR_MASK);
+}
+
 static inline int val_is_true(val_t *v) {
     return val_is_boolean(v) ? val_2_intptr(v) :
            val_is_number(v)  ? val_2_double(v) != 0 :
@@ -227,6 +250,18 @@ static inline val_t val_mk_array(void *ptr) {
     return TAG_ARRAY | (intptr_t) ptr;
 }
 
+static inline val_t val_mk_buffer(void *ptr) {
+    return TAG_BUFFER | (intptr_t) ptr;
+}
+
+static inline val_t val_mk_map(void *ptr) {
+    return TAG_MAP | (intptr_t) ptr;
+}
+
+static inline val_t val_mk_coroutine(void *ptr) {
+    return TAG_COROUTINE | (intptr_t) ptr;
+}
+
 static inline void val_set_nan(val_t *p) {
     *((uint64_t *)p) = TAG_NAN;
 }
@@ -272,6 +307,22 @@ static inline void val_set_array(val_t *p, intptr_t a) {
     *((uint64_t *)p) = TAG_ARRAY | a;
 }
 
+static inline void val_set_buffer(val_t *p, intptr_t b) {
+    *((uint64_t *)p) = TAG_BUFFER | b;
+}
+
+static inline void val_set_map(val_t *p, intptr_t m) {
+    *((uint64_t *)p) = TAG_MAP | m;
+}
+
+static inline void val_set_coroutine(val_t *p, intptr_t c) {
+    *((uint64_t *)p) = TAG_COROUTINE | c;
+}
+
+static inline void val_set_cell(val_t *p, intptr_t c) {
+    *((uint64_t *)p) = TAG_CELL | c;
+}
+
 static inline void val_set_dictionary(val_t *p, intptr_t d) {
     *((uint64_t *)p) = TAG_DICT | d;
 }
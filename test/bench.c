@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (c) 2016 Lixing Ding <ding.lixing@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Benchmark of interpreter, not a unit test: run "make bench".
+ * Report the time of each case, and the cost of each call for call cases.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "lang/interp.h"
+
+#define STACK_SIZE      1024
+#define HEAP_SIZE       (1024 * 64)
+
+#define EXE_MEM_SPACE   (1024 * 16)
+#define SYM_MEM_SPACE   1024
+#define ENV_BUF_SIZE    (sizeof(val_t) * STACK_SIZE + HEAP_SIZE + EXE_MEM_SPACE + SYM_MEM_SPACE)
+
+static uint8_t env_buf[ENV_BUF_SIZE];
+
+typedef struct bench_t {
+    const char *name;
+    const char *setup;
+    const char *run;
+    double calls;               // number of script call in run
+    int    in_loop;             // the cost of the "loop" case is excluded
+} bench_t;
+
+static bench_t bench_cases[] = {
+    {"loop",        "def nop(a) { return a }",
+                    "var i = 0; while (i < 1000000) { i += 1 }", 0, 0},
+    {"call loop",   "",
+                    "i = 0; while (i < 1000000) { nop(i); i += 1 }", 1000000, 1},
+    {"fib(25)",     "def fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2) }",
+                    "fib(25)", 242785, 0},
+    {"foreach",     "var a = [], j = 0; while (j < 1000) { a.push(j); j += 1 }",
+                    "j = 0; while (j < 1000) { a.foreach(nop); j += 1 }", 1000000, 0},
+    {"map",         "var b",
+                    "j = 0; while (j < 1000) { b = a.map(nop); j += 1 }", 1000000, 0},
+};
+
+static double bench_run(env_t *env, bench_t *bench)
+{
+    val_t *res;
+    clock_t start;
+
+    if (bench->setup[0] && 0 > interp_execute_string(env, bench->setup, &res)) {
+        return -1;
+    }
+
+    start = clock();
+    if (0 > interp_execute_string(env, bench->run, &res)) {
+        return -1;
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, const char *argv[])
+{
+    env_t env;
+    double loop = 0;
+    unsigned i;
+
+    (void) argc;
+    (void) argv;
+
+    if (0 != interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE)) {
+        printf("Init env fail\n");
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(bench_cases) / sizeof(bench_t); i++) {
+        bench_t *bench = bench_cases + i;
+        double t = bench_run(&env, bench);
+
+        if (t < 0) {
+            printf("%-12s: error %d\n", bench->name, env.error);
+            continue;
+        }
+
+        if (!bench->calls) {
+            loop = t;
+            printf("%-12s: %.3f s\n", bench->name, t);
+        } else {
+            double cost = bench->in_loop ? t - loop : t;
+            printf("%-12s: %.3f s, %.1f ns/call\n", bench->name, t, cost * 1e9 / bench->calls);
+        }
+    }
+
+    env_deinit(&env);
+
+    return 0;
+}
@@ -30,7 +30,9 @@ SOFTWARE.
 #include "cunit/CUnit.h"
 #include "cunit/CUnit_Basic.h"
 
+#include "lang/err.h"
 #include "lang/function.h"
+#include "lang/future.h"
 #include "lang/interp.h"
 
 
@@ -41,7 +43,7 @@ SOFTWARE.
 #define SYM_MEM_SPACE   1024
 #define ENV_BUF_SIZE    (sizeof(val_t) * STACK_SIZE + HEAP_SIZE + EXE_MEM_SPACE + SYM_MEM_SPACE)
 
-uint8_t env_buf[ENV_BUF_SIZE];
+static uint8_t env_buf[ENV_BUF_SIZE];
 
 static int test_setup()
 {
@@ -127,12 +129,211 @@ static void test_async_common(void)
     env_deinit(&env);
 }
 
+#define FUTURE_MAX      8
+
+static val_t future[FUTURE_MAX];
+static int future_num;
+
+// I/O started, the future is settled by host later
+static val_t test_async_read(env_t *env, int ac, val_t *av)
+{
+    (void) ac;
+    (void) av;
+
+    if (future_num < FUTURE_MAX) {
+        future[future_num] = future_create(env);
+        return future[future_num++];
+    }
+
+    env_set_error(env, ERR_ResourceOutLimit);
+    return val_mk_undefined();
+}
+
+// I/O done at once, the future is resolved before returned
+static val_t test_async_ready(env_t *env, int ac, val_t *av)
+{
+    val_t *f = future + FUTURE_MAX - 1;
+
+    *f = future_create(env);
+    if (!env->error) {
+        interp_future_resolve(env, f, ac > 0 ? av : NULL);
+    }
+    return *f;
+}
+
+static void test_async_await(void)
+{
+    env_t env;
+    val_t *res, v;
+    native_t native_entry[] = {
+        {"read",  test_async_read},
+        {"ready", test_async_ready},
+    };
+    int i;
+
+    for (i = 0; i < FUTURE_MAX; i++) {
+        val_set_undefined(future + i);
+    }
+    future_num = 0;
+    gc_count = 0;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+    CU_ASSERT(0 == env_native_set(&env, native_entry, 2));
+    CU_ASSERT(0 == env_reference_set(&env, future, FUTURE_MAX));
+    CU_ASSERT(0 == env_callback_set(&env, gc_callback));
+
+    // suspended at await, the future of result returned
+    CU_ASSERT(0 < interp_execute_string(&env, "var out = 0; def get(k) { var v = await read(); return v * k }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var f = get(2)", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "f", &res) && val_is_future(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def wait(f) { out = await f } wait(f); out", &res) && val_is_number(res) && 0 == val_2_double(res));
+
+    // resumed by host, the frame await the result then
+    val_set_number(&v, 21);
+    CU_ASSERT(0 == interp_future_resolve(&env, future + 0, &v));
+    CU_ASSERT(0 < interp_execute_string(&env, "out", &res) && val_is_number(res) && 42 == val_2_double(res));
+    CU_ASSERT(-ERR_InvalidInput == interp_future_resolve(&env, future + 0, &v));
+
+    // settled future and value are the result at once
+    CU_ASSERT(0 < interp_execute_string(&env, "wait(f); out == 42", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "wait(get(0)); out", &res) && val_is_number(res) && 42 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "wait(ready(5)); out", &res) && val_is_number(res) && 5 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "wait(7); out", &res) && val_is_number(res) && 7 == val_2_double(res));
+
+    // many in flight, resumed in the order settled
+    CU_ASSERT(0 < interp_execute_string(&env, "var s = '', n = 0; def task(k) { var v = await read(); s = s + k; n += v }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "for k in ['a', 'b', 'c', 'd'] { task(k) }", &res));
+    for (i = 5; i > 1; i--) {
+        val_set_number(&v, i);
+        CU_ASSERT(0 == interp_future_resolve(&env, future + i, &v));
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "s == 'dcba' && n == 14 && out == 7", &res) && val_is_true(res));
+
+    // error of async function is the result
+    CU_ASSERT(0 < interp_execute_string(&env, "def safe() { try { await read() } catch (e) { return e + 1 } } wait(safe())", &res));
+    CU_ASSERT(0 == interp_future_reject(&env, future + 6, 1000));
+    CU_ASSERT(0 < interp_execute_string(&env, "out", &res) && val_is_number(res) && 1001 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def bad(v) { if (await v) throw 3; return 4 } def test(v) { try { out = await bad(v) } catch (e) { out = e * 10 } }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "test(1); out == 30 && (test(0) || out == 4)", &res) && val_is_true(res));
+
+    // frames & values suspended are kept by gc
+    future_num = 0;
+    CU_ASSERT(0 < interp_execute_string(&env, "var w = ''; def word(c) { var p = c + c; p = p + await read(); w = w + p }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "word('x'); word('y'); for i in 0..100 { s = 'gar' + 'bage' }", &res));
+    CU_ASSERT(gc_count > 0);
+    for (i = 0; i < 2; i++) {
+        CU_ASSERT(0 < interp_execute_string(&env, "'z'", &res));
+        CU_ASSERT(0 == interp_future_resolve(&env, future + i, res));
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "w == 'xxzyyz'", &res) && val_is_true(res));
+
+    CU_ASSERT(-ERR_InvalidSementic == interp_execute_string(&env, "await read()", &res));
+    CU_ASSERT(-ERR_InvalidSementic == interp_execute_string(&env, "def both() { yield await read() }", &res));
+
+    env_deinit(&env);
+}
+
+static val_t test_async_subscribe(env_t *env, int ac, val_t *av)
+{
+    handle_t h;
+
+    if (ac > 0 && val_is_function(av) && 0 != (h = env_handle_new(env, av))) {
+        return val_mk_number(h);
+    }
+
+    return val_mk_undefined();
+}
+
+static val_t test_async_unsubscribe(env_t *env, int ac, val_t *av)
+{
+    return val_mk_boolean(ac > 0 && val_is_number(av) && 0 == env_handle_release(env, val_2_integer(av)));
+}
+
+static void test_async_handle(void)
+{
+    env_t env;
+    val_t *res;
+    native_t native_entry[] = {
+        {"subscribe",   test_async_subscribe},
+        {"unsubscribe", test_async_unsubscribe},
+    };
+    handle_t h[24], old;
+    int i;
+
+    gc_count = 0;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+    CU_ASSERT(0 == env_native_set(&env, native_entry, 2));
+    CU_ASSERT(0 == env_callback_set(&env, gc_callback));
+    CU_ASSERT(NULL == env_handle_get(&env, 1));
+
+    // table grows, callbacks are kept by gc
+    CU_ASSERT(0 < interp_execute_string(&env, "var n = 0, s; def on(k) { return def() { n += k } } def fire() { n += 1 }", &res));
+    for (i = 0; i < 24; i++) {
+        CU_ASSERT(0 < interp_execute_string(&env, i % 5 ? "subscribe(fire)" : "subscribe(on(1))", &res) && val_is_number(res));
+        h[i] = val_2_integer(res);
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "for i in 0..100 { s = 'gar' + 'bage' }", &res));
+    CU_ASSERT(gc_count > 0);
+
+    for (i = 0; i < 24; i++) {
+        val_t *fn = env_handle_get(&env, h[i]);
+
+        CU_ASSERT_FATAL(fn && val_is_function(fn));
+        test_async_call(&env, fn);
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "n == 24", &res) && val_is_true(res));
+
+    // released one is stale, the slot is reused
+    for (i = 0; i < 24; i += 2) {
+        CU_ASSERT(0 == env_handle_release(&env, h[i]));
+    }
+    CU_ASSERT(-1 == env_handle_release(&env, h[0]));
+    CU_ASSERT(NULL == env_handle_get(&env, h[0]));
+
+    old = h[22];
+    CU_ASSERT(0 < interp_execute_string(&env, "var x = subscribe(on(100)); unsubscribe(x) && !unsubscribe(x)", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "x = subscribe(on(100))", &res) && val_is_number(res));
+    h[22] = val_2_integer(res);
+    CU_ASSERT(h[22] != old && (h[22] & 0xFFFF) == (old & 0xFFFF));
+    CU_ASSERT(NULL == env_handle_get(&env, old));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "n = 0", &res));
+    for (i = 0; i < 24; i++) {
+        val_t *fn = env_handle_get(&env, h[i]);
+
+        if (fn) {
+            test_async_call(&env, fn);
+        }
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "n == 112", &res) && val_is_true(res));
+
+    // slot is retired before its generation wrap
+    old = env_handle_new(&env, res);
+    CU_ASSERT(0 != old && 0 == env_handle_release(&env, old));
+    for (i = 0; i < 0x10000; i++) {
+        handle_t x = env_handle_new(&env, res);
+
+        if ((x & 0xFFFF) != (old & 0xFFFF) || env_handle_release(&env, x)) {
+            break;
+        }
+        h[0] = x;
+    }
+    CU_ASSERT(i < 0x10000 && (h[0] >> 16) == 0xFFFF);
+    CU_ASSERT(NULL == env_handle_get(&env, old) && NULL == env_handle_get(&env, h[0]));
+    CU_ASSERT(-1 == env_handle_release(&env, h[0]));
+
+    env_deinit(&env);
+}
+
 CU_pSuite test_lang_async_entry()
 {
     CU_pSuite suite = CU_add_suite("lang async execute", test_setup, test_clean);
 
     if (suite) {
         CU_add_test(suite, "async common", test_async_common);
+        CU_add_test(suite, "async await", test_async_await);
+        CU_add_test(suite, "async handle", test_async_handle);
     }
 
     return suite;
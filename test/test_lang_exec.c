@@ -29,6 +29,11 @@ SOFTWARE.
 #include "cunit/CUnit.h"
 #include "cunit/CUnit_Basic.h"
 
+#include "lang/array.h"
+#include "lang/buffer.h"
+#include "lang/map.h"
+#include "lang/bcode.h"
+#include "lang/function.h"
 #include "lang/interp.h"
 
 
@@ -39,7 +44,7 @@ SOFTWARE.
 #define SYM_MEM_SPACE   1024
 #define ENV_BUF_SIZE    (sizeof(val_t) * STACK_SIZE + HEAP_SIZE + EXE_MEM_SPACE + SYM_MEM_SPACE)
 
-uint8_t env_buf[ENV_BUF_SIZE];
+static uint8_t env_buf[ENV_BUF_SIZE];
 
 static int test_setup()
 {
@@ -445,6 +450,230 @@ static void test_exec_while(void)
     env_deinit(&env);
 }
 
+// Count instruction of name in code of script, and get the code size
+static int test_code_count(val_t *v, const char *op, int *size)
+{
+    function_t *fn = (function_t *)val_2_intptr(v);
+    const uint8_t *code = function_code(fn);
+    const char *name;
+    int off = 0, n = 0, param1, param2;
+
+    *size = function_size(fn);
+    while (off < *size) {
+        bcode_parse(code, &off, &name, &param1, &param2);
+        n += !strcmp(name, op);
+    }
+
+    return n;
+}
+
+static void test_exec_optimize(void)
+{
+    env_t env;
+    val_t *res;
+    int size;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // dead code after return
+    CU_ASSERT(0 < interp_execute_string(&env, "def f(a) { if (!a) return 1 else return 2; a = 3; return a}", &res) && val_is_script(res));
+    CU_ASSERT(0 == test_code_count(res, "STORE_VAR_POP", &size) && 0 == test_code_count(res, "LOGIC_NOT", &size));
+    CU_ASSERT(2 == test_code_count(res, "RET", &size) && 13 == size);
+    CU_ASSERT(0 < interp_execute_string(&env, "f(0) == 1 && f(1) == 2", &res) && val_is_true(res));
+
+    // inverted condition of loop, in short jumps
+    CU_ASSERT(0 < interp_execute_string(&env, "def w() { var a = 0; while (!(a == 5)) { a = a + 1 } return a }", &res) && val_is_script(res));
+    CU_ASSERT(0 == test_code_count(res, "LOGIC_NOT", &size) && 0 == test_code_count(res, "JMP", &size));
+    CU_ASSERT(1 == test_code_count(res, "POP_SJMP_T", &size) && 1 == test_code_count(res, "SJMP", &size) && 29 == size);
+    CU_ASSERT(0 < interp_execute_string(&env, "w()", &res) && val_is_number(res) && 5 == val_2_integer(res));
+
+    // constant condition of loop is resolved, the false one is removed
+    CU_ASSERT(0 < interp_execute_string(&env, "def t() { var c = 0; while (false) { c = 0 } while (true) { c = c + 1; if (c > 9) break; } return c }", &res) && val_is_script(res));
+    CU_ASSERT(0 == test_code_count(res, "PUSH_TRUE", &size) && 0 == test_code_count(res, "PUSH_FALSE", &size));
+    CU_ASSERT(0 == test_code_count(res, "JMP", &size) && 0 == test_code_count(res, "SJMP", &size));
+    CU_ASSERT(1 == test_code_count(res, "TGT_SJMP_F", &size) && 26 == size);
+    CU_ASSERT(0 < interp_execute_string(&env, "t()", &res) && val_is_number(res) && 10 == val_2_integer(res));
+
+    // jump to jump, and condition with logic not
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = 0, b = 0, c = 0;", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "while (!(a == 5)) { a = a + 1; if (!(a - 3)) { continue } else { b = b + 1 } }", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a == 5 && b == 4", &res) && val_is_true(res));
+
+    // constant condition
+    CU_ASSERT(0 < interp_execute_string(&env, "while (false) { a = 0 }", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "while (true) { c = c + 1; if (c > 9) break; }", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a == 5 && c == 10", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "if (true) 1 else 2", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a ? (b ? 1 : 2) : 3", &res) && val_is_number(res) && 1 == val_2_integer(res));
+
+    // value of the last expression is kept
+    CU_ASSERT(0 < interp_execute_string(&env, "1; 2; a", &res) && val_is_number(res) && 5 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def g() { 1; 'a'; undefined; return; }", &res) && val_is_script(res));
+    CU_ASSERT(1 == test_code_count(res, "RET0", &size) && 1 == size);
+    CU_ASSERT(0 < interp_execute_string(&env, "g()", &res) && val_is_undefined(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_number_type(void)
+{
+    env_t env;
+    val_t *res;
+
+    char *sum = "def sum(n) {                   \
+                   var s = 0, i = 0;            \
+                   while (i < n) {              \
+                       s = s + i * 2 - 1;       \
+                       i += 1;                  \
+                   }                            \
+                   return s;                    \
+                 }";
+    char *bit = "def bit(n) {                   \
+                   var x = 1;                   \
+                   while (n > 0) {              \
+                       x = (x << 3 | x >> 1) & 255; \
+                       n -= 1                   \
+                   }                            \
+                   return x % 7 + (x ^ 1);      \
+                 }";
+    char *mix = "def mix(n) {                   \
+                   var s = 0, t = 1;            \
+                   while (n) {                  \
+                       if (n == 2) { s = 'x'; t = 'y' } \
+                       s = s + t;               \
+                       n -= 1                   \
+                   }                            \
+                   return s;                    \
+                 }";
+    char *cap = "def cap() {                    \
+                   var a = 1;                   \
+                   def set() { a = 'a' }        \
+                   set();                       \
+                   return a + 'b';              \
+                 }";
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // all numbers in loop
+    CU_ASSERT(0 < interp_execute_string(&env, sum, &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "sum(0)", &res) && val_is_number(res) && 0 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "sum(10)", &res) && val_is_number(res) && 80 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, bit, &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "bit(0)", &res) && val_is_number(res) && 1 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "bit(2)", &res) && val_is_number(res) && 74 == val_2_integer(res));
+
+    // variable type changed in loop
+    CU_ASSERT(0 < interp_execute_string(&env, mix, &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "mix(1)", &res) && val_is_number(res) && 1 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "mix(4)", &res) && val_is_string(res) && !strcmp("xyy", val_2_cstring(res)));
+
+    // variable modified by closure
+    CU_ASSERT(0 < interp_execute_string(&env, cap, &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "cap()", &res) && val_is_string(res) && !strcmp("ab", val_2_cstring(res)));
+
+    // divide by zero, compare of number
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = 1, b = 0, c;", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c = a / b", &res) && val_is_nan(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c = a % b", &res) && val_is_nan(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a = 3; b = 2; a / b * 2 == 3 && a % b == 1", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a > b && a >= b && b < a && b <= a && a != b", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b = 3; a == b && !(a != b) && a >= b && a <= b", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a -= 1; a += 2; a == 4", &res) && val_is_true(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_quicken(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // number add, fall back when guard failed
+    CU_ASSERT(0 < interp_execute_string(&env, "def add(x, y) return x + y", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "add(1, 2) == 3 && add(3, 4) == 7", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "add('a', 'b')", &res) && val_is_string(res) && !strcmp("ab", val_2_cstring(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "add(5, 6)", &res) && val_is_number(res) && 11 == val_2_integer(res));
+
+    // array element
+    CU_ASSERT(0 < interp_execute_string(&env, "def elem(x, i) return x[i]", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "elem([1, 2], 1) == 2 && elem([3], 0) == 3", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "elem('ab', 1)", &res) && val_is_string(res) && !strcmp("b", val_2_cstring(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "elem([3], 5)", &res) && val_is_undefined(res));
+
+    // cached property, with other layout of object
+    CU_ASSERT(0 < interp_execute_string(&env, "def prop(x) return x.y", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "prop({x: 1, y: 2}) == 2 && prop({x: 3, y: 4}) == 4", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "prop({y: 5})", &res) && val_is_number(res) && 5 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "prop({x: 6})", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "prop([1])", &res) && val_is_undefined(res));
+
+    // cached method
+    CU_ASSERT(0 < interp_execute_string(&env, "def meth(o) return o.f()", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "meth({f: def() return 1})", &res) && val_is_number(res) && 1 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "meth({g: 0, f: def() return 2})", &res) && val_is_number(res) && 2 == val_2_integer(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_cmp_jmp(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "def c(a, b) { var r = 0; if (a == b) r = 1; if (a != b) r = r + 2; if (a > b) r = r + 4; return r }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def d(a, b) { var r = 0; if (a >= b) r = 1; if (a < b) r = r + 2; if (a <= b) r = r + 4; return r }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c(1, 1) == 1 && c(2, 1) == 6 && c(1, 2) == 2", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "d(1, 1) == 5 && d(2, 1) == 1 && d(1, 2) == 6", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c('a', 'a') == 1 && c('b', 'a') == 6 && d('a', 'b') == 6", &res) && val_is_true(res));
+
+    // compare of mixed type is false both ways
+    CU_ASSERT(0 < interp_execute_string(&env, "c(1, 'a') == 2 && c('a', 1) == 2", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "d(1, 'a') == 0 && d('a', 1) == 0", &res) && val_is_true(res));
+
+    // loop with break & continue
+    CU_ASSERT(0 < interp_execute_string(&env, "def f(n) { var i = 0, s = 0; while (i < n) { i = i + 1; if (i == 3) continue; if (i > 6) break; s = s + i } return s }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "f(10)", &res) && val_is_number(res) && 18 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "f(4)", &res) && val_is_number(res) && 7 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "f(0)", &res) && val_is_number(res) && 0 == val_2_integer(res));
+
+    // loop at top level
+    CU_ASSERT(0 < interp_execute_string(&env, "var i = 0; while (i <= 5) i = i + 1;", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "i", &res) && val_is_number(res) && 6 == val_2_integer(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_store_var(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "def sum(n) { var i = 0, s = 0, t; while (i < n) { i += 1; s = s + i; t = s } t -= 1; return t }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "sum(10)", &res) && val_is_number(res) && 54 == val_2_integer(res));
+
+    // result of assignment is kept in expression
+    CU_ASSERT(0 < interp_execute_string(&env, "var a, b; a = b = 3; a", &res) && val_is_number(res) && 3 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b = 4, a = b + 1", &res) && val_is_number(res) && 5 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a + b == 9", &res) && val_is_true(res));
+
+    // string and variable of outer scope
+    CU_ASSERT(0 < interp_execute_string(&env, "def cat(x) { var s = 'a'; s += x; b -= 1; return s }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "cat('b')", &res) && val_is_string(res) && !strcmp("ab", val_2_cstring(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "b == 3", &res) && val_is_true(res));
+
+    // sub on string is error
+    CU_ASSERT(0 < interp_execute_string(&env, "def bad() { var s = 'a'; s -= 1 }", &res) && val_is_function(res));
+    CU_ASSERT(0 > interp_execute_string(&env, "bad()", &res));
+
+    env_deinit(&env);
+}
+
 static void test_exec_function(void)
 {
     env_t env;
@@ -767,6 +996,562 @@ static void test_exec_array(void)
     env_deinit(&env);
 }
 
+static void test_exec_foreach(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = [], n = 0, sum = 0; while (n < 100) { a.push(n); n += 1 }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.foreach(def(v, k) { sum += v + k })", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "sum == 9900", &res) && val_is_true(res));
+
+    // nested loop, and gc in callback
+    CU_ASSERT(0 < interp_execute_string(&env, "var s = '', o = {a: 'x', b: 'y'}; sum = 0", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.foreach(def(v) { o.foreach(def(c, k) { s = k + c; sum += 1 }) })", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "sum == 200 && s == 'by'", &res) && val_is_true(res));
+
+    // in function, result of foreach is undefined
+    CU_ASSERT(0 < interp_execute_string(&env, "def f(x) { var t = 0; x.foreach(def(v) { sum = v }) return sum }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "f([1, 2, 3]) == 3", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def g(x) { return x.foreach(def(v) { return v }) }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "g([1, 2, 3])", &res) && val_is_undefined(res));
+
+    // element appended in loop is not visited
+    CU_ASSERT(0 < interp_execute_string(&env, "var b = [1, 2]; n = 0", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.foreach(def(v) { b.push(v); n += 1 })", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "n == 2 && b.length() == 4", &res) && val_is_true(res));
+
+    // error in callback stop the loop
+    CU_ASSERT(-ERR_InvalidCallor == interp_execute_string(&env, "b.foreach(def(v) { v() })", &res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_array_library(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = [1, 2, 3, 4], b", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b = a.map(def(v, k) { return v * k })", &res) && val_is_array(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.length() == 4 && b[0] == 0 && b[3] == 12", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b = a.filter(def(v) { return v & 1 })", &res) && val_is_array(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.length() == 2 && b[0] == 1 && b[1] == 3", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.reduce(def(s, v) { return s + v })", &res) && val_is_number(res) && 10 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.reduce(def(s, v, k) { return s + k }, 10)", &res) && val_is_number(res) && 16 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "[].reduce(def(s, v) { return s + v })", &res) && val_is_undefined(res));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "b = a.slice(1, -1)", &res) && val_is_array(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.length() == 2 && b[0] == 2 && b[1] == 3", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.slice(3, 1).length() == 0 && a.slice().length() == 4", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b = a.concat(b, 'x')", &res) && val_is_array(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.length() == 7 && b[4] == 2 && b[6] == 'x'", &res) && val_is_true(res));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "b.indexOf(3)", &res) && val_is_number(res) && 2 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.indexOf(3, 3)", &res) && val_is_number(res) && 5 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.indexOf('x')", &res) && val_is_number(res) && 6 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.indexOf(a)", &res) && val_is_number(res) && -1 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "'hello'.indexOf('l')", &res) && val_is_number(res) && 2 == val_2_double(res));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "a.join() == '1,2,3,4'", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "[1 / 2, 'a', true].join(' - ') == '0.5 - a - true'", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "[].join() == ''", &res) && val_is_true(res));
+
+    // result array is allocated at final size
+    CU_ASSERT(0 < interp_execute_string(&env, "var n = 0; while (n < 50) { b = a.map(def(v) { return v + 1 }).join(); n += 1 }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b == '2,3,4,5'", &res) && val_is_true(res));
+
+    CU_ASSERT(-ERR_InvalidInput == interp_execute_string(&env, "a.map(1)", &res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_array_sort(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "[3, 1, 2].sort().join() == '1,2,3'", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "['b', 'c', 'a'].sort().join() == 'a,b,c'", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "['b', 2, 'a', 1].sort().join() == '1,2,a,b'", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "[].sort().length() == 0", &res) && val_is_true(res));
+
+    // longer than a run, sorted in place
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = [], n = 0; while (n < 40) { a.push((n * 7) % 40); n += 1 }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.sort() == a", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var ok = true; a.foreach(def(v, k) { if (v != k) ok = false }); ok", &res) && val_is_true(res));
+
+    // compare function of user, stable
+    CU_ASSERT(0 < interp_execute_string(&env, "a.sort(def(x, y) { return y - x })[0] == 39", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.sort(def(x, y) { return x % 3 - y % 3 }); ok = true", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.foreach(def(v, k) { if (k && a[k - 1] % 3 == v % 3 && a[k - 1] < v) ok = false }); ok", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a[0] == 39 && a[39] == 2", &res) && val_is_true(res));
+
+    // gc in compare function
+    CU_ASSERT(0 < interp_execute_string(&env, "var s; a.sort(def(x, y) { s = 'x' + 'y'; return x - y })[39] == 39", &res) && val_is_true(res));
+
+    CU_ASSERT(-ERR_InvalidInput == interp_execute_string(&env, "a.sort(def(x, y) { a.pop(); return 0 })", &res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_array_kind(void)
+{
+    env_t env;
+    val_t *res;
+    int i;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = [1, 2, 3], b = [], c = [1, 'x'], s = 'a'", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a", &res) && array_is_number((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "b", &res) && array_is_number((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "c", &res) && !array_is_number((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.map(def(v) { return v * 2 })", &res) && array_is_number((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.concat(c)", &res) && !array_is_number((array_t *)val_2_intptr(res)));
+
+    // number operation keep the kind, others change it
+    CU_ASSERT(0 < interp_execute_string(&env, "a[0] += 1; b.push(1, 2)", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a", &res) && array_is_number((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "a[1] /= 0; a", &res) && !array_is_number((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.unshift(s + 'b'); b", &res) && !array_is_number((array_t *)val_2_intptr(res)));
+
+    // elements stored after kind changed are kept by gc
+    for (i = 0; i < 20; i++) {
+        CU_ASSERT(0 < interp_execute_string(&env, "a[2] = s + 'c'; s = s + ''", &res));
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "a[2] == 'ac' && b[0] == 'ab'", &res) && val_is_true(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_buffer(void)
+{
+    env_t env;
+    val_t *res;
+    int i;
+    native_t native_entry[] = {
+        {"Buffer", buffer_create}
+    };
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+    CU_ASSERT(0 == env_native_set(&env, native_entry, 1));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "var b = Buffer(8), s = Buffer('AB'), c = Buffer([1, 2, 257])", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.length() == 8 && b[0] == 0", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b[8]", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s.length() == 2 && s[0] == 65 && s[1] == 66", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c[2] == 1", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b[0] = 258; b[0]", &res) && val_is_number(res) && 2 == val_2_double(res));
+
+    // slice share bytes with the base
+    CU_ASSERT(0 < interp_execute_string(&env, "var v = b.slice(2, 6); v[0] = 7; b[2]", &res) && val_is_number(res) && 7 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "v.length() == 4 && b.slice(-2).length() == 2", &res) && val_is_true(res));
+
+    // integer in big and little endian
+    CU_ASSERT(0 < interp_execute_string(&env, "b.writeInt(0, 2, 258)", &res) && val_is_number(res) && 2 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b[0] == 1 && b[1] == 2", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.writeInt(0, 2, 258, true); b[0] == 2 && b[1] == 1", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.readInt(0, 2, true)", &res) && val_is_number(res) && 258 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.writeInt(4, 4, -2); b.readInt(4, 4)", &res) && val_is_number(res) && -2 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.readUInt(4, 4)", &res) && val_is_number(res) && 4294967294.0 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "v.readUInt(2, 2) == 65535", &res) && val_is_true(res));
+
+    // float
+    CU_ASSERT(0 < interp_execute_string(&env, "b.writeFloat(0, 8, 1 / 3); b.readFloat(0, 8) == 1 / 3", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.writeFloat(0, 4, 3 / 2, true); b.readFloat(0, 4, true)", &res) && val_is_number(res) && 1.5 == val_2_double(res));
+
+    // operate and assign, stored as byte, error is catchable
+    CU_ASSERT(0 < interp_execute_string(&env, "b[0] = 3; b[0] += 4", &res) && val_is_number(res) && 7 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b[0] <<= 6; b[0]", &res) && val_is_number(res) && 192 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "b[0] -= 193; b[0] |= 1; b[0] ^= 15; b[0]", &res) && val_is_number(res) && 240 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var k = 0; try { b[8] += 1 } catch (e) { k = 1 } k", &res) && val_is_number(res) && 1 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "try { b[0] %= 0 } catch (e) { k = 2 } k == 2 && b[0] == 240", &res) && val_is_true(res));
+
+    // slice is kept by gc, after the base is dropped
+    CU_ASSERT(0 < interp_execute_string(&env, "v[1] = 9; b = 0; var t = 'a'", &res));
+    for (i = 0; i < 20; i++) {
+        CU_ASSERT(0 < interp_execute_string(&env, "t = t + 'b'; t = 'a'", &res));
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "v[1] == 9 && v.length() == 4", &res) && val_is_true(res));
+
+    // out of range
+    CU_ASSERT(0 > interp_execute_string(&env, "v.readInt(2, 4)", &res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_array_sparse(void)
+{
+    env_t env;
+    val_t *res;
+    int i;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // near index make holes
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = [1, 2], s = 'a'; a[3] = 4; a.length()", &res) && val_is_number(res) && 4 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a[2]", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a", &res) && !array_is_sparse((array_t *)val_2_intptr(res)));
+
+    // far index turn array to sparse
+    CU_ASSERT(0 < interp_execute_string(&env, "a[100000] = 5; a.length()", &res) && val_is_number(res) && 100001 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a", &res) && array_is_sparse((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "a[50000]", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a[100000] += 1; a[100000] + a[3]", &res) && val_is_number(res) && 10 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.push(7); a.length()", &res) && val_is_number(res) && 100002 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.pop() == 7 && a.pop() == 6 && a.length() == 100000", &res) && val_is_true(res));
+
+    // elements of sparse array are kept by gc
+    for (i = 0; i < 20; i++) {
+        CU_ASSERT(0 < interp_execute_string(&env, "a[90000] = s + 'b'; s = s + ''", &res));
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "a[90000] == 'ab' && a[0] == 1", &res) && val_is_true(res));
+
+    // natives walk elements of sparse array, holes are not made dense
+    CU_ASSERT(0 < interp_execute_string(&env, "var k = 0; a.foreach(def(v, i) { k = k + i }); k", &res) && val_is_number(res) && 90004 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.reduce(def(s, v, i) { return s + i })", &res) && val_is_number(res) && 90005 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.filter(def(v) { return v != 2 }).length()", &res) && val_is_number(res) && 3 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var c = a.map(def(v, i) { return i }); c.length() == 100000 && c[90000] == 90000", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c", &res) && array_is_sparse((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.indexOf('ab') == 90000 && a.indexOf(4, 2) == 3 && a.indexOf(a[2]) == 2 && a.indexOf(7) == -1", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.join('') == '124ab' && a.slice(0, 5).join('-') == '1-2--4-'", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c = a.slice(89999); c.length() == 10001 && c[1] == 'ab' && c.indexOf(a[2]) == 0", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c", &res) && array_is_sparse((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "c = a.concat([8], 9); c.length() == 100002 && c[90000] == 'ab' && c[100000] == 8 && c[100001] == 9", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c = a.slice(0, 90000).concat(3).sort(); c.length() == 90001 && c[2] == 3 && c[3] == 4 && c.indexOf(a[2]) == 4", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "c", &res) && array_is_sparse((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.unshift(0) == 100001 && a[90001] == 'ab' && a.shift() == 0 && a.shift() == 1 && a[89999] == 'ab'", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.unshift(1) == 100000 && a[0] == 1 && a[3] == 4", &res) && val_is_true(res));
+    // Note: results are released, heap of test is small
+    CU_ASSERT(0 < interp_execute_string(&env, "c = 0; a", &res) && array_is_sparse((array_t *)val_2_intptr(res)));
+
+    // filled sparse array turn back to dense
+    CU_ASSERT(0 < interp_execute_string(&env, "var b = []; b[70] = 1; b", &res) && array_is_sparse((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "var i = 0; while (i < 70) { b[i] = i; i = i + 1 }; b", &res) && !array_is_sparse((array_t *)val_2_intptr(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "b.length() == 71 && b[69] == 69 && b[70] == 1", &res) && val_is_true(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_array_large(void)
+{
+    static uint8_t heap[1024 * 4096];
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, heap, sizeof(heap), NULL, STACK_SIZE));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = [], i = 0; while (i < 70000) { a.push(i); i = i + 1 }; a.length()", &res) && val_is_number(res) && 70000 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a[69999] == 69999 && a.indexOf(66000) == 66000", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.unshift(-1); a.shift() == -1 && a.slice(65536).length() == 4464", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a.reduce(def(s, v) { return s + v }, 0)", &res) && val_is_number(res) && 2449965000.0 == val_2_double(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_map(void)
+{
+    env_t env;
+    val_t *res;
+    int i;
+    native_t native_entry[] = {
+        {"Map", map_create},
+        {"Set", set_create}
+    };
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+    CU_ASSERT(0 == env_native_set(&env, native_entry, 2));
+
+    // key is number, string by content or object by identity
+    CU_ASSERT(0 < interp_execute_string(&env, "var m = Map(), o = {}, s = 'k'; m.set(1, 'a').set('ke', 2).set(o, 3).size()", &res) && val_is_number(res) && 3 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "m.get(2 - 1)", &res) && val_is_string(res) && !strcmp("a", val_2_cstring(res)));
+    CU_ASSERT(0 < interp_execute_string(&env, "m.get(s + 'e') + m.get(o)", &res) && val_is_number(res) && 5 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "m.get({})", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "m.set(1, 'b'); m.size() == 3 && m.get(1) == 'b'", &res) && val_is_true(res));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "m.delete('ke') && !m.delete('ke') && !m.has('ke') && m.size() == 2", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var n = 0; m.foreach(def(v, k) { n = n + 1 }); n", &res) && val_is_number(res) && 2 == val_2_double(res));
+
+    // keys of object are found after moved by gc
+    for (i = 0; i < 20; i++) {
+        CU_ASSERT(0 < interp_execute_string(&env, "s = s + 'x'; m.set(s, 1); m.delete(s)", &res));
+    }
+    CU_ASSERT(0 < interp_execute_string(&env, "m.get(o) == 3 && m.get(1) == 'b' && m.size() == 2", &res) && val_is_true(res));
+
+    // set
+    CU_ASSERT(0 < interp_execute_string(&env, "var t = Set([1, 2, 2, 'a']); t.size()", &res) && val_is_number(res) && 3 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "t.add(o).add(3).has(o) && t.has('a') && !t.has('b')", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "n = 0; t.foreach(def(v) { if (v == 2) n = n + 1 }); n", &res) && val_is_number(res) && 1 == val_2_double(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "t.toString()", &res) && val_is_string(res) && !strcmp("Set", val_2_cstring(res)));
+
+    CU_ASSERT(0 > interp_execute_string(&env, "t.get(1)", &res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_in(void)
+{
+    env_t env;
+    val_t *res;
+    int symbal_hold;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    CU_ASSERT(0 < interp_execute_string(&env, "var d = {a: 1}, a = [1, 2, 3, 4, 5, 6], g = [1, 'x', d], s = [], k = 'ab' + 'sent'", &res));
+
+    // property of dictionary, absent name is not added to symbal
+    symbal_hold = env.symbal_tbl_hold;
+    CU_ASSERT(0 < interp_execute_string(&env, "'a' in d", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "k in d", &res) && val_is_boolean(res) && !val_is_true(res));
+    CU_ASSERT(symbal_hold == env.symbal_tbl_hold);
+
+    // value of array
+    CU_ASSERT(0 < interp_execute_string(&env, "6 in a && 1 in a && !(7 in a) && !('1' in a)", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "'x' in g && d in g && !({} in g) && !(2 in g)", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s[100] = 3; 3 in s && !(100 in s)", &res) && val_is_true(res));
+
+    // sub string
+    CU_ASSERT(0 < interp_execute_string(&env, "'ell' in 'hello' && !('le' in 'hello')", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "1 in 2", &res) && val_is_boolean(res) && !val_is_true(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_for(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // range
+    CU_ASSERT(0 < interp_execute_string(&env, "var s = 0; for i in 0..10 { s += i }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s == 45 && i == 9", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for (i in 3..1) s += 1; s == 0", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for i in 0..3 { i = 10; s += 1 } s == 3", &res) && val_is_true(res));
+
+    // break & continue
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for i in 0..10 { if (i == 5) break; s += i } s == 10", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for i in 0..10 { if (i % 2) continue; s += i } s == 20", &res) && val_is_true(res));
+
+    // array
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for x in [1, 2, 3, 4] { s += x * 10 } s == 100", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var a = [1, 2]; s = 0; for x in a { if (a.length() < 5) a.push(x); s += 1 } s == 5", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a = []; a[70] = 5; s = 0; for x in a { if (x) s += x; else s += 1 } s == 75", &res) && val_is_true(res));
+
+    // nested, in function
+    CU_ASSERT(0 < interp_execute_string(&env, "def f(n) { var t = 0; for i in 0..n { for j in 0..i { t += 1 } } return t }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "f(5) == 10", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def g(a) { var t = 0; for v in a { t += v; if (t > 5) return t } return -1 }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "g([1, 2, 3, 4]) == 6 && g([1]) == -1", &res) && val_is_true(res));
+
+    // not iterable
+    CU_ASSERT(0 > interp_execute_string(&env, "for x in 5 { }", &res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_switch(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // dense integer, share the block & default
+    CU_ASSERT(0 < interp_execute_string(&env, "def f(x) { var r; switch (x) { case 1: r = 10 case 2, 3: r = 20 case 5: case 6: r = 30 default: r = 0 } return r }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "f(1) == 10 && f(2) == 20 && f(3) == 20 && f(5) == 30 && f(6) == 30", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "f(4) == 0 && f(7) == 0 && f(-1) == 0 && f(3 / 2) == 0 && f('1') == 0", &res) && val_is_true(res));
+
+    // sparse integer
+    CU_ASSERT(0 < interp_execute_string(&env, "def g(x) { switch x { case -100: return 1 case 0: return 2 case 1000: return 3 case 7: return 4 } return 0 }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "g(-100) == 1 && g(0) == 2 && g(1000) == 3 && g(7) == 4 && g(8) == 0 && g('a') == 0", &res) && val_is_true(res));
+
+    // string, break out of switch
+    CU_ASSERT(0 < interp_execute_string(&env, "def h(x) { switch x { case 'get': return 1 case 'set': return 2 case 'nop': break; default: return 0 } return 9 }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "h('get') == 1 && h('se' + 't') == 2 && h('nop') == 9 && h('x') == 0 && h(1) == 0", &res) && val_is_true(res));
+
+    // break & continue in loop
+    CU_ASSERT(0 < interp_execute_string(&env, "var s = 0; for i in 0..10 { switch i { case 2: continue case 5: break default: s += i } } s == 38", &res) && val_is_true(res));
+
+    // duplicated or mixed case
+    CU_ASSERT(0 > interp_execute_string(&env, "switch 1 { case 1: case 1: }", &res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_try(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // thrown value, nested
+    CU_ASSERT(0 < interp_execute_string(&env, "var r = 0; try { throw 5 } catch (e) { r = e + 1 } r == 6", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "try { try { throw 'in' } catch (e) { throw e + 'ner' } } catch (e) { r = e } r == 'inner'", &res) && val_is_true(res));
+
+    // thrown from callee, call in try is not tail call
+    CU_ASSERT(0 < interp_execute_string(&env, "def g(x) { if (x > 2) throw x * 10; return x }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def h(x) { try { return g(x) } catch (e) { return e + 1 } }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "h(1) == 1 && h(5) == 51", &res) && val_is_true(res));
+
+    // stack restored in loop
+    CU_ASSERT(0 < interp_execute_string(&env, "var s = 0; for i in 0..5 { try { if (i == 2) throw i; s += i } catch { s += 100 } } s == 108", &res) && val_is_true(res));
+
+    // callback of native, error of native is caught as the error code
+    CU_ASSERT(0 < interp_execute_string(&env, "try { [1, 2, 3].foreach(def(v) { if (v == 2) throw v; s = v }) } catch (e) { s += e * 10 } s == 21", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "try { s(1) } catch (e) { r = e } r == 402", &res) && val_is_true(res));
+
+    // uncaught
+    CU_ASSERT(-ERR_Exception == interp_execute_string(&env, "throw 9", &res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_budget(void)
+{
+    env_t env;
+    val_t *res;
+    int n;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+    interp_budget_set(&env, 10);
+
+    // straight-line code pays nothing
+    CU_ASSERT(1 == interp_execute_string(&env, "var i = 0, s = 0; i = i + 1; i = i + 1; i == 2", &res) && val_is_true(res));
+
+    // paused at backward jump, go on from where it stop
+    CU_ASSERT(INTERP_YIELD == interp_execute_string(&env, "while (i < 100) { i = i + 1 } i", &res));
+    for (n = 1; INTERP_YIELD == interp_resume(&env, &res); n++)
+        ;
+    CU_ASSERT(9 == n && val_is_number(res) && 100 == val_2_integer(res));
+
+    // paused at call
+    CU_ASSERT(1 == interp_execute_string(&env, "def fib(x) { if (x < 2) return x; return fib(x - 1) + fib(x - 2) }", &res));
+    CU_ASSERT(INTERP_YIELD == interp_execute_string(&env, "fib(10)", &res));
+    while (INTERP_YIELD == (n = interp_resume(&env, &res)))
+        ;
+    CU_ASSERT(1 == n && val_is_number(res) && 55 == val_2_integer(res));
+
+    // callback of native is not paused, and callback of foreach is paused
+    CU_ASSERT(INTERP_YIELD == interp_execute_string(&env, "[3, 1, 2].sort(def(a, b) { var k = 0; while (k < 20) k = k + 1; return a - b })[0]", &res));
+    CU_ASSERT(1 == interp_resume(&env, &res) && val_is_number(res) && 1 == val_2_integer(res));
+    CU_ASSERT(INTERP_YIELD == interp_execute_string(&env, "for x in 0..20 { [x].foreach(def(v) { s = s + v }) } s", &res));
+    while (INTERP_YIELD == interp_resume(&env, &res))
+        ;
+    CU_ASSERT(val_is_number(res) && 190 == val_2_integer(res));
+
+    // paused execution is abandoned by the new one
+    CU_ASSERT(INTERP_YIELD == interp_execute_string(&env, "def spin() { while (true) i = i + 1 } spin()", &res));
+    CU_ASSERT(1 == interp_execute_string(&env, "i > 100", &res) && val_is_true(res));
+    CU_ASSERT(0 > interp_resume(&env, &res));
+
+    // no limit
+    interp_budget_set(&env, 0);
+    CU_ASSERT(1 == interp_execute_string(&env, "fib(15)", &res) && val_is_number(res) && 610 == val_2_integer(res));
+
+    env_deinit(&env);
+}
+
+static val_t test_native_interrupt(env_t *env, int ac, val_t *av)
+{
+    (void) ac;
+    (void) av;
+
+    env_interrupt(env);
+    return val_mk_undefined();
+}
+
+static void test_exec_interrupt(void)
+{
+    env_t env;
+    val_t *res;
+    native_t native_entry[] = {
+        {"interrupt", test_native_interrupt},
+    };
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+    CU_ASSERT(0 == env_native_set(&env, native_entry, 1));
+
+    // stopped at the next backward jump or call, not catchable
+    CU_ASSERT(0 < interp_execute_string(&env, "var i = 0; def spin() { while (true) { i = i + 1; if (i == 10) interrupt() } }", &res));
+    CU_ASSERT(-ERR_Interrupted == interp_execute_string(&env, "try { spin() } catch (e) { i = -1 }", &res));
+    CU_ASSERT(-ERR_Interrupted == interp_execute_string(&env, "[1, 2].map(def(v) { interrupt(); return v })", &res));
+    CU_ASSERT(-ERR_Interrupted == interp_execute_string(&env, "[3, 1, 2].sort(def(a, b) { interrupt(); return a - b })", &res));
+
+    // env is reusable, the executed is kept
+    CU_ASSERT(0 < interp_execute_string(&env, "i == 10", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def f(n) { if (n < 2) return n; return f(n - 1) + f(n - 2) } f(10)", &res) && val_is_number(res) && 55 == val_2_integer(res));
+
+    // interrupt before the execution is kept, or dropped by clear
+    env_interrupt(&env);
+    CU_ASSERT(-ERR_Interrupted == interp_execute_string(&env, "f(5)", &res));
+    env_interrupt(&env);
+    env_interrupt_clear(&env);
+    CU_ASSERT(0 < interp_execute_string(&env, "f(5)", &res) && val_is_number(res) && 5 == val_2_integer(res));
+
+    // interrupt the paused one
+    interp_budget_set(&env, 5);
+    CU_ASSERT(INTERP_YIELD == interp_execute_string(&env, "while (true) { i = i + 1 }", &res));
+    env_interrupt(&env);
+    CU_ASSERT(-ERR_Interrupted == interp_resume(&env, &res));
+    CU_ASSERT(0 > interp_resume(&env, &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "i > 10", &res) && val_is_true(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_generator(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // body run by next, until yield
+    CU_ASSERT(0 < interp_execute_string(&env, "def count(n) { var i = 0; while (i < n) { yield i; i += 1 } }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var g = count(3); g.next() == 0 && g.next() == 1 && g.next() == 2 && !g.done()", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "g.next(); g.done()", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def two() { yield 1; return 7 } g = two(); g.next() == 1 && g.next() == 7 && g.done()", &res) && val_is_true(res));
+
+    // for-in, the stack of loop in generator is saved
+    CU_ASSERT(0 < interp_execute_string(&env, "def squares(n) { for i in 0..n { yield i * i } }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var s = 0; for v in squares(5) { s += v } s == 30", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "g = count(10); for v in g { if (v == 2) break } g.next() == 3", &res) && val_is_true(res));
+
+    // pipeline
+    CU_ASSERT(0 < interp_execute_string(&env, "def map(g, f) { for v in g { yield f(v) } }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for v in map(count(100), def(x) { return x * 2 }) { s += v } s == 9900", &res) && val_is_true(res));
+
+    // closure of generator, shares variable with it
+    CU_ASSERT(0 < interp_execute_string(&env, "def acc() { var n = 0, inc = def() { n += 1 }; while (n < 3) { inc(); yield n } }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for v in acc() { s = s * 10 + v } s == 123", &res) && val_is_true(res));
+
+    // error in generator, the raised one is finished
+    CU_ASSERT(0 < interp_execute_string(&env, "def safe() { for i in 0..3 { try { if (i == 1) throw i; yield i } catch (e) { yield e * 10 } } }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for v in safe() { s = s * 100 + v } s == 1002", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def bad() { yield 1; throw 2 } var r = 0; g = bad()", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "try { for v in g { r += v } } catch (e) { r = e * 10 + r } r == 21 && g.done()", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def again() { yield g.next() } g = again()", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "try { g.next() } catch (e) { r = e } r == 402 && g.done()", &res) && val_is_true(res));
+
+    // values saved are kept by gc
+    CU_ASSERT(0 < interp_execute_string(&env, "def words(n) { var w = ''; for i in 0..n { w = w + 'w'; yield w } }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s = 0; for w in words(300) { s += w.length() } s == 45150", &res) && val_is_true(res));
+
+    CU_ASSERT(-ERR_InvalidSementic == interp_execute_string(&env, "yield 1", &res));
+
+    env_deinit(&env);
+}
+
 static void test_exec_closure(void)
 {
     env_t env;
@@ -799,6 +1584,70 @@ static void test_exec_closure(void)
     env_deinit(&env);
 }
 
+static void test_exec_closure_capture(void)
+{
+    env_t env;
+    val_t *res;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // argument captured by value
+    CU_ASSERT(0 < interp_execute_string(&env, "def add(a) { def f(b) { return a + b } return f }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var a5 = add(5)", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "a5(3) == 8 && add(1)(2) == 3", &res) && val_is_true(res));
+
+    // assigned variable is shared by owner and closures
+    CU_ASSERT(0 < interp_execute_string(&env, "def mk() { var c = 0; def inc() { c += 1; return c } return inc }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var k = mk()", &res) && val_is_undefined(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "k(); k()", &res) && val_is_number(res) && 2 == val_2_integer(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "mk()() == 1", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def m2() { var x = 1; def a() { def b() { x = x * 2 } b(); return x } return a }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "var q = m2(); q(); q()", &res) && val_is_number(res) && 4 == val_2_integer(res));
+
+    // recursion of nested function, and three level of nesting
+    CU_ASSERT(0 < interp_execute_string(&env, "def outer() { def fact(n) { if (n < 2) return 1; return n * fact(n - 1) } return fact(5) }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "outer() == 120", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def l1(x) { def l2(y) { def l3(z) { return x + y + z } return l3 } return l2 }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "l1(1)(2)(3) == 6", &res) && val_is_true(res));
+
+    // global variable in nested function
+    CU_ASSERT(0 < interp_execute_string(&env, "var g = 10; def h(x) { def i() { return g + x } return i() }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "h(1) == 11", &res) && val_is_true(res));
+
+    // closures survive gc
+    CU_ASSERT(0 < interp_execute_string(&env, "var i = 0, s = 0; while (i < 300) { var t = add(i); s = s + t(1) + k(); i = i + 1 }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "s == 90900 && a5(3) == 8 && k() == 303", &res) && val_is_true(res));
+
+    env_deinit(&env);
+}
+
+static void test_exec_static_function(void)
+{
+    env_t env;
+    val_t *res;
+    int free;
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+
+    // function captured nothing is shared, closure is not
+    CU_ASSERT(0 < interp_execute_string(&env, "var fs = [], i = 0; while (i < 2) { fs.push(def() { return i }); i += 1 }", &res));
+    CU_ASSERT(0 < interp_execute_string(&env, "fs[0] == fs[1] && fs[0]() == 2", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def cl(x) { return def() { return x } }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "cl(1) != cl(1)", &res) && val_is_true(res));
+
+    // define function in loop allocate nothing
+    CU_ASSERT(0 < interp_execute_string(&env, "var n = 0", &res));
+    free = env.heap->free;
+    CU_ASSERT(0 < interp_execute_string(&env, "while (n < 1000) { def t() { return 1 } n += 1 }", &res));
+    CU_ASSERT(free == env.heap->free);
+
+    // nested function captured nothing, refer variable of main directly
+    CU_ASSERT(0 < interp_execute_string(&env, "def o(x) { def p(y) { return i + y } return p(x) }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "o(1) == 3", &res) && val_is_true(res));
+
+    env_deinit(&env);
+}
+
 static void test_exec_stack_check(void)
 {
     env_t env;
@@ -813,6 +1662,35 @@ static void test_exec_stack_check(void)
     env_deinit(&env);
 }
 
+static void test_exec_tail_call(void)
+{
+    env_t env;
+    val_t *res;
+    native_t native_entry[] = {
+        {"add", test_native_add},
+    };
+
+    CU_ASSERT_FATAL(0 == interp_env_init_interactive(&env, env_buf, ENV_BUF_SIZE, NULL, HEAP_SIZE, NULL, STACK_SIZE));
+    CU_ASSERT(0 == env_native_set(&env, native_entry, 1));
+
+    // deeper than the stack, frame is reused
+    CU_ASSERT(0 < interp_execute_string(&env, "def loop(n, acc) { if (n == 0) return acc; return loop(n - 1, acc + n) }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "loop(1000, 0) + 1", &res) && val_is_number(res) && 500501 == val_2_integer(res));
+
+    // callee need more variables than caller
+    CU_ASSERT(0 < interp_execute_string(&env, "def t3(a, b, c) { var x = a + b + c; return x }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def w(n) { if (n > 0) return w(n - 1); return t3(n, 2, 3) }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "w(500) == 5", &res) && val_is_true(res));
+
+    // native and closure in return position
+    CU_ASSERT(0 < interp_execute_string(&env, "def nat(n) { if (n > 0) return nat(n - 1); return add(n, 1) }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "nat(500) == 1", &res) && val_is_true(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "def cl(n) { def g(k) { return n + k } return g(1) }", &res) && val_is_function(res));
+    CU_ASSERT(0 < interp_execute_string(&env, "cl(4) == 5", &res) && val_is_true(res));
+
+    env_deinit(&env);
+}
+
 static void test_exec_func_arg(void)
 {
     env_t env;
@@ -953,6 +1831,11 @@ CU_pSuite test_lang_interp_entry()
         CU_add_test(suite, "exec assign",       test_exec_assign);
         CU_add_test(suite, "exec if stmt",      test_exec_if);
         CU_add_test(suite, "exec while stmt",   test_exec_while);
+        CU_add_test(suite, "exec optimize",     test_exec_optimize);
+        CU_add_test(suite, "exec number type",  test_exec_number_type);
+        CU_add_test(suite, "exec quicken",      test_exec_quicken);
+        CU_add_test(suite, "exec compare jump", test_exec_cmp_jmp);
+        CU_add_test(suite, "exec store var",    test_exec_store_var);
 
         CU_add_test(suite, "exec function",     test_exec_function);
         CU_add_test(suite, "exec native",       test_exec_native);
@@ -960,8 +1843,26 @@ CU_pSuite test_lang_interp_entry()
         CU_add_test(suite, "exec string",       test_exec_string);
         CU_add_test(suite, "exec dictionary",   test_exec_dict);
         CU_add_test(suite, "exec array",        test_exec_array);
+        CU_add_test(suite, "exec foreach",      test_exec_foreach);
+        CU_add_test(suite, "exec array library", test_exec_array_library);
+        CU_add_test(suite, "exec array sort",   test_exec_array_sort);
+        CU_add_test(suite, "exec array kind",   test_exec_array_kind);
+        CU_add_test(suite, "exec array sparse", test_exec_array_sparse);
+        CU_add_test(suite, "exec array large",  test_exec_array_large);
+        CU_add_test(suite, "exec buffer",       test_exec_buffer);
+        CU_add_test(suite, "exec map",          test_exec_map);
+        CU_add_test(suite, "exec in",           test_exec_in);
+        CU_add_test(suite, "exec for",          test_exec_for);
+        CU_add_test(suite, "exec switch",       test_exec_switch);
+        CU_add_test(suite, "exec try",          test_exec_try);
+        CU_add_test(suite, "exec budget",       test_exec_budget);
+        CU_add_test(suite, "exec interrupt",    test_exec_interrupt);
+        CU_add_test(suite, "exec generator",    test_exec_generator);
         CU_add_test(suite, "exec closure",      test_exec_closure);
+        CU_add_test(suite, "exec closure capture", test_exec_closure_capture);
+        CU_add_test(suite, "exec static function", test_exec_static_function);
         CU_add_test(suite, "exec stack check",  test_exec_stack_check);
+        CU_add_test(suite, "exec tail call",    test_exec_tail_call);
         CU_add_test(suite, "exec function arg", test_exec_func_arg);
         CU_add_test(suite, "exec gc",           test_exec_gc);
         CU_add_test(suite, "exec gc with ref",  test_exec_gc_reference);
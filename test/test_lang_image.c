@@ -73,12 +73,75 @@ static void test_image_simple(void)
     CU_ASSERT_FATAL(0 <= interp_execute_image(&env, &res));// && val_is_number(res) && 1 == val_2_double(res));
 }
 
+static void test_image_quicken(void)
+{
+    int img_sz;
+    env_t env;
+    val_t *res;
+    image_info_t image;
+    static uint8_t img_copy[IMG_BUF_SIZE];
+    const char *input = "                   \
+        var o = {x: 1, y: 2}, a = [1, 2, 3];\
+        def fn(n) {                         \
+            var s = 0;                      \
+            while (n > 0) {                 \
+                n = n - 1;                  \
+                s = s + o.y + a[n];         \
+            }                               \
+            return s;                       \
+        }                                   \
+        fn(3) == 12 && fn(3) == 12;         \
+        ";
+
+    CU_ASSERT_FATAL(0 == compile_env_init(&env, cpl_buf, CPL_BUF_SIZE));
+    CU_ASSERT_FATAL(0 < (img_sz = compile_exe(&env, input, img_buf, IMG_BUF_SIZE)));
+    CU_ASSERT_FATAL(0 == image_load(&image, img_buf, img_sz));
+    CU_ASSERT_FATAL(0 == interp_env_init_image(&env, run_buf, RUN_BUF_SIZE,
+            NULL, 8192, NULL, 1024, &image));
+    memcpy(img_copy, img_buf, img_sz);
+
+    // code of image is copied, and image keep unchanged
+    CU_ASSERT(env.quicken);
+    CU_ASSERT(0 == interp_execute_image(&env, &res) && val_is_true(res));
+    CU_ASSERT(0 == memcmp(img_copy, img_buf, img_sz));
+}
+
+static void test_image_try(void)
+{
+    int img_sz;
+    env_t env;
+    val_t *res;
+    image_info_t image;
+    const char *input = "                   \
+        def fn(n) {                         \
+            if (n > 2) throw n;             \
+            return n;                       \
+        }                                   \
+        def safe(n) {                       \
+            try { return fn(n) }            \
+            catch (e) { return -e }         \
+        }                                   \
+        safe(1) == 1 && safe(3) == -3;      \
+        ";
+
+    // handler table is kept in the code of image
+    CU_ASSERT_FATAL(0 == compile_env_init(&env, cpl_buf, CPL_BUF_SIZE));
+    CU_ASSERT_FATAL(0 < (img_sz = compile_exe(&env, input, img_buf, IMG_BUF_SIZE)));
+    CU_ASSERT_FATAL(0 == image_load(&image, img_buf, img_sz));
+    CU_ASSERT_FATAL(0 == interp_env_init_image(&env, run_buf, RUN_BUF_SIZE,
+            NULL, 8192, NULL, 1024, &image));
+
+    CU_ASSERT(0 == interp_execute_image(&env, &res) && val_is_true(res));
+}
+
 CU_pSuite test_lang_image_entry()
 {
     CU_pSuite suite = CU_add_suite("lang image", test_setup, test_clean);
 
     if (suite) {
         CU_add_test(suite, "image simple",       test_image_simple);
+        CU_add_test(suite, "image quicken",      test_image_quicken);
+        CU_add_test(suite, "image try",          test_image_try);
     }
 
     return suite;
@@ -51,12 +51,12 @@ static void test_common(void)
     # comments 1\r\n\
     +-*/%\n\
     // comments 2\r\n\
-    += -= *= /= %= &= |= ^= ~= >>= <<= >> << && ||\n\
+    += -= *= /= %= &= |= ^= ~= >>= <<= >> << && || ..\n\
     ' bbbb\" ' \" abcd' &$|!\" \n\
     12345 09876\n\
     /* comments 3\r\n comments 3 continue*/\
     abc a12 _11 a_b _a_ $1 $_a \n\
-    undefined null NaN true false var def return while break continue in if elif else try catch throw\n";
+    undefined null NaN true false var def return while break continue in if elif else try catch throw yield await for switch case default\n";
 
     CU_ASSERT(0 == lex_init(&lex, input, NULL));
 
@@ -81,6 +81,7 @@ static void test_common(void)
     CU_ASSERT(lex_match(&lex, TOK_LSHIFT));
     CU_ASSERT(lex_match(&lex, TOK_LOGICAND));
     CU_ASSERT(lex_match(&lex, TOK_LOGICOR));
+    CU_ASSERT(lex_match(&lex, TOK_RANGE));
 
     CU_ASSERT(TOK_STR == lex_token(&lex, &tok) && 0 == strcmp(tok.text, " bbbb\" "));
     CU_ASSERT(lex_match(&lex, TOK_STR));
@@ -125,6 +126,12 @@ static void test_common(void)
     CU_ASSERT(lex_match(&lex, TOK_TRY));
     CU_ASSERT(lex_match(&lex, TOK_CATCH));
     CU_ASSERT(lex_match(&lex, TOK_THROW));
+    CU_ASSERT(lex_match(&lex, TOK_YIELD));
+    CU_ASSERT(lex_match(&lex, TOK_AWAIT));
+    CU_ASSERT(lex_match(&lex, TOK_FOR));
+    CU_ASSERT(lex_match(&lex, TOK_SWITCH));
+    CU_ASSERT(lex_match(&lex, TOK_CASE));
+    CU_ASSERT(lex_match(&lex, TOK_DEFAULT));
 
     CU_ASSERT(0 == lex_deinit(&lex));
 }
@@ -174,7 +174,7 @@ static void test_expr_unary(void)
     parser_t psr;
     expr_t   *expr;
 
-    parse_init(&psr, "-a ~b !c !!d", NULL, heap_buf, PSR_BUF_SIZE);
+    parse_init(&psr, "-a ~b !c !!d await e(f)", NULL, heap_buf, PSR_BUF_SIZE);
 
     CU_ASSERT_FATAL(0 != (expr = parse_expr(&psr)));
     CU_ASSERT(ast_expr_type(expr) == EXPR_NEG);
@@ -193,6 +193,10 @@ static void test_expr_unary(void)
     CU_ASSERT(L_(expr) && ast_expr_type(L_(expr)) == EXPR_LOGIC_NOT);
     CU_ASSERT(L_(L_(expr)) && ast_expr_type(L_(L_(expr))) == EXPR_ID
                 && !strcmp("d", TEXT(L_(L_(expr)))));
+
+    CU_ASSERT_FATAL(0 != (expr = parse_expr(&psr)));
+    CU_ASSERT(ast_expr_type(expr) == EXPR_AWAIT);
+    CU_ASSERT(L_(expr) && ast_expr_type(L_(expr)) == EXPR_CALL);
 }
 
 static void test_expr_mul(void)
@@ -678,6 +682,17 @@ static void test_stmt_simple(void)
     CU_ASSERT_FATAL(0 != (stmt = parse_stmt(&psr)));
     CU_ASSERT(stmt->type == STMT_RET);
     CU_ASSERT(!stmt->expr);
+
+    // yield
+    parse_init(&psr, "yield a * 2", NULL, heap_buf, PSR_BUF_SIZE);
+    CU_ASSERT_FATAL(0 != (stmt = parse_stmt(&psr)));
+    CU_ASSERT(stmt->type == STMT_YIELD);
+    CU_ASSERT(stmt->expr->type == EXPR_MUL);
+
+    parse_init(&psr, "yield;", NULL, heap_buf, PSR_BUF_SIZE);
+    CU_ASSERT_FATAL(0 != (stmt = parse_stmt(&psr)));
+    CU_ASSERT(stmt->type == STMT_YIELD);
+    CU_ASSERT(!stmt->expr);
 }
 
 static void test_stmt_if(void)
@@ -720,6 +735,65 @@ static void test_stmt_while(void)
     CU_ASSERT(stmt->expr->type == EXPR_TGT);
 }
 
+static void test_stmt_for(void)
+{
+    parser_t psr;
+    stmt_t   *stmt;
+    char     *input = "\
+    for i in 0..n {\n\
+       a = a + i\n\
+    }\n";
+
+    parse_init(&psr, input, NULL, heap_buf, PSR_BUF_SIZE);
+    CU_ASSERT_FATAL(0 != (stmt = parse_stmt(&psr)));
+    CU_ASSERT(stmt->type == STMT_FOR);
+    CU_ASSERT_FATAL(stmt->expr->type == EXPR_TIN);
+    CU_ASSERT(ast_expr_lft(stmt->expr)->type == EXPR_ID);
+    CU_ASSERT(ast_expr_rht(stmt->expr)->type == EXPR_RANGE);
+    CU_ASSERT(stmt->block != NULL);
+
+    parse_init(&psr, "for (x in a.b) print(x)\n", NULL, heap_buf, PSR_BUF_SIZE);
+    CU_ASSERT_FATAL(0 != (stmt = parse_stmt(&psr)));
+    CU_ASSERT(stmt->type == STMT_FOR);
+    CU_ASSERT_FATAL(stmt->expr->type == EXPR_TIN);
+    CU_ASSERT(ast_expr_rht(stmt->expr)->type == EXPR_PROP);
+
+    parse_init(&psr, "for 1 in a {}\n", NULL, heap_buf, PSR_BUF_SIZE);
+    CU_ASSERT(0 == parse_stmt(&psr) && psr.error != 0);
+}
+
+static void test_stmt_switch(void)
+{
+    parser_t psr;
+    stmt_t   *stmt, *c;
+    char     *input = "\
+    switch (a) {\n\
+    case 1, 2:\n\
+       a = a + 1\n\
+       b = b + 1\n\
+    case 3:\n\
+    default:\n\
+       a = 0\n\
+    }\n";
+
+    parse_init(&psr, input, NULL, heap_buf, PSR_BUF_SIZE);
+    CU_ASSERT_FATAL(0 != (stmt = parse_stmt(&psr)));
+    CU_ASSERT(stmt->type == STMT_SWITCH);
+    CU_ASSERT(stmt->expr->type == EXPR_ID);
+
+    CU_ASSERT_FATAL(0 != (c = stmt->block));
+    CU_ASSERT(c->type == STMT_CASE && c->expr->type == EXPR_COMMA);
+    CU_ASSERT(c->block != NULL && c->block->next != NULL);
+    CU_ASSERT_FATAL(0 != (c = c->next));
+    CU_ASSERT(c->type == STMT_CASE && c->expr->type == EXPR_NUM && c->block == NULL);
+    CU_ASSERT_FATAL(0 != (c = c->next));
+    CU_ASSERT(c->type == STMT_CASE && c->expr == NULL && c->block != NULL);
+    CU_ASSERT(c->next == NULL);
+
+    parse_init(&psr, "switch a { a = 1 }\n", NULL, heap_buf, PSR_BUF_SIZE);
+    CU_ASSERT(0 == parse_stmt(&psr) && psr.error != 0);
+}
+
 static void test_stmt_try(void)
 {
     parser_t psr;
@@ -792,6 +866,8 @@ CU_pSuite test_lang_parse_entry()
         CU_add_test(suite, "parse statements simple",   test_stmt_simple);
         CU_add_test(suite, "parse statements if",       test_stmt_if);
         CU_add_test(suite, "parse statements while",    test_stmt_while);
+        CU_add_test(suite, "parse statements for",      test_stmt_for);
+        CU_add_test(suite, "parse statements switch",   test_stmt_switch);
         CU_add_test(suite, "parse statements try",      test_stmt_try);
     }
 